@@ -40,6 +40,11 @@ uniform TEXTURE_PARAMETERS exitParameters_;
 // declare volume
 uniform VOLUME_STRUCT volumeStruct_;    // volume data with parameters
 
+#ifdef USE_GRADIENT_VOLUME
+// normalized gradient direction packed into rgb as 0.5 * direction + 0.5, magnitude in a
+uniform VOLUME_STRUCT gradientVolumeStruct_;
+#endif
+
 // delcare transfer function
 uniform sampler1D transferFunc_;
 
@@ -69,6 +74,19 @@ vec3 calculateGradient(in vec3 samplePosition) {
     //return vec3(0.0);
 }
 
+// Reads the precomputed gradient instead of computing the central differences
+vec3 fetchGradient(in vec3 samplePosition) {
+#ifdef USE_GRADIENT_VOLUME
+    vec3 gradient = texture(gradientVolumeStruct_.volume_, samplePosition).rgb * 2.0 - 1.0;
+    // interpolated directions can cancel out, e.g. at the zero gradients of homogeneous regions
+    if (dot(gradient, gradient) < 1e-6)
+        return vec3(0.0);
+    return normalize(gradient);
+#else
+    return calculateGradient(samplePosition);
+#endif
+}
+
 vec3 applyPhongShading(in vec3 pos, in vec3 gradient, in vec3 ka, in vec3 kd, in vec3 ks) {
     // Implement phong shading
 
@@ -111,7 +129,7 @@ void rayTraversal(in vec3 first, in vec3 last) {
         vec3 samplePos = first + t * rayDirection;
         float intensity = texture(volumeStruct_.volume_, samplePos).a;
         
-        vec3 gradient = calculateGradient(samplePos);
+        vec3 gradient = fetchGradient(samplePos);
 	vec4 color = texture(transferFunc_, intensity);
 	
 	
@@ -4,10 +4,14 @@ layout(location = 1) in uint in_selection;
 
 out float yPosition;
 
+// in_selection holds the flags of the point: 1 if it is linked, 2 if it is brushed
 void main() {
     gl_Position = vec4(in_position, 0.0, 1.0);
+    // A brushed point is moved outside of the clip volume, so that it is not drawn
+    if ((in_selection & 2u) != 0u)
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
     yPosition = in_position.y;
-    bool isSelected = (in_selection == 1);
+    bool isSelected = ((in_selection & 1u) != 0u);
     if (isSelected)
     	gl_PointSize = 15.f; 
    	else
@@ -3,23 +3,85 @@
 
 #include "voreen/core/properties/condition.h"
 #include "voreen/core/properties/templateproperty.h"
+#include "modules/tnm093/include/tnm_indexset.h"
+
+#include <deque>
+
+#include <stdint.h>
 
 namespace voreen {
 
 #ifdef DLL_TEMPLATE_INST
-template class VRN_CORE_API TemplateProperty<std::set<unsigned int> >;
+template class VRN_CORE_API TemplateProperty<IndexSet>;
 #endif
-class VRN_CORE_API IndexProperty : public TemplateProperty<std::set<unsigned int> > {
+// A set of voxel indices, e.g. the brushed or the linked items, that is shared between processors.
+// Every change of the value increases the version. Changes that are published with applyChanges
+// are recorded as the added and removed indices, so that a processor that remembers the version
+// it last saw only has to process the difference with getChangesSince. Links transfer the
+// recorded changes in the same way instead of copying the whole set
+class VRN_CORE_API IndexProperty : public TemplateProperty<IndexSet> {
 public:
+    // The number of changes that are recorded; readers that are further behind read the whole value
+    static const size_t MAX_CHANGES = 64;
+
+    // The value a link transfers: the identifier of the property that changed, whose recorded
+    // changes are applied by the linked property. The source is looked up by the identifier, so
+    // a Variant that outlives its source is ignored instead of referring to a destroyed property
+    struct LinkSource {
+        uint64_t id;
+    };
+
     IndexProperty();
     IndexProperty(const std::string& id, const std::string& guiText);
+    ~IndexProperty();
     Property* create() const;
     std::string getClassName() const;
 
+    // Replaces the whole value. The recorded changes are discarded, as they do not lead to the
+    // new value
+    void set(const IndexSet& value);
+
+    // Adds the indices of 'added' and removes the indices of 'removed', which must not have
+    // indices in common, and records the change as a new version
+    void applyChanges(const IndexSet& added, const IndexSet& removed);
+
+    // The version of the value. It starts at 0 and increases with every change
+    uint64_t getVersion() const;
+
+    // Stores the indices that were added and removed since the value had the version 'version'
+    // in 'added' and 'removed'. Returns false if the changes since then are not recorded anymore,
+    // in which case the whole value has to be read
+    bool getChangesSince(uint64_t version, IndexSet& added, IndexSet& removed) const;
+
     int getVariantType() const;
 
     Variant getVariant(bool normalized) const;
     void setVariant(const Variant& v, bool normalized);
+
+    // The indices are saved as the base64 encoded IndexSet::encode, which is a few bytes per
+    // 16 indices instead of an XML element per index
+    void serialize(XmlSerializer& s) const;
+    void deserialize(XmlDeserializer& s);
+
+private:
+    // The indices that one version added to and removed from the previous one
+    struct Change {
+        uint64_t version;
+        IndexSet added;
+        IndexSet removed;
+    };
+
+    // The property is registered under _id while it exists, so copying is forbidden
+    IndexProperty(const IndexProperty&);
+    IndexProperty& operator=(const IndexProperty&);
+
+    uint64_t _id; // Identifies the property as the source of a link, as addresses can be reused
+    uint64_t _version; // The version of the value
+    std::deque<Change> _changes; // The recorded changes in the order of their versions
+
+    uint64_t _sourceId; // The _id of the property the last link transfer came from, or 0
+    uint64_t _sourceVersion; // The version of the source property at that transfer
+    uint64_t _linkedVersion; // The version of this property after that transfer
 };
 
 } // namespace voreen
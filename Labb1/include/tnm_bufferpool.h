@@ -0,0 +1,190 @@
+#ifndef VRN_TNM_BUFFERPOOL_H
+#define VRN_TNM_BUFFERPOOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <mutex>
+
+#include <stdint.h>
+
+namespace voreen {
+
+// A process-wide pool of the memory buffers of large arrays, e.g. the columns of Data. Fresh
+// memory is page faulted in on its first access, which for gigabytes of items costs more than
+// computing them, and processors recompute their results whenever a property changes. Buffers
+// that are returned to the pool are kept, up to a limit, and handed out again for requests of
+// the same size class, whose pages are already resident. Buffers of at least HUGE_PAGE_SIZE bytes
+// are allocated from the operating system directly and use huge pages where they are available
+class BufferPool {
+public:
+    // The size of the huge pages of the operating system; smaller buffers are allocated on the heap
+    static const size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+    // The number of requests and bytes the pool served
+    struct Counters {
+        Counters();
+
+        uint64_t requests; // The number of acquired buffers
+        uint64_t hits; // The requests that were served by a retained buffer
+        uint64_t bytesRecycled; // The bytes of the buffers that were served by a retained buffer
+        uint64_t bytesAllocated; // The bytes of the buffers that were newly allocated
+        uint64_t bytesRetained; // The bytes of the buffers that are currently kept for reuse
+    };
+
+    static BufferPool& instance();
+
+    // Returns a buffer of at least 'bytes' bytes, aligned for every type. Its content is undefined
+    void* acquire(size_t bytes);
+
+    // Returns a buffer that was acquired with the same 'bytes' to the pool. It is kept for reuse
+    // unless the retained buffers would exceed the limit
+    void release(void* buffer, size_t bytes);
+
+    // Sets the number of bytes the retained buffers may take up at most; the least recently
+    // returned buffers are freed first if the limit is exceeded. The default is a sixteenth of the
+    // physical memory, at most 1 GB
+    void setRetainLimit(uint64_t bytes);
+    uint64_t getRetainLimit() const;
+
+    // Frees all retained buffers
+    void trim();
+
+    Counters getCounters() const;
+
+    // The number of bytes that is allocated for a request of 'bytes' bytes. Requests are rounded
+    // up to one of four classes per power of two, so a buffer wastes at most 25% of its size
+    static size_t sizeClass(size_t bytes);
+
+private:
+    BufferPool();
+    ~BufferPool();
+
+    // The pool is shared by the whole process, so copying is forbidden
+    BufferPool(const BufferPool&);
+    BufferPool& operator=(const BufferPool&);
+
+    // Frees the least recently returned buffers until the retained bytes are at most 'limit';
+    // requires that _mutex is locked
+    void evict(uint64_t limit);
+
+    // Gets and frees the memory of a buffer of sizeClass(bytes) bytes from the operating system
+    static void* allocate(size_t bytes);
+    static void deallocate(void* buffer, size_t bytes);
+
+    // A retained buffer
+    struct Buffer {
+        void* memory;
+        size_t bytes; // The size class of the buffer
+    };
+
+    mutable std::mutex _mutex; // Guards all other members, as Data is resized on worker threads
+    std::multimap<size_t, uint64_t> _bySize; // The keys into _buffers of the retained buffers of each size class
+    std::map<uint64_t, Buffer> _buffers; // The retained buffers in the order they were returned
+    uint64_t _nextBuffer; // The key of the next returned buffer in _buffers
+    uint64_t _retainLimit; // The maximum number of bytes of the retained buffers
+    Counters _counters; // The statistics of the served requests
+};
+
+// An array of 'size' elements of the trivially copyable type T whose memory is borrowed from the
+// BufferPool. The elements are not initialized
+template <typename T>
+class PooledArray {
+public:
+    PooledArray();
+    ~PooledArray();
+
+    // Replaces the elements by 'size' uninitialized elements
+    void allocate(size_t size);
+
+    // Returns the memory to the pool
+    void reset();
+
+    void swap(PooledArray& other);
+
+    // The first element, or 0 if the array is empty
+    T* data();
+    const T* data() const;
+
+    size_t size() const;
+    bool empty() const;
+
+    T& operator[](size_t i);
+    const T& operator[](size_t i) const;
+
+private:
+    // The memory belongs to a single array, so copying is forbidden
+    PooledArray(const PooledArray&);
+    PooledArray& operator=(const PooledArray&);
+
+    T* _data; // The buffer acquired from the pool
+    size_t _size; // The number of elements
+};
+
+template <typename T>
+PooledArray<T>::PooledArray()
+    : _data(0)
+    , _size(0)
+{}
+
+template <typename T>
+PooledArray<T>::~PooledArray() {
+    reset();
+}
+
+template <typename T>
+void PooledArray<T>::allocate(size_t size) {
+    reset();
+    if (size == 0)
+        return;
+    _data = static_cast<T*>(BufferPool::instance().acquire(size * sizeof(T)));
+    _size = size;
+}
+
+template <typename T>
+void PooledArray<T>::reset() {
+    if (_data)
+        BufferPool::instance().release(_data, _size * sizeof(T));
+    _data = 0;
+    _size = 0;
+}
+
+template <typename T>
+void PooledArray<T>::swap(PooledArray& other) {
+    std::swap(_data, other._data);
+    std::swap(_size, other._size);
+}
+
+template <typename T>
+T* PooledArray<T>::data() {
+    return _data;
+}
+
+template <typename T>
+const T* PooledArray<T>::data() const {
+    return _data;
+}
+
+template <typename T>
+size_t PooledArray<T>::size() const {
+    return _size;
+}
+
+template <typename T>
+bool PooledArray<T>::empty() const {
+    return _size == 0;
+}
+
+template <typename T>
+T& PooledArray<T>::operator[](size_t i) {
+    return _data[i];
+}
+
+template <typename T>
+const T& PooledArray<T>::operator[](size_t i) const {
+    return _data[i];
+}
+
+} // namespace voreen
+
+#endif // VRN_TNM_BUFFERPOOL_H
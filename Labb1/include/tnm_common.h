@@ -3,25 +3,414 @@
 
 #include "voreen/core/ports/genericport.h"
 
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace voreen {
 
-// The total number of data values that will be extracted
-// Intensity + Average + Standard Deviation + Gradient Magnitude
-const int NUM_DATA_VALUES = 4;
+class MappedFile;
 
+// Converts between single and IEEE half precision floating point numbers. Values are rounded to
+// the nearest half, ties to even; values beyond the half range become infinite
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t half);
 
-struct VoxelDataItem { // There is one VoxelDataItem struct for each voxel in the dataset
-    unsigned int voxelIndex; // This is the index of the voxel from which the data was retrieved
-    float dataValues[NUM_DATA_VALUES]; // The list of data values for this specific voxel
+// Summary statistics of the values of one feature of a Data, see Data::statistics
+struct ColumnStatistics {
+    ColumnStatistics();
+
+    float minimum; // The smallest value, or 0 if there are no items
+    float maximum; // The largest value, or 0 if there are no items
+    double mean; // The arithmetic mean of the values
+    double variance; // The population variance of the values
+	// The values below which the fractions 1/(n+1), ..., n/(n+1) of the items lie, if n quantiles
+	// were requested; they are interpolated within a histogram, see Data::computeStatistics
+    std::vector<float> quantiles;
+};
+
+// The data values extracted for a set of voxels. There is one item for each voxel, consisting
+// of the index of the voxel and one value per feature. The features are not fixed: their
+// names are stored together with the values, so processors further down the network can
+// adapt to whichever features were selected in TNMVolumeInformation.
+// The items are stored in columns: the voxel indices of all items are one contiguous array, and
+// so are the values of each feature. A processor scanning one or two features only reads
+// those columns, in memory order; value() accesses a single item regardless of the layout.
+// The items are either kept in memory owned by the Data or in a memory-mapped file, which allows
+// for more items than fit into the main memory.
+// The values can be stored with 16 bits instead of 32, which halves the memory and the bandwidth
+// of every processor reading them, at the cost of precision. They are decoded on every access.
+// If the items are consecutive voxels, e.g. all voxels of a volume, their voxel indices are
+// implicit, the index of the first voxel plus the position of the item, and are not stored.
+// The columns are reference counted: copies of a Data and selections of its items share them,
+// so processors that only filter or pass on the items do not copy the values. The columns are
+// copied when a Data that shares them is changed (copy on write).
+// The statistics of the columns are computed once and travel with the Data, so renderers that
+// normalize the values do not scan them again for every frame
+class Data {
+public:
+    // How the data values are stored
+    enum ValueEncoding {
+        ValueEncodingFloat32, // Exact single precision values
+        ValueEncodingFloat16, // Half precision, with a relative error of at most 2^-11
+        ValueEncodingQuantized16 // 16 bit integers q, mapped to offset + scale * q per feature
+    };
+
+    Data();
+
+    // A Data with the items 'items' of this Data, in this order, which shares the columns
+    Data select(const std::vector<size_t>& items) const;
+
+    // Whether the items are a selection of the items of the columns, see select()
+    bool isSelection() const;
+
+    // Copies the columns if they are shared with another Data, so that changes of this Data
+    // are not seen by the other one and vice versa; selected items are copied into new columns.
+    // All functions that change the items call this themselves
+    void makeUnique();
+
+    // Sets the names of the features that every item contains; this removes all items. The
+    // quantization of every feature is reset to offset 0 and scale 1
+    void setFeatureNames(const std::vector<std::string>& featureNames);
+    const std::vector<std::string>& getFeatureNames() const;
+
+    // Selects how the values are stored; this removes all items. For ValueEncodingQuantized16,
+    // 'offsets' and 'scales' contain the mapping of each feature; values outside of the range
+    // [offset, offset + 65535 * scale] are clamped to it
+    void setValueEncoding(ValueEncoding encoding, const std::vector<float>& offsets = std::vector<float>(),
+        const std::vector<float>& scales = std::vector<float>());
+    ValueEncoding getValueEncoding() const;
+    const std::vector<float>& getValueOffsets() const;
+    const std::vector<float>& getValueScales() const;
+
+    // The number of bytes of a single stored value
+    size_t getBytesPerValue() const;
+
+    // The number of data values per item
+    size_t getNumFeatures() const;
+
+    // Returns the index of the feature with the given name, or -1 if there is no such feature
+    int getFeatureIndex(const std::string& name) const;
+
+    // The number of items
+    size_t size() const;
+    bool empty() const;
+
+    // Changes the number of items; new items are initialized to 0. If the items were stored in a
+    // mapped file, they are copied into memory first
+    void resize(size_t nItems);
+    // Allocates the columns for 'nItems' items, so that appending up to this number of items
+    // does not move the columns
+    void reserve(size_t nItems);
+    // Removes all items, but keeps the features
+    void clear();
+
+    // Appends a copy of item 'item' of 'other', which has to have the same features. The values
+    // are re-encoded if the encodings differ
+    void append(const Data& other, size_t item);
+
+    // Overwrites the 'n' items starting at 'first' with copies of the items of 'other' starting
+    // at 'otherFirst'; 'other' has to have the same features. The values are re-encoded if the
+    // encodings differ
+    void copyItems(size_t first, const Data& other, size_t otherFirst, size_t n);
+
+    // Replaces the items by the 'nItems' items stored in 'file': the voxel indices are an array
+    // of 32 bit integers starting at the byte 'voxelIndicesOffset', the values are stored column
+    // after column, in the current encoding, starting at 'valuesOffset'. The file is kept open as
+    // long as any Data refers to it. Values can only be changed if the file was not mapped ReadOnly.
+    // If the voxel indices are implicit, the file does not contain them and 'voxelIndicesOffset'
+    // is ignored
+    void setMappedStorage(const std::shared_ptr<MappedFile>& file, size_t nItems,
+        size_t voxelIndicesOffset, size_t valuesOffset);
+
+    // The mapped file containing the items, or 0 if they are stored in memory
+    const std::shared_ptr<MappedFile>& getMappedStorage() const;
+
+    // Writes the items [first, first + n) to the mapped file and drops them from memory until
+    // they are accessed again. Does nothing if the items are stored in memory. The file has to
+    // be mapped ReadWrite, as the changes of a CopyOnWrite mapping would be lost
+    void releaseItems(size_t first, size_t n);
+
+    // The index of the voxel from which the item was retrieved. Setting an index that differs
+    // from an implicit one stores the voxel indices of all items
+    unsigned int voxelIndex(size_t item) const;
+    void setVoxelIndex(size_t item, unsigned int voxelIndex);
+
+    // Makes the voxel indices of all items implicit: the item i has the index firstVoxelIndex + i.
+    // The stored voxel indices are dropped. setFeatureNames and setValueEncoding make them
+    // explicit again
+    void setImplicitVoxelIndices(unsigned int firstVoxelIndex);
+    bool hasImplicitVoxelIndices() const;
+    unsigned int getFirstVoxelIndex() const;
+
+    // Returns the item with the voxel index 'voxelIndex', or size() if there is none. The items
+    // have to be sorted by their voxel indices, as they are in every Data of this module. With
+    // implicit voxel indices, this is a constant time lookup, otherwise a binary search
+    size_t findItem(unsigned int voxelIndex) const;
+
+    // The value of 'feature' for the item 'item'
+    float value(size_t item, size_t feature) const;
+    void setValue(size_t item, size_t feature, float value);
+
+    // The voxel indices of all items, stored contiguously, or 0 if they are implicit. Like the
+    // other functions returning the columns, this is not available for a selection
+    const unsigned int* getVoxelIndices() const;
+
+    // Encodes the values of 'feature' of the 'nItems' items starting at 'first'
+    void setColumnValues(size_t feature, size_t first, size_t nItems, const float* values);
+
+    // Decodes the values of 'feature' of the 'nItems' items starting at 'first' into 'values';
+    // this also gathers the values of a selection
+    void columnValues(size_t feature, size_t first, size_t nItems, float* values) const;
+
+    // The values of 'feature' of all items, stored contiguously. Only available for
+    // ValueEncodingFloat32, which allows reading and writing the values without a copy
+    const float* column(size_t feature) const;
+    float* column(size_t feature);
+
+    // The stored values of 'feature' of all items in the current encoding, e.g. for writing
+    // them to a file
+    const void* getRawColumn(size_t feature) const;
+    void* getRawColumn(size_t feature);
+
+    // Computes the statistics of every feature over all items with 'nThreads' threads. They are
+    // kept until the values are changed and are shared by the copies of this Data, so the
+    // processor producing a Data computes them once for all consumers. With nQuantiles > 0, the
+    // quantiles are estimated from a histogram of 4096 bins over [minimum, maximum]
+    void computeStatistics(size_t nQuantiles = 0, size_t nThreads = 1) const;
+
+    // Whether the statistics are available without scanning the values
+    bool hasStatistics() const;
+
+    // The statistics of 'feature'; they are computed first if they are not available
+    const ColumnStatistics& statistics(size_t feature) const;
+
+private:
+    // The columns of a Data in memory, which are shared by its copies and selections
+    struct Storage;
+
+    // Whether the encoded values of 'other' can be copied without decoding them
+    bool hasSameEncoding(const Data& other) const;
+
+    // Whether a change of the items has to copy the columns first, see makeUnique()
+    bool isShared() const;
+
+    // Copies the items into new columns in memory that only this Data refers to
+    void copyStorage();
+
+    // Stores the implicit voxel indices in a column, before one of them is changed
+    void storeVoxelIndices();
+
+    // The position of 'item' in the columns
+    size_t storedItem(size_t item) const;
+
+    // Drops the statistics before the values are changed
+    void invalidateStatistics();
+
+    // Converts 'value' of 'feature' into its 16 bit representation
+    uint16_t encode(size_t feature, float value) const;
+
+
+    // Moves the items from a mapped file into memory owned by the Data
+    void detachMappedStorage();
+
+    // Moves the columns in memory to a distance of 'columnStride' values, keeping the first
+    // min(size(), columnStride) items
+    void setColumnStride(size_t columnStride);
+
+    // Points _voxelIndexData and _valueData to the columns in _storage
+    void updatePointers();
+
+    std::vector<std::string> _featureNames; // The names of the features
+    std::shared_ptr<Storage> _storage; // The columns, unless a file is mapped
+    std::shared_ptr<MappedFile> _mappedStorage; // The file containing the columns, if any
+    std::shared_ptr<const std::vector<size_t> > _selection; // The selected items of the columns, if any
+    mutable std::shared_ptr<const std::vector<ColumnStatistics> > _statistics; // The statistics of each feature, if computed
+
+    bool _hasImplicitVoxelIndices; // Whether the voxel indices are not stored, see setImplicitVoxelIndices
+    unsigned int _firstVoxelIndex; // The voxel index of the first item if the indices are implicit
+
+    ValueEncoding _encoding; // The encoding of the values
+    std::vector<float> _offsets; // The offset of each feature for ValueEncodingQuantized16
+    std::vector<float> _scales; // The scale of each feature for ValueEncodingQuantized16
+
+	// The arrays that are used by the accessors; they either point into _storage or into the
+	// mapped file. Only the one matching the encoding of the values is set; it points to the
+	// column of the first feature. _voxelIndexData is 0 if the voxel indices are implicit
+    unsigned int* _voxelIndexData;
+    float* _valueData;
+    uint16_t* _encodedValueData;
+    const size_t* _selectedItems; // The elements of _selection, or 0
+    size_t _size; // The number of items
+    size_t _columnStride; // The distance between the starts of two columns; the allocated number of items
 };
 
-// Just a typedef to make handling the data values easier
-typedef std::vector<VoxelDataItem> Data;
+inline size_t Data::getNumFeatures() const {
+    return _featureNames.size();
+}
+
+inline size_t Data::size() const {
+    return _size;
+}
+
+inline bool Data::empty() const {
+    return _size == 0;
+}
+
+inline bool Data::isSelection() const {
+    return _selectedItems != 0;
+}
+
+inline bool Data::isShared() const {
+    if (_selectedItems)
+        return true;
+    if (_mappedStorage)
+        return _mappedStorage.use_count() > 1;
+    return _storage.use_count() > 1;
+}
+
+inline void Data::makeUnique() {
+    if (isShared())
+        copyStorage();
+}
+
+inline size_t Data::storedItem(size_t item) const {
+    return _selectedItems ? _selectedItems[item] : item;
+}
+
+inline void Data::invalidateStatistics() {
+	// Only reads the pointer while the statistics are gone, so that the threads of an extraction
+	// can write to the columns concurrently
+    if (_statistics)
+        _statistics.reset();
+}
+
+inline bool Data::hasStatistics() const {
+    return _statistics != 0;
+}
+
+inline unsigned int Data::voxelIndex(size_t item) const {
+    if (_hasImplicitVoxelIndices)
+        return _firstVoxelIndex + static_cast<unsigned int>(storedItem(item));
+    return _voxelIndexData[storedItem(item)];
+}
+
+inline void Data::setVoxelIndex(size_t item, unsigned int voxelIndex) {
+    makeUnique();
+    if (_hasImplicitVoxelIndices) {
+        if (voxelIndex == _firstVoxelIndex + item)
+            return;
+        storeVoxelIndices();
+    }
+    _voxelIndexData[item] = voxelIndex;
+}
+
+inline bool Data::hasImplicitVoxelIndices() const {
+    return _hasImplicitVoxelIndices;
+}
+
+inline unsigned int Data::getFirstVoxelIndex() const {
+    return _firstVoxelIndex;
+}
+
+inline uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    const uint32_t magnitude = bits & 0x7fffffff;
+	// Infinity and NaN, which stays a (quiet) NaN
+    if (magnitude >= 0x7f800000)
+        return sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0);
+	// Everything from the midpoint between the largest half, 65504, and 65536 on
+    if (magnitude >= 0x477ff000)
+        return sign | 0x7c00;
+	// Below 2^-14, halves are subnormal, i.e. multiples of 2^-24; the scaling is exact
+    if (magnitude < 0x38800000) {
+        float absolute;
+        std::memcpy(&absolute, &magnitude, sizeof(absolute));
+        return sign | static_cast<uint16_t>(std::nearbyint(absolute * 16777216.f));
+    }
+	// Rebias the exponent from 127 to 15 and round away the 13 lowest bits of the mantissa; a
+	// carry out of the mantissa correctly increments the exponent
+    const uint32_t rounded = magnitude + 0xfff + ((magnitude >> 13) & 1);
+    return sign | static_cast<uint16_t>((rounded - 0x38000000) >> 13);
+}
+
+inline float halfToFloat(uint16_t half) {
+    const uint32_t sign = uint32_t(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1f;
+    const uint32_t mantissa = half & 0x3ff;
+    if (exponent == 0) {
+        const float absolute = float(mantissa) * (1.f / 16777216.f);
+        return sign ? -absolute : absolute;
+    }
+    const uint32_t bits = sign | (exponent == 0x1f ? 0x7f800000 : (exponent + 112) << 23) | (mantissa << 13);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline Data::ValueEncoding Data::getValueEncoding() const {
+    return _encoding;
+}
+
+inline size_t Data::getBytesPerValue() const {
+    return _encoding == ValueEncodingFloat32 ? sizeof(float) : sizeof(uint16_t);
+}
+
+inline uint16_t Data::encode(size_t feature, float value) const {
+    if (_encoding == ValueEncodingFloat16)
+        return floatToHalf(value);
+	// The comparisons are written so that NaN is mapped to 0
+    const float q = (_scales[feature] > 0.f) ? (value - _offsets[feature]) / _scales[feature] : 0.f;
+    if (!(q > 0.f))
+        return 0;
+    if (q >= 65535.f)
+        return 65535;
+    return static_cast<uint16_t>(q + 0.5f);
+}
+
+inline float Data::value(size_t item, size_t feature) const {
+    const size_t i = feature * _columnStride + storedItem(item);
+    switch (_encoding) {
+        case ValueEncodingFloat16:
+            return halfToFloat(_encodedValueData[i]);
+        case ValueEncodingQuantized16:
+            return _offsets[feature] + _scales[feature] * _encodedValueData[i];
+        default:
+            return _valueData[i];
+    }
+}
+
+inline void Data::setValue(size_t item, size_t feature, float value) {
+    makeUnique();
+    invalidateStatistics();
+    const size_t i = feature * _columnStride + item;
+    if (_encoding == ValueEncodingFloat32)
+        _valueData[i] = value;
+    else
+        _encodedValueData[i] = encode(feature, value);
+}
+
+inline const unsigned int* Data::getVoxelIndices() const {
+    return _voxelIndexData;
+}
+
+inline const float* Data::column(size_t feature) const {
+    return _valueData + feature * _columnStride;
+}
+
+inline float* Data::column(size_t feature) {
+    makeUnique();
+    invalidateStatistics();
+    return _valueData + feature * _columnStride;
+}
+
 // This port will be added to processors in order to exchange Data objects
 typedef GenericPort<Data> DataPort;
 
 } // namespace
 
-#endif // VRN_TNM_COMMON_H
\ No newline at end of file
+#endif // VRN_TNM_COMMON_H
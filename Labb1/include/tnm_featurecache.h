@@ -0,0 +1,91 @@
+#ifndef VRN_TNM_FEATURECACHE_H
+#define VRN_TNM_FEATURECACHE_H
+
+#include "modules/tnm093/include/tnm_common.h"
+#include "tgt/vector.h"
+
+#include <string>
+#include <vector>
+
+namespace voreen {
+
+// Identifies a set of extracted features by the volume they were computed from and by the
+// definition of the features. Cached data is only reused if all members match
+struct FeatureCacheKey {
+    std::string url; // The origin of the volume
+    tgt::svec3 dimensions; // The dimensions of the volume
+    int timeframe; // The timeframe of the volume, or 0 for static volumes
+    uint64_t contentHash; // A hash over all voxels, see hashBytes
+    std::string featureSignature; // Describes the computed features and their parameters
+
+    // A hash over all members, which is used as the file name of the cache entry
+    uint64_t hash() const;
+};
+
+// Computes a 64 bit FNV-1a style hash over 'size' bytes, processing 8 bytes at a time
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ULL);
+
+// An on-disk cache of extracted Data, stored as one binary file per key. Files are read back
+// through a memory mapping, so a cache hit costs a single sequential copy of the data. The
+// total size of the cache is capped; if it is exceeded, the least recently used entries are
+// deleted. Entries of changed volumes or changed feature definitions are never hit again, as
+// their key differs, and are eventually evicted
+class FeatureCache {
+public:
+    FeatureCache();
+
+    // The directory containing the cache files; it is created on the first store
+    void setDirectory(const std::string& directory);
+    const std::string& getDirectory() const;
+
+    // The maximum number of bytes all cache files may occupy together
+    void setSizeLimit(uint64_t bytes);
+
+    // Replaces the content of 'data' with the cached entry for 'key'. Returns false if there
+    // is no valid entry, in which case 'data' is left untouched. If 'mapped' is set, 'data'
+    // refers to a copy-on-write mapping of the file instead of copying the items into memory
+    bool load(const FeatureCacheKey& key, Data& data, bool mapped = false) const;
+
+    // Writes 'data' as the entry for 'key' and evicts old entries if the cache grew too large.
+    // Returns false if the entry could not be written or is larger than the size limit
+    bool store(const FeatureCacheKey& key, const Data& data) const;
+
+    // Creates the entry for 'key' with room for 'nItems' items with the features and the value
+    // encoding of 'data' and lets 'data' refer to its mapping, so that the items can be written
+    // directly into the file. The entry can not be loaded until it is committed
+    bool create(const FeatureCacheKey& key, size_t nItems, Data& data) const;
+
+    // Like create, but the file is not an entry of the cache: it is never loaded or evicted, and it
+    // is deleted as soon as no Data refers to its mapping anymore. It is placed in the cache
+    // directory, which is meant to have room for extracted features
+    bool createTemporary(size_t nItems, Data& data) const;
+
+    // Makes the entry created for 'key' available and evicts old entries. The new entry itself
+    // is kept even if it exceeds the size limit on its own, as a Data is still referring to it
+    bool commit(const FeatureCacheKey& key) const;
+
+    // Deletes the entry created for 'key' without making it available, e.g. if the extraction
+    // writing it was cancelled. On Windows, this fails while a Data still refers to the entry
+    void discard(const FeatureCacheKey& key) const;
+
+    // Deletes all cache files in the directory
+    void clear() const;
+
+    // A directory in the system's temporary directory that is used if none is set explicitly
+    static std::string defaultDirectory();
+
+private:
+    // The full path of the file for 'key'
+    std::string fileName(const FeatureCacheKey& key) const;
+
+    // Deletes the least recently used files until the cache fits into the size limit again; the
+    // file 'keep' is never deleted
+    void evict(const std::string& keep) const;
+
+    std::string _directory; // The directory containing the cache files
+    uint64_t _sizeLimit; // The maximum size of all cache files in bytes
+};
+
+} // namespace voreen
+
+#endif // VRN_TNM_FEATURECACHE_H
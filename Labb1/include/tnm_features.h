@@ -0,0 +1,232 @@
+#ifndef VRN_TNM_FEATURES_H
+#define VRN_TNM_FEATURES_H
+
+#include "modules/tnm093/include/tnm_rowkernels.h"
+#include "voreen/core/datastructures/volume/volumeatomic.h"
+#include "tgt/vector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace voreen {
+
+class SlidingWindowStatistics;
+class SummedVolumeTable;
+
+// Describes the volume a feature extraction runs on. It is filled once per volume by
+// createFeatureSource, which resolves the voxel type into the two conversion functions
+struct FeatureSource {
+    tgt::svec3 dimensions; // The dimensions of the volume
+    const void* volume; // The VolumeAtomic the features are extracted from
+    const uint16_t* uint16Voxels; // The voxels if the volume has 16 bit unsigned voxels, otherwise 0
+
+    // Converts the 'n' voxels starting at the linear index 'first' to float
+    void (*convertVoxels)(const void* volume, size_t first, size_t n, float* values);
+
+    // Computes the average and standard deviation of the clipped box with 'radius' around (x,y,z)
+    // by visiting every voxel in the box
+    void (*bruteForceNeighborhood)(const void* volume, size_t x, size_t y, size_t z, size_t radius,
+        float& average, float& stdDeviation);
+
+    size_t radius; // The radius of the neighborhood used for the average and standard deviation
+    const SummedVolumeTable* summedVolumeTable; // If set, used for the neighborhood statistics
+    const SlidingWindowStatistics* slidingWindow; // If set and there is no summed volume table, used instead
+    const RowKernels* kernels; // The vectorized kernels for the CPU
+};
+
+// One row of voxels along x, at (y, z), as seen by the feature kernels. The voxels and the
+// neighborhood statistics are only converted or computed when the first kernel asks for them,
+// and are then shared by all kernels of the row. Each worker thread has its own FeatureRow
+class FeatureRow {
+public:
+    explicit FeatureRow(const FeatureSource& source);
+
+    // Moves to the row (y, z) and discards all values of the previous row
+    void setRow(size_t y, size_t z);
+
+    const FeatureSource& getSource() const;
+    const tgt::svec3& getDimensions() const;
+    size_t getY() const;
+    size_t getZ() const;
+
+    // The linear index of the voxel (0, y, z)
+    size_t getFirstVoxelIndex() const;
+
+    // Whether the rows y-1 to y+1 in the slices z-1 to z+1 all lie inside the volume and the row
+    // has more than two voxels, so that the 3x3x3 stencil of the voxels 1 <= x < dimensions.x-1
+    // never leaves the volume
+    bool hasInteriorStencil() const;
+
+    // The voxels of the row (y + dy, z + dz) as float, for dy and dz in [-1, 1]. The indices -1
+    // and dimensions.x can be accessed as well; like all voxels of rows outside of the volume
+    // they are 0
+    const float* voxels(int dy = 0, int dz = 0);
+
+    // The neighborhood average and sample standard deviation of every voxel in the row
+    const float* averages();
+    const float* stdDeviations();
+
+    // Scratch space for dimensions.x values that a kernel can use while it computes its row
+    float* scratch();
+
+private:
+    // Computes the neighborhood statistics of the row with the fastest available method
+    void computeStatistics();
+
+    const FeatureSource& _source; // The volume
+    size_t _y; // The current row
+    size_t _z; // The current slice
+    size_t _firstVoxelIndex; // The linear index of (0, _y, _z)
+    std::vector<float> _voxels[9]; // The padded rows around the current row, see voxels()
+    bool _hasVoxels[9]; // Whether the corresponding entry in _voxels belongs to the current row
+    std::vector<float> _averages; // The averages of the current row
+    std::vector<float> _stdDeviations; // The standard deviations of the current row
+    bool _hasStatistics; // Whether _averages and _stdDeviations belong to the current row
+    std::vector<float> _scratch; // See scratch()
+};
+
+// A single measure that TNMVolumeInformation can extract for each voxel. All selected features
+// are computed in one sweep over the volume, which hands every row to each kernel in turn
+class Feature {
+public:
+    virtual ~Feature() {}
+
+    // A unique identifier that is used for the property selecting the feature and for the
+    // feature cache; it must not change between sessions
+    virtual std::string getIdentifier() const = 0;
+
+    // The name that is shown to the user and stored with the extracted Data
+    virtual std::string getName() const = 0;
+
+    // Whether the feature is selected in new processors
+    virtual bool isDefault() const;
+
+    // Has to be increased whenever the results of computeRow change, which invalidates cached
+    // features
+    virtual int getVersion() const;
+
+    // Whether computeRow reads FeatureRow::averages or FeatureRow::stdDeviations, which require
+    // tables that are only built if a selected feature uses them
+    virtual bool usesNeighborhoodStatistics() const;
+
+    // Bounds all values computeRow can return for a volume whose voxels lie in [voxelMinimum,
+    // voxelMaximum]; the bounds are used to quantize the values to 16 bits. Returns false if
+    // the feature has no such bounds, which is the default
+    virtual bool valueRange(float voxelMinimum, float voxelMaximum, float& minimum, float& maximum) const;
+
+    // Computes the feature for all voxels of 'row' and stores the value of the voxel x in
+    // values[x * stride]
+    virtual void computeRow(FeatureRow& row, float* values, size_t stride) const = 0;
+};
+
+// The list of all features that can be extracted. It contains the built-in features and can
+// be extended by other modules, which have to register their features before the first
+// TNMVolumeInformation is created, as the processor creates one property per feature
+class FeatureRegistry {
+public:
+    ~FeatureRegistry();
+
+    static FeatureRegistry& getInstance();
+
+    // Adds a feature; the registry takes ownership. A feature with an identifier that is already
+    // registered is deleted and not added
+    void registerFeature(Feature* feature);
+
+    // All registered features, in the order they were registered
+    const std::vector<const Feature*>& getFeatures() const;
+
+    // Returns the feature with the given identifier, or 0 if there is none
+    const Feature* getFeature(const std::string& identifier) const;
+
+private:
+    FeatureRegistry();
+    FeatureRegistry(const FeatureRegistry&);
+    FeatureRegistry& operator=(const FeatureRegistry&);
+
+    std::vector<const Feature*> _features; // The registered features
+};
+
+// Computes the average and the standard deviation of the box with the given radius around the
+// voxel (iX, iY, iZ) of the VolumeAtomic<T> 'volume' by visiting every neighbor once. The box is
+// clipped against the volume. This is the reference implementation for the other methods and is
+// only used if it is explicitly selected
+template <typename T>
+void bruteForceNeighborhood(const void* volume, size_t iX, size_t iY, size_t iZ, size_t radius,
+    float& average, float& stdDeviation)
+{
+    const VolumeAtomic<T>* typedVolume = static_cast<const VolumeAtomic<T>*>(volume);
+    const tgt::svec3 dimensions = typedVolume->getDimensions();
+    const size_t xBegin = iX > radius ? iX - radius : 0;
+    const size_t xEnd = std::min(iX + radius + 1, dimensions.x);
+    const size_t yBegin = iY > radius ? iY - radius : 0;
+    const size_t yEnd = std::min(iY + radius + 1, dimensions.y);
+    const size_t zBegin = iZ > radius ? iZ - radius : 0;
+    const size_t zEnd = std::min(iZ + radius + 1, dimensions.z);
+
+	// Welford's update keeps the mean of the voxels visited so far and the sum of their squared
+	// deviations from it, so the box is read once, in memory order, and the variance does not
+	// suffer from the cancellation of a plain sum of squares
+    double mean = 0.0;
+    double squaredDeviations = 0.0;
+    size_t count = 0;
+    const T* voxels = typedVolume->voxel();
+    for (size_t z = zBegin; z < zEnd; ++z) {
+        for (size_t y = yBegin; y < yEnd; ++y) {
+            const T* row = voxels + (z * dimensions.y + y) * dimensions.x;
+            for (size_t x = xBegin; x < xEnd; ++x) {
+                const double value = static_cast<double>(row[x]);
+                ++count;
+                const double delta = value - mean;
+                mean += delta / double(count);
+                squaredDeviations += delta * (value - mean);
+            }
+        }
+    }
+
+    average = static_cast<float>(mean);
+	// Like the other methods, a box of a single voxel has no deviation
+    stdDeviation = (count > 1) ? static_cast<float>(std::sqrt(squaredDeviations / double(count - 1))) : 0.f;
+}
+
+// Converts 'n' voxels of the VolumeAtomic<T> 'volume' starting at the linear index 'first' to
+// float for the feature kernels
+template <typename T>
+void convertVoxels(const void* volume, size_t first, size_t n, float* values) {
+    const T* voxels = static_cast<const VolumeAtomic<T>*>(volume)->voxel() + first;
+    for (size_t i = 0; i < n; ++i)
+        values[i] = static_cast<float>(voxels[i]);
+}
+
+// The raw voxels for the kernels that are vectorized for 16 bit volumes
+template <typename T>
+const uint16_t* uint16Voxels(const VolumeAtomic<T>*) {
+    return 0;
+}
+
+inline const uint16_t* uint16Voxels(const VolumeUInt16* volume) {
+    return volume->voxel();
+}
+
+// Returns the FeatureSource for 'volume' and 'radius' with the functions for its voxel type and
+// the fastest row kernels of the CPU. No tables for the neighborhood statistics are set, so the
+// statistics are computed by bruteForceNeighborhood until the caller sets one
+template <typename T>
+FeatureSource createFeatureSource(const VolumeAtomic<T>* volume, size_t radius) {
+    FeatureSource source;
+    source.dimensions = volume->getDimensions();
+    source.volume = volume;
+    source.uint16Voxels = uint16Voxels(volume);
+    source.convertVoxels = &convertVoxels<T>;
+    source.bruteForceNeighborhood = &bruteForceNeighborhood<T>;
+    source.radius = radius;
+    source.summedVolumeTable = 0;
+    source.slidingWindow = 0;
+    source.kernels = &rowKernels();
+    return source;
+}
+
+} // namespace voreen
+
+#endif // VRN_TNM_FEATURES_H
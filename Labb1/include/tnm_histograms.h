@@ -0,0 +1,108 @@
+#ifndef VRN_TNM_HISTOGRAMS_H
+#define VRN_TNM_HISTOGRAMS_H
+
+#include "modules/tnm093/include/tnm_common.h"
+#include "voreen/core/ports/genericport.h"
+
+#include <string>
+#include <vector>
+
+namespace voreen {
+
+// The histogram of the values of every feature of a Data and the joint histogram of every pair
+// of its features, e.g. intensity versus gradient magnitude for the design of two-dimensional
+// transfer functions. Each feature is binned over a fixed range with the same number of bins;
+// values outside of the range are counted in the first or the last bin
+class FeatureHistograms {
+public:
+    FeatureHistograms();
+
+    // Removes all counts and sets up 'nBins' bins over [minimums[i], maximums[i]] for the
+    // feature featureNames[i]
+    void reset(const std::vector<std::string>& featureNames, const std::vector<float>& minimums,
+        const std::vector<float>& maximums, size_t nBins);
+
+    const std::vector<std::string>& getFeatureNames() const;
+    size_t getNumBins() const;
+
+    // The range covered by the bins of 'feature'
+    float getMinimum(size_t feature) const;
+    float getMaximum(size_t feature) const;
+
+    // The number of items that were added
+    uint64_t getNumItems() const;
+
+    // The bin of 'feature' that contains 'value'
+    size_t bin(size_t feature, float value) const;
+
+    // The getNumBins() counts of 'feature'
+    const uint64_t* histogram(size_t feature) const;
+
+    // The getNumBins()^2 counts of the pair of features, stored row by row: the count of the
+    // bin x of 'featureX' and the bin y of 'featureY' is at y * getNumBins() + x. The pair is
+    // stored once, so 'featureX' has to be smaller than 'featureY'
+    const uint64_t* jointHistogram(size_t featureX, size_t featureY) const;
+
+    // The count of the bin x of 'featureX' and the bin y of 'featureY', in either order
+    uint64_t jointCount(size_t featureX, size_t featureY, size_t x, size_t y) const;
+
+    // Adds one item whose value of the feature f is values[f * stride]
+    void add(const float* values, size_t stride = 1);
+
+    // Adds the 'n' items of 'data' starting at 'first'; 'data' has to have the same features
+    void add(const Data& data, size_t first, size_t n);
+
+    // Adds the counts of 'other', which has to have the same features, ranges, and bins
+    void merge(const FeatureHistograms& other);
+
+    // The number of bytes of the counts of the histograms of 'nFeatures' features with 'nBins'
+    // bins, which is dominated by the joint histograms
+    static uint64_t memoryUsage(size_t nFeatures, size_t nBins);
+
+private:
+    // The index of the pair (i, j) with i < j in the list of all pairs
+    size_t pairIndex(size_t i, size_t j) const;
+
+    std::vector<std::string> _featureNames; // The names of the binned features
+    std::vector<float> _minimums; // The lower end of the range of each feature
+    std::vector<float> _maximums; // The upper end of the range of each feature
+    std::vector<float> _binsPerUnit; // The number of bins per unit of each feature's values
+    size_t _nBins; // The number of bins of each feature
+    uint64_t _nItems; // The number of added items
+    std::vector<uint64_t> _counts; // The histograms of all features, one after the other
+    std::vector<uint64_t> _jointCounts; // The joint histograms of all pairs, see jointHistogram
+    std::vector<size_t> _bins; // The bins of the item that is added; reused to avoid allocations
+};
+
+inline size_t FeatureHistograms::bin(size_t feature, float value) const {
+    const float position = (value - _minimums[feature]) * _binsPerUnit[feature];
+	// This also sorts NaN into the first bin
+    if (!(position > 0.f))
+        return 0;
+    if (position >= float(_nBins))
+        return _nBins - 1;
+    return static_cast<size_t>(position);
+}
+
+inline void FeatureHistograms::add(const float* values, size_t stride) {
+    const size_t nFeatures = _featureNames.size();
+    const size_t binsSquared = _nBins * _nBins;
+    for (size_t f = 0; f < nFeatures; ++f) {
+        _bins[f] = bin(f, values[f * stride]);
+        ++_counts[f * _nBins + _bins[f]];
+    }
+    uint64_t* joint = _jointCounts.empty() ? 0 : &_jointCounts[0];
+    for (size_t i = 0; i < nFeatures; ++i) {
+        for (size_t j = i + 1; j < nFeatures; ++j) {
+            ++joint[_bins[j] * _nBins + _bins[i]];
+            joint += binsSquared;
+        }
+    }
+    ++_nItems;
+}
+
+typedef GenericPort<FeatureHistograms> FeatureHistogramsPort;
+
+} // namespace voreen
+
+#endif // VRN_TNM_HISTOGRAMS_H
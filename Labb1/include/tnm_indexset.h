@@ -0,0 +1,141 @@
+#ifndef VRN_TNM_INDEXSET_H
+#define VRN_TNM_INDEXSET_H
+
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace voreen {
+
+// A set of voxel indices stored as a compressed bitmap, in the manner of roaring bitmaps. The
+// indices are partitioned by their upper 16 bits; the lower 16 bits of each partition are kept
+// in a container that is either a sorted array of at most ARRAY_LIMIT elements, 2 bytes per
+// index, or a bitmap of 65536 bits for denser partitions. Compared to a std::set, which needs
+// about 40 bytes per element, a selection of millions of voxels fits into a few megabytes, and
+// unions and intersections work on whole containers instead of single elements.
+// The iteration visits the indices in ascending order
+class IndexSet {
+public:
+    // The largest number of indices a container stores as an array
+    static const size_t ARRAY_LIMIT = 4096;
+
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef unsigned int value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const unsigned int* pointer;
+        typedef unsigned int reference;
+
+        const_iterator();
+
+        unsigned int operator*() const;
+        const_iterator& operator++();
+        const_iterator operator++(int);
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+    private:
+        friend class IndexSet;
+        const_iterator(const IndexSet* set, size_t container);
+
+        // Moves to the first index of the current container at or after _position, or to the
+        // next container if there is none
+        void settle();
+
+        const IndexSet* _set;
+        size_t _container; // The index of the current container, or the number of containers at the end
+        size_t _position; // The position in the array, or the bit in the bitmap, of the current index
+    };
+
+    IndexSet();
+
+    // Adds 'index'; returns false if it was already contained
+    bool insert(unsigned int index);
+
+    // Removes 'index'; returns false if it was not contained
+    bool erase(unsigned int index);
+
+    bool contains(unsigned int index) const;
+
+    // The number of indices
+    size_t size() const;
+    bool empty() const;
+
+    void clear();
+
+    void swap(IndexSet& other);
+
+    // Adds all indices of 'other'
+    IndexSet& operator|=(const IndexSet& other);
+
+    // Removes all indices that are not contained in 'other'
+    IndexSet& operator&=(const IndexSet& other);
+
+    // Removes all indices that are contained in 'other'
+    IndexSet& operator-=(const IndexSet& other);
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // The number of bytes of the containers
+    size_t memoryUsage() const;
+
+    // Returns a compact binary encoding of the set. Each container is stored in the smallest of
+    // three forms: its array, its bitmap, or the runs of consecutive indices, so that a selection
+    // of millions of voxels takes at most a few bytes per 16 indices
+    std::string encode() const;
+
+    // Replaces the indices by the ones encoded in 'bytes' by encode(). Returns false, and leaves
+    // the set empty, if 'bytes' is not a valid encoding
+    bool decode(const std::string& bytes);
+
+    bool operator==(const IndexSet& rhs) const;
+    bool operator!=(const IndexSet& rhs) const;
+
+private:
+    // The lower 16 bits of the indices of one partition. Exactly one of 'array' and 'bitmap' is
+    // used, depending on the cardinality, so that equal sets have equal containers
+    struct Container {
+        Container();
+
+        bool contains(uint16_t low) const;
+
+        // Converts between the array and the bitmap, whichever matches the cardinality
+        void normalize();
+
+        bool operator==(const Container& rhs) const;
+
+        size_t cardinality; // The number of indices
+        std::vector<uint16_t> array; // The sorted indices if cardinality <= ARRAY_LIMIT
+        std::vector<uint64_t> bitmap; // 65536 bits if cardinality > ARRAY_LIMIT
+    };
+
+    // The position of the container of the partition 'high' in _keys, or the position where it
+    // has to be inserted
+    size_t findContainer(uint16_t high) const;
+
+    std::vector<uint16_t> _keys; // The upper 16 bits of each partition, in ascending order
+    std::vector<Container> _containers; // The container of each element of _keys
+    size_t _size; // The number of indices
+};
+
+IndexSet operator|(IndexSet lhs, const IndexSet& rhs);
+IndexSet operator&(IndexSet lhs, const IndexSet& rhs);
+IndexSet operator-(IndexSet lhs, const IndexSet& rhs);
+
+inline size_t IndexSet::size() const {
+    return _size;
+}
+
+inline bool IndexSet::empty() const {
+    return _size == 0;
+}
+
+} // namespace voreen
+
+#endif // VRN_TNM_INDEXSET_H
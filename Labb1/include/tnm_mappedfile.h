@@ -0,0 +1,70 @@
+#ifndef VRN_TNM_MAPPEDFILE_H
+#define VRN_TNM_MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace voreen {
+
+// A memory mapping of a whole file. The pages are only loaded from disk when they are accessed
+// and are shared with the operating system's file cache
+class MappedFile {
+public:
+    // How the mapping can be accessed
+    enum Mode {
+        ReadOnly, // Writing to the mapping is not allowed
+        CopyOnWrite, // Written pages become private copies; the file is never changed
+        ReadWrite // Writes go to the file
+    };
+
+    MappedFile();
+    ~MappedFile();
+
+    // Maps the file 'fileName'; returns false if the file does not exist or cannot be mapped.
+    // A previously opened file is closed first
+    bool open(const std::string& fileName, Mode mode = ReadOnly);
+
+    // Creates the file 'fileName' with 'size' bytes, replacing an existing file, and maps it
+    // with ReadWrite access. The content is initialized to 0. If 'isTemporary' is set, the file
+    // is deleted when it is closed, and also if the process ends without closing it
+    bool create(const std::string& fileName, size_t size, bool isTemporary = false);
+
+    // Writes the modified pages in the 'size' bytes starting at 'offset' to the file and drops
+    // them from the memory of the process; they are read back from the file when they are
+    // accessed again. This bounds the memory used while a large file is written piece by piece
+    void release(size_t offset, size_t size);
+
+    // Unmaps the file
+    void close();
+
+    bool isOpen() const;
+
+    // The first byte of the mapped file, or 0 if no file is open. The non-const version may
+    // only be written to if the file was not opened ReadOnly
+    const char* data() const;
+    char* data();
+
+    // The size of the mapped file in bytes
+    size_t size() const;
+
+private:
+    // Mappings can not be shared, so copying is forbidden
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    // Maps the already opened file with the given mode
+    bool map(Mode mode);
+
+    char* _data; // The start of the mapping
+    size_t _size; // The length of the mapping
+#ifdef _WIN32
+    void* _file; // The HANDLE of the file
+    void* _mapping; // The HANDLE of the file mapping object
+#else
+    int _file; // The file descriptor
+#endif
+};
+
+} // namespace voreen
+
+#endif // VRN_TNM_MAPPEDFILE_H
@@ -0,0 +1,86 @@
+#ifndef VRN_TNM_PARALLEL_H
+#define VRN_TNM_PARALLEL_H
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace voreen {
+
+// Returns the number of hardware threads, or 1 if it cannot be determined
+inline int hardwareThreadCount() {
+    const unsigned int n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : static_cast<int>(n);
+}
+
+// Calls task(i, thread) for every i in [0, nTasks) using a pool of nThreads worker threads and
+// returns once all tasks are finished. 'thread' is the index in [0, nThreads) of the worker that
+// runs the task, so that tasks can accumulate into per-thread state without locking. The tasks
+// are handed out one by one, so threads that finish early pick up the remaining work. With
+// nThreads <= 1 the tasks are run on the calling thread in ascending order. The task object is
+// shared between the threads and must not be modified by its call operator
+template <typename Task>
+void parallelForThreads(size_t nTasks, size_t nThreads, const Task& task) {
+    if (nThreads > nTasks)
+        nThreads = nTasks;
+
+    if (nThreads <= 1) {
+        for (size_t i = 0; i < nTasks; ++i)
+            task(i, 0);
+        return;
+    }
+
+    struct Worker {
+        static void run(const Task* task, std::atomic<size_t>* nextTask, size_t nTasks, size_t thread) {
+            for (size_t i = (*nextTask)++; i < nTasks; i = (*nextTask)++)
+                (*task)(i, thread);
+        }
+    };
+
+    std::atomic<size_t> nextTask(0);
+    std::vector<std::thread> workers;
+    workers.reserve(nThreads - 1);
+	// The calling thread is the last member of the pool instead of waiting idly
+    for (size_t i = 0; i < nThreads - 1; ++i)
+        workers.push_back(std::thread(&Worker::run, &task, &nextTask, nTasks, i));
+    Worker::run(&task, &nextTask, nTasks, nThreads - 1);
+
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+}
+
+// Calls task(i) for every i in [0, nTasks), see parallelForThreads
+template <typename Task>
+void parallelFor(size_t nTasks, size_t nThreads, const Task& task) {
+    struct IgnoreThread {
+        const Task* task;
+        void operator()(size_t i, size_t) const { (*task)(i); }
+    };
+    IgnoreThread wrapper = { &task };
+    parallelForThreads(nTasks, nThreads, wrapper);
+}
+
+// Combines the partial results in 'parts' into parts[0] with a binary tree of calls to
+// merge(a, b), which has to add b to a. The merges of each level of the tree are independent and
+// run in parallel, so n parts are combined in log2(n) steps instead of n - 1
+template <typename T, typename Merge>
+void parallelReduce(std::vector<T>& parts, size_t nThreads, const Merge& merge) {
+    struct Level {
+        std::vector<T>* parts;
+        const Merge* merge;
+        size_t stride;
+        void operator()(size_t i) const {
+            (*merge)((*parts)[2 * i * stride], (*parts)[(2 * i + 1) * stride]);
+        }
+    };
+    for (size_t stride = 1; stride < parts.size(); stride *= 2) {
+        Level level = { &parts, &merge, stride };
+	// Pairs whose second part is beyond the end are left for a later level
+        parallelFor((parts.size() - stride + 2 * stride - 1) / (2 * stride), nThreads, level);
+    }
+}
+
+} // namespace voreen
+
+#endif // VRN_TNM_PARALLEL_H
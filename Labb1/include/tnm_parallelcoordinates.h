@@ -93,6 +93,20 @@ protected:
     };
 
 private:
+	// Creates two handles for each feature of 'data' and looks up the value range of every axis
+    void updateAxes(const Data& data);
+
+	// The x coordinate of the axis with the given index out of 'nAxes' axes; the axes are spread
+	// evenly over [-AXIS_EXTENT, AXIS_EXTENT], so that the handles lie on the visible axes
+    static float axisX(size_t axis, size_t nAxes);
+
+	// The y coordinate of the value of 'item' on 'axis', normalized by the range of the axis
+    float axisY(const Data& data, size_t item, size_t axis) const;
+
+	// Recomputes the lines that lie outside of the handles and publishes the indices that were
+	// brushed or unbrushed since the last call to _brushingIndices
+    void updateBrushing();
+
 	// The inport supplying the data to this processor
     DataPort _inport;
 
@@ -116,12 +130,15 @@ private:
 	// mouseClick and the mouseMove methods to store the ID that was clicked
     int _pickedHandle;
 
+    std::vector<float> _minimum; // The smallest value of each axis
+    std::vector<float> _maximum; // The largest value of each axis
+
 	//
 	IndexProperty _brushingIndices;  // A list of voxel indices that should be ignored in the rendering
 	IndexProperty _linkingIndices; // A list of voxel indices that should be enhanced during rendering
 
-	std::set<unsigned int> _brushingList; // The_data internal storage for the list of ignored voxels
-	std::set<unsigned int> _linkingList; // The internal storage for the list of selected voxels
+	IndexSet _brushingList; // The_data internal storage for the list of ignored voxels
+	IndexSet _linkingList; // The internal storage for the list of selected voxels
 };
 
 } // namespace
@@ -36,6 +36,7 @@ private:
     void adjustPropertyVisibilities();
 
     VolumePort volumeInport_;
+    VolumePort gradientInport_;       ///< optional precomputed gradients, e.g. of TNMVolumeInformation
     RenderPort entryPort_;
     RenderPort exitPort_;
 
@@ -0,0 +1,41 @@
+#ifndef VRN_TNM_ROWKERNELS_H
+#define VRN_TNM_ROWKERNELS_H
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace voreen {
+
+// A set of kernels that compute the measures of TNMVolumeInformation for a contiguous run of
+// interior voxels along x. There is a scalar implementation and, on x86, SSE2 and AVX2
+// implementations; all of them produce bit-identical results, as every value is derived from
+// exact integer sums with a fixed order of correctly rounded floating point operations
+struct RowKernels {
+    // The name of the instruction set, used for logging
+    const char* name;
+
+    // Computes the central difference gradient magnitude for the 'n' 16 bit voxels starting at
+    // 'voxels'. The neighbors at +-1, +-rowStride and +-sliceStride have to be valid
+    void (*gradientMagnitude)(const uint16_t* voxels, ptrdiff_t rowStride, ptrdiff_t sliceStride,
+        size_t n, float* magnitudes);
+
+    // Computes the average and sample standard deviation of 'n' consecutive boxes from a summed
+    // volume table. 'sum' and 'sumSquared' point to the lower corner entry of the first box and
+    // dX, dY, and dZ are the offsets to the other corners. The box volume 'count' has to be
+    // larger than 1 and small enough that count^2 * 65535^2 < 2^53, which holds for boxes up to
+    // 11x11x11. 'offset' is the value that was added to every voxel to make it unsigned and is
+    // subtracted from the averages again
+    void (*boxStatistics)(const uint64_t* sum, const uint64_t* sumSquared,
+        ptrdiff_t dX, ptrdiff_t dY, ptrdiff_t dZ, uint64_t count, double offset, size_t n,
+        float* averages, float* stdDeviations);
+};
+
+// Returns the fastest kernel set supported by the CPU; the check is done only once
+const RowKernels& rowKernels();
+
+// Returns the portable scalar kernels, which serve as the reference for the vectorized ones
+const RowKernels& scalarRowKernels();
+
+} // namespace voreen
+
+#endif // VRN_TNM_ROWKERNELS_H
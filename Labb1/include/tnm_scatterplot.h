@@ -27,6 +27,18 @@ protected:
     void process();
 
 private:
+    // Replaces the options of both axes by 'featureNames'; the selected axes are kept if the
+    // feature with the same index still exists
+    void updateAxisOptions(const std::vector<std::string>& featureNames);
+
+	// Recomputes the positions and the flags of all items of 'data' and uploads them
+    void rebuildBuffers(const Data& data);
+
+	// Sets or clears 'flag' for the items of 'data' with the voxel indices in 'indices'. The
+	// range of the changed items is extended in 'first' and 'last'
+    void updateFlags(const Data& data, const IndexSet& indices, unsigned char flag, bool set,
+        size_t& first, size_t& last);
+
     DataPort _inport; // The data that is to be rendered
     RenderPort _outport; // A wrapping class for multiple framebufferobjects that can be rendered to
 
@@ -35,9 +47,20 @@ private:
 	// A wrapper for an integer member variable that can be set using the GUI
     IntOptionProperty _firstAxis; 
     IntOptionProperty _secondAxis;
+    std::vector<std::string> _featureNames; // The features the options of the axes were created from
 
 	IndexProperty _brushingIndices; // A list of voxel indices that should be ignored in the rendering
 	IndexProperty _linkingIndices; // A list of voxel indices that should be enhanced during rendering
+
+	// The vertex buffers contain all items, also the brushed ones, and are kept between frames.
+	// As long as the data and the axes stay the same, a change of the brushing or the linking
+	// only updates the flags of the items whose indices changed
+	GLuint _positionVbo; // The normalized position of each item
+	GLuint _flagVbo; // The flags of each item
+	std::vector<unsigned char> _flags; // A copy of the flags in _flagVbo
+	int _bufferAxes[2]; // The features of the positions in _positionVbo
+	uint64_t _brushingVersion; // The version of _brushingIndices the flags belong to
+	uint64_t _linkingVersion; // The version of _linkingIndices the flags belong to
 };
 
 } // namespace
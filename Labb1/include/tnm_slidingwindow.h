@@ -0,0 +1,99 @@
+#ifndef VRN_TNM_SLIDINGWINDOW_H
+#define VRN_TNM_SLIDINGWINDOW_H
+
+#include "voreen/core/datastructures/volume/volumeatomic.h"
+#include "tgt/vector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace voreen {
+
+// Computes the sum and the sum of squares of the box with a fixed radius around every voxel by
+// filtering the volume with a one-dimensional running sum along x, then y, then z. A running sum
+// adds the voxel entering the window and subtracts the one leaving it, so the cost per voxel is
+// independent of the radius. Boxes are clipped against the volume, which keeps the filter
+// separable, as the clipped box is still the product of three intervals.
+// In contrast to the SummedVolumeTable, the sums are kept in double precision, so this also
+// works for floating point volumes. To reduce the cancellation in the standard deviation, the
+// mean of the voxels is subtracted from every voxel before the sums are computed.
+// Like the SummedVolumeTable, the sums can be restricted to the slices [firstSlice, endSlice),
+// with the same requirements on the slices around the queried voxels
+class SlidingWindowStatistics {
+public:
+    SlidingWindowStatistics();
+
+    // Computes the box sums for the slices [firstSlice, endSlice) of the passed volume and the
+    // radius; the memory of a previous build is reused
+    void build(const VolumeUInt8* volume, size_t radius, size_t firstSlice, size_t endSlice);
+    void build(const VolumeUInt16* volume, size_t radius, size_t firstSlice, size_t endSlice);
+    void build(const VolumeInt16* volume, size_t radius, size_t firstSlice, size_t endSlice);
+    void build(const VolumeFloat* volume, size_t radius, size_t firstSlice, size_t endSlice);
+
+    // Frees the memory of the box sums
+    void clear();
+
+    // The radius the statistics were built for
+    size_t getRadius() const;
+
+    // The number of bytes the box sums need for 'nSlices' slices of a volume with 'dimensions'
+    static size_t memoryUsage(const tgt::svec3& dimensions, size_t nSlices);
+
+    // Computes the average and the sample standard deviation (normalized by count-1) of the
+    // voxels in the clipped box around (x,y,z)
+    void neighborhood(size_t x, size_t y, size_t z, float& average, float& stdDeviation) const;
+
+    // Computes neighborhood for the 'n' voxels starting at (x,y,z) along the x axis
+    void neighborhoodRow(size_t x, size_t y, size_t z, size_t n, float* averages, float* stdDeviations) const;
+
+private:
+    template <typename T>
+    void build(const VolumeAtomic<T>* volume, size_t firstSlice, size_t endSlice);
+
+    // The number of voxels of the window around 'center' clipped against [begin, end)
+    size_t windowSize(size_t center, size_t begin, size_t end) const;
+
+    tgt::svec3 _dimensions; // The dimensions of the volume
+    size_t _firstSlice; // The first slice contained in the sums
+    size_t _endSlice; // One past the last slice contained in the sums
+    size_t _radius; // The radius of the box
+    double _shift; // The mean of the voxels, which was subtracted from every voxel
+    std::vector<double> _sum; // The box sums of the shifted voxel values
+    std::vector<double> _sumSquared; // The box sums of the squared shifted voxel values
+};
+
+inline size_t SlidingWindowStatistics::windowSize(size_t center, size_t begin, size_t end) const {
+    const size_t first = std::max(center > _radius ? center - _radius : 0, begin);
+    const size_t last = std::min(center + _radius, end - 1);
+    return last - first + 1;
+}
+
+inline void SlidingWindowStatistics::neighborhood(size_t x, size_t y, size_t z,
+    float& average, float& stdDeviation) const
+{
+    const double count = double(windowSize(x, 0, _dimensions.x) * windowSize(y, 0, _dimensions.y)
+        * windowSize(z, _firstSlice, _endSlice));
+    const size_t i = ((z - _firstSlice) * _dimensions.y + y) * _dimensions.x + x;
+    const double sum = _sum[i];
+
+    average = static_cast<float>(sum / count + _shift);
+    if (count > 1) {
+	// Rounding errors of the running sums can make the numerator slightly negative
+        const double numerator = std::max(_sumSquared[i] - sum * sum / count, 0.0);
+        stdDeviation = static_cast<float>(std::sqrt(numerator / (count - 1)));
+    }
+    else
+        stdDeviation = 0.f;
+}
+
+inline void SlidingWindowStatistics::neighborhoodRow(size_t x, size_t y, size_t z, size_t n,
+    float* averages, float* stdDeviations) const
+{
+    for (size_t i = 0; i < n; ++i)
+        neighborhood(x + i, y, z, averages[i], stdDeviations[i]);
+}
+
+} // namespace voreen
+
+#endif // VRN_TNM_SLIDINGWINDOW_H
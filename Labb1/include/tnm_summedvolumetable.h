@@ -0,0 +1,142 @@
+#ifndef VRN_TNM_SUMMEDVOLUMETABLE_H
+#define VRN_TNM_SUMMEDVOLUMETABLE_H
+
+#include "modules/tnm093/include/tnm_rowkernels.h"
+#include "voreen/core/datastructures/volume/volumeatomic.h"
+#include "tgt/vector.h"
+
+#include <cmath>
+#include <vector>
+
+namespace voreen {
+
+// A summed volume table is the three-dimensional version of an integral image. Entry (x,y,z)
+// contains the sum of all voxels with smaller x, y, and z coordinates, so that the sum over
+// any axis-aligned box can be retrieved with eight lookups, independent of the box size.
+// The table is stored for the voxel values as well as for the squared voxel values, which is
+// enough to derive the mean and the standard deviation of a box in O(1).
+// All sums are kept as 64 bit integers, so the results are exact for 8 and 16 bit volumes.
+// Signed voxels are shifted into the unsigned range before they are summed. Floating point
+// volumes are not supported, as their sums could not be kept exact.
+// A table can be restricted to the slices [firstSlice, endSlice) of the volume. Boxes are then
+// clipped against these slices as well, so the range has to include the 'radius' slices around
+// all voxels that are queried, unless they lie outside of the volume anyway. All coordinates
+// passed to the queries are coordinates in the whole volume
+class SummedVolumeTable {
+public:
+    SummedVolumeTable();
+
+    // Computes both tables for the slices [firstSlice, endSlice) of the passed volume; the
+    // memory of a previous build is reused
+    void build(const VolumeUInt8* volume, size_t firstSlice, size_t endSlice);
+    void build(const VolumeUInt16* volume, size_t firstSlice, size_t endSlice);
+    void build(const VolumeInt16* volume, size_t firstSlice, size_t endSlice);
+
+    // Frees the memory of the tables
+    void clear();
+
+    // The dimensions of the volume the table was built for
+    const tgt::svec3& getDimensions() const;
+
+    // The number of bytes the tables need for 'nSlices' slices of a volume with 'dimensions'
+    static size_t memoryUsage(const tgt::svec3& dimensions, size_t nSlices);
+
+    // Returns the number of voxels, the sum, and the sum of squares inside the box given by
+    // the inclusive corners llf and urb. Both corners have to lie inside the slices of the table
+    void boxSums(const tgt::svec3& llf, const tgt::svec3& urb,
+        uint64_t& count, uint64_t& sum, uint64_t& sumSquared) const;
+
+    // Computes the average and the sample standard deviation (normalized by count-1) of the
+    // voxels in the box with the given radius around 'center'. The box is clipped against the
+    // volume boundaries, matching the neighborhood used by TNMVolumeInformation
+    void neighborhood(const tgt::svec3& center, size_t radius, float& average, float& stdDeviation) const;
+
+    // Same as neighborhood, but without clipping the box, so the box around (x,y,z) has to lie
+    // completely inside the volume. This is meant for the branch-free interior loops
+    void interiorNeighborhood(size_t x, size_t y, size_t z, size_t radius,
+        float& average, float& stdDeviation) const;
+
+    // Computes interiorNeighborhood for the 'n' voxels starting at (x,y,z) along the x axis
+    // using the passed row kernels
+    void interiorNeighborhoodRow(size_t x, size_t y, size_t z, size_t n, size_t radius,
+        const RowKernels& kernels, float* averages, float* stdDeviations) const;
+
+private:
+    // Builds the tables from the voxel values plus 'offset', which has to make all of them
+    // non-negative and smaller than 2^16
+    template <typename T>
+    void build(const VolumeAtomic<T>* volume, size_t firstSlice, size_t endSlice, int offset);
+
+    // Converts the sums over 'count' voxels into the average and sample standard deviation
+    void statistics(uint64_t count, uint64_t sum, uint64_t sumSquared,
+        float& average, float& stdDeviation) const;
+
+    // Returns the linear index of the table entry (x,y,z), where z is relative to _firstSlice; the
+    // table has one more entry than the slices in each dimension, so that the zero border needs
+    // no special treatment
+    size_t index(size_t x, size_t y, size_t z) const;
+
+    tgt::svec3 _dimensions; // The dimensions of the volume
+    size_t _firstSlice; // The first slice contained in the table
+    size_t _endSlice; // One past the last slice contained in the table
+    double _offset; // The value that was added to every voxel before summing
+    std::vector<uint64_t> _sum; // The summed voxel values
+    std::vector<uint64_t> _sumSquared; // The summed squared voxel values
+};
+
+inline size_t SummedVolumeTable::index(size_t x, size_t y, size_t z) const {
+    return (z * (_dimensions.y + 1) + y) * (_dimensions.x + 1) + x;
+}
+
+inline void SummedVolumeTable::statistics(uint64_t count, uint64_t sum, uint64_t sumSquared,
+    float& average, float& stdDeviation) const
+{
+	// The offset is an integer below 2^16, so subtracting it from the average is exact
+    average = static_cast<float>(double(sum) / double(count) - _offset);
+
+	// n * sum(x^2) - sum(x)^2 is computed exactly in integers, which avoids the cancellation
+	// that makes the textbook one-pass formula unstable in floating point
+    if (count > 1) {
+        const uint64_t numerator = count * sumSquared - sum * sum;
+        stdDeviation = static_cast<float>(std::sqrt(double(numerator) / double(count * (count - 1))));
+    }
+    else
+        stdDeviation = 0.f;
+}
+
+inline void SummedVolumeTable::interiorNeighborhood(size_t x, size_t y, size_t z, size_t radius,
+    float& average, float& stdDeviation) const
+{
+    const size_t width = 2 * radius + 1;
+    const uint64_t count = uint64_t(width) * width * width;
+
+	// The eight corners are fixed offsets from the lower corner, so no clipping is needed
+    const size_t dX = width;
+    const size_t dY = width * (_dimensions.x + 1);
+    const size_t dZ = width * (_dimensions.x + 1) * (_dimensions.y + 1);
+    const size_t i = index(x - radius, y - radius, z - radius - _firstSlice);
+
+    const uint64_t* s = &_sum[i];
+    const uint64_t sum = s[dZ + dY + dX] - s[dY + dX] - s[dZ + dX] - s[dZ + dY] + s[dX] + s[dY] + s[dZ] - s[0];
+    const uint64_t* q = &_sumSquared[i];
+    const uint64_t sumSquared = q[dZ + dY + dX] - q[dY + dX] - q[dZ + dX] - q[dZ + dY] + q[dX] + q[dY] + q[dZ] - q[0];
+
+    statistics(count, sum, sumSquared, average, stdDeviation);
+}
+
+inline void SummedVolumeTable::interiorNeighborhoodRow(size_t x, size_t y, size_t z, size_t n,
+    size_t radius, const RowKernels& kernels, float* averages, float* stdDeviations) const
+{
+    const size_t width = 2 * radius + 1;
+    const uint64_t count = uint64_t(width) * width * width;
+    const ptrdiff_t dX = width;
+    const ptrdiff_t dY = width * (_dimensions.x + 1);
+    const ptrdiff_t dZ = width * (_dimensions.x + 1) * (_dimensions.y + 1);
+    const size_t i = index(x - radius, y - radius, z - radius - _firstSlice);
+
+    kernels.boxStatistics(&_sum[i], &_sumSquared[i], dX, dY, dZ, count, _offset, n, averages, stdDeviations);
+}
+
+} // namespace voreen
+
+#endif // VRN_TNM_SUMMEDVOLUMETABLE_H
@@ -1,12 +1,34 @@
 #ifndef VRN_TNM_VOLUMEINFORMATION_H
 #define VRN_TNM_VOLUMEINFORMATION_H
 
+#include "voreen/core/datastructures/volume/volumecollection.h"
+#include "voreen/core/datastructures/volume/volumehandle.h"
 #include "voreen/core/processors/processor.h"
+#include "voreen/core/properties/boolproperty.h"
+#include "voreen/core/properties/buttonproperty.h"
+#include "voreen/core/properties/filedialogproperty.h"
+#include "voreen/core/properties/floatproperty.h"
+#include "voreen/core/properties/intproperty.h"
+#include "voreen/core/properties/optionproperty.h"
+#include "voreen/core/properties/vectorproperty.h"
 #include "modules/tnm093/include/tnm_common.h"
+#include "modules/tnm093/include/tnm_featurecache.h"
+#include "modules/tnm093/include/tnm_histograms.h"
+#include "tgt/event/eventhandler.h"
+#include "tgt/timer.h"
+
+#include <memory>
 
 namespace voreen {
 
-class TNMVolumeInformation : public Processor {
+class Feature;
+
+// Extracts the features on a background thread, so that the network stays responsive while
+// large volumes are processed. The outport stays empty until the extraction is complete.
+// If a time series is connected, the features of all of its timeframes are extracted and the
+// selected timeframe is provided on the outport. The packed gradients of the volumes can be
+// provided for TNMRaycaster as well
+class TNMVolumeInformation : public Processor, public VolumeHandleObserver {
 public:
     TNMVolumeInformation();
     ~TNMVolumeInformation();
@@ -16,14 +38,107 @@ public:
 
     Processor* create() const          { return new TNMVolumeInformation; }
 
+    bool isReady() const;
+
+    // The ways the average and standard deviation of the neighborhood can be computed
+    enum NeighborhoodMethod {
+        NeighborhoodMethodSummedVolumeTable, // O(1) lookups into an exact summed volume table
+        NeighborhoodMethodSlidingWindow, // Separable running sums, also for floating point volumes
+        NeighborhoodMethodBruteForce // Visits all neighbors of every voxel; kept as a reference
+    };
+
+    // Cancels a running extraction of the volume before it is deleted or modified
+    void volumeHandleDelete(const VolumeHandleBase* source);
+    void volumeChange(const VolumeHandleBase* source);
+
+    // Polls the running extraction for its progress and whether it is finished
+    void timerEvent(tgt::TimeEvent* e);
+
 protected:
     void process();
 
+    void initialize() throw (tgt::Exception);
+    void deinitialize() throw (tgt::Exception);
+
 private:
+    // The state of one extraction running on the background thread; defined in the source file
+    struct ExtractionJob;
+
+    // Makes 'job' the current job, taking ownership, and starts it on a worker thread, or runs
+    // it directly if there is no timer
+    void startJob(ExtractionJob* job);
+
+    // Stops the running extraction, if any, and waits for its thread to finish
+    void cancelJob();
+
+    // Moves the results of the finished extraction into _data, _histograms, and _gradients and
+    // provides the selected timeframe on the outports
+    void publishJob();
+
+    // Provides the data, the histograms, and the gradients of the selected timeframe on the outports
+    void publishTimeframe();
+
+    // Deletes the data and the histograms of all timeframes
+    void clearData();
+
+    // Deletes the gradient volumes of all timeframes
+    void clearGradients();
+
+    // The registered features whose property is checked, in the order of the registry
+    std::vector<const Feature*> selectedFeatures() const;
+
+    // Builds the key under which the features of 'volume' are stored in the feature cache,
+    // except for the content hash of the voxels
+    FeatureCacheKey cacheKey(const VolumeHandleBase* volumeHandle, const Volume* volume,
+        const std::vector<const Feature*>& features) const;
+
+    // Clamps the region of interest to a volume with 'dimensions'; 'end' is exclusive
+    void regionOfInterest(const tgt::svec3& dimensions, tgt::svec3& begin, tgt::svec3& end) const;
+
+    // Deletes all entries of the feature cache; called by the _clearCache button
+    void clearCache();
+
     VolumePort _inport; // The inport that contains the volume for which the information is computed
+    VolumeCollectionPort _timeSeriesInport; // The timeframes of a time series, which replace _inport
     DataPort _outport; // The outport containing the computed measures
+    FeatureHistogramsPort _histogramOutport; // The histograms of the computed measures
+    VolumePort _gradientOutport; // The normalized gradient directions and magnitudes of the volume
+
+    IntOptionProperty _neighborhoodMethod; // Selects one of the NeighborhoodMethod values
+    IntProperty _neighborhoodRadius; // The neighborhood is the box of (2*radius+1)^3 voxels around a voxel
+    IntProperty _numThreads; // The number of worker threads used for the extraction
+    std::vector<BoolProperty*> _featureProperties; // Selects each registered feature, see FeatureRegistry
+
+    BoolProperty _useCache; // Whether computed features are stored in and loaded from _cache
+    FileDialogProperty _cacheDirectory; // The directory containing the cache files
+    IntProperty _cacheSizeLimit; // The maximum size of the cache directory in megabytes
+    ButtonProperty _clearCache; // Deletes all cached features
+
+    BoolProperty _outOfCore; // Processes the volume in bricks and writes the features to a mapped file
+    IntProperty _memoryBudget; // The memory in megabytes an out-of-core extraction may use
+    IntOptionProperty _valueEncoding; // Selects the Data::ValueEncoding of the extracted values
+    IntProperty _resolutionLevel; // The level of the resolution pyramid that is extracted
+    BoolProperty _refineProgressively; // Extracts and publishes the coarser levels first
+    IntVec3Property _roiFirst; // The first voxel of the region of interest
+    IntVec3Property _roiLast; // The last voxel of the region of interest, inclusive
+    BoolProperty _useIntensityThreshold; // Whether voxels below _intensityThreshold are skipped
+    FloatProperty _intensityThreshold; // The smallest intensity of the extracted voxels
+    IntProperty _timeframe; // The timeframe of the time series that is provided on the outport
+    IntProperty _histogramBins; // The number of bins of each feature in the histograms
+    IntOptionProperty _gradientPrecision; // The bits per component of the gradient volumes, 8 or 16
+    FloatProperty _progress; // The fraction of the voxels the running extraction has finished
+
+    FeatureCache _cache; // The persistent cache of previously computed features
+
+    std::unique_ptr<ExtractionJob> _job; // The running or most recently finished extraction
+    tgt::EventHandler _eventHandler; // Receives the events of _timer
+    tgt::Timer* _timer; // Regularly calls timerEvent while an extraction is running
 
-    Data* _data; // The local copy of the computed data; ownership stays with this object at all times
+    std::vector<Data*> _data; // The computed data of each timeframe; ownership stays with this object at all times
+    std::vector<FeatureHistograms*> _histograms; // The histograms of each element of _data; owned like _data
+    std::vector<VolumeHandle*> _gradients; // The gradient volume of each timeframe; owned like _data
+    std::vector<const Volume*> _gradientSources; // The volumes _gradients were computed from
+    int _gradientBits; // The bits per component of _gradients
 };
 
 } // namespace
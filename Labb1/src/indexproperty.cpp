@@ -1,15 +1,98 @@
 #include "modules/tnm093/include/indexproperty.h"
+#include "voreen/core/io/serialization/serialization.h"
 #include "voreen/core/utils/variant.h"
 
+#include <algorithm>
+#include <map>
+
 namespace voreen {
 
+namespace {
+	const std::string loggerCat_ = "IndexProperty";
+
+	// The source of the next _id; 0 stands for no source
+	uint64_t nextPropertyId = 1;
+
+	// The existing properties by their _id, in which links look up their source
+	std::map<uint64_t, const IndexProperty*>& existingProperties() {
+		static std::map<uint64_t, const IndexProperty*> properties;
+		return properties;
+	}
+
+	const char BASE64_DIGITS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	std::string encodeBase64(const std::string& bytes) {
+		std::string text;
+		text.reserve((bytes.size() + 2) / 3 * 4);
+		for (size_t i = 0; i < bytes.size(); i += 3) {
+			const size_t n = std::min(bytes.size() - i, size_t(3));
+			uint32_t group = 0;
+			for (size_t k = 0; k < 3; ++k)
+				group = (group << 8) | (k < n ? static_cast<unsigned char>(bytes[i + k]) : 0);
+			for (size_t k = 0; k < 4; ++k)
+				text.push_back(k <= n ? BASE64_DIGITS[(group >> (18 - 6 * k)) & 63] : '=');
+		}
+		return text;
+	}
+
+	// Returns false if 'text' contains other characters than the digits and the padding
+	bool decodeBase64(const std::string& text, std::string& bytes) {
+		// The value of each character, or 64 if it is not a digit
+		unsigned char values[256];
+		std::fill(values, values + 256, 64);
+		for (unsigned char i = 0; i < 64; ++i)
+			values[static_cast<unsigned char>(BASE64_DIGITS[i])] = i;
+
+		bytes.clear();
+		bytes.reserve(text.size() / 4 * 3);
+		uint32_t group = 0;
+		size_t nDigits = 0;
+		for (size_t i = 0; i < text.size() && text[i] != '='; ++i) {
+			const unsigned char value = values[static_cast<unsigned char>(text[i])];
+			if (value == 64)
+				return false;
+			group = (group << 6) | value;
+			if (++nDigits % 4 == 0)
+				for (int k = 2; k >= 0; --k)
+					bytes.push_back(static_cast<char>((group >> (8 * k)) & 0xff));
+		}
+		// The last group of 2 or 3 digits holds 1 or 2 bytes
+		const size_t rest = nDigits % 4;
+		if (rest == 1)
+			return false;
+		for (size_t k = 0; k + 1 < rest; ++k)
+			bytes.push_back(static_cast<char>((group >> (6 * rest - 8 * (k + 1))) & 0xff));
+		return true;
+	}
+}
+
+const size_t IndexProperty::MAX_CHANGES;
+
 IndexProperty::IndexProperty(const std::string& id, const std::string& guiText) 
-    : TemplateProperty(id, guiText, std::set<unsigned int>())
-{}
+    : TemplateProperty(id, guiText, IndexSet())
+    , _id(nextPropertyId++)
+    , _version(0)
+    , _sourceId(0)
+    , _sourceVersion(0)
+    , _linkedVersion(0)
+{
+    existingProperties()[_id] = this;
+}
 
 IndexProperty::IndexProperty()
     : TemplateProperty()
-{}
+    , _id(nextPropertyId++)
+    , _version(0)
+    , _sourceId(0)
+    , _sourceVersion(0)
+    , _linkedVersion(0)
+{
+    existingProperties()[_id] = this;
+}
+
+IndexProperty::~IndexProperty() {
+    existingProperties().erase(_id);
+}
 
 Property* IndexProperty::create() const {
     return new IndexProperty;
@@ -19,18 +102,121 @@ std::string IndexProperty::getClassName() const {
     return "IndexProperty";
 }
 
+void IndexProperty::set(const IndexSet& value) {
+    if (value == value_)
+        return;
+    ++_version;
+    _changes.clear();
+    TemplateProperty<IndexSet>::set(value);
+}
+
+void IndexProperty::applyChanges(const IndexSet& added, const IndexSet& removed) {
+	// Only the indices that actually change are recorded, so that the changes of several versions
+	// can be combined
+    IndexSet changedAdded = added - value_;
+    IndexSet changedRemoved = removed & value_;
+    if (changedAdded.empty() && changedRemoved.empty())
+        return;
+
+    IndexSet value = value_;
+    value |= changedAdded;
+    value -= changedRemoved;
+
+    _changes.push_back(Change());
+    Change& change = _changes.back();
+    change.version = ++_version;
+    change.added.swap(changedAdded);
+    change.removed.swap(changedRemoved);
+    if (_changes.size() > MAX_CHANGES)
+        _changes.pop_front();
+
+	// The change is recorded before the value is set, so that the links executed by set() can
+	// already transfer it
+    TemplateProperty<IndexSet>::set(value);
+}
+
+uint64_t IndexProperty::getVersion() const {
+    return _version;
+}
+
+bool IndexProperty::getChangesSince(uint64_t version, IndexSet& added, IndexSet& removed) const {
+    added.clear();
+    removed.clear();
+    if (version == _version)
+        return true;
+    if (version > _version || _changes.empty() || _changes.front().version > version + 1)
+        return false;
+
+	// An index that is removed after it was added, or added after it was removed, has not changed
+    for (size_t i = _changes.size() - (_version - version); i < _changes.size(); ++i) {
+        const Change& change = _changes[i];
+        IndexSet nowAdded = (added - change.removed) | (change.added - removed);
+        IndexSet nowRemoved = (removed - change.added) | (change.removed - added);
+        added.swap(nowAdded);
+        removed.swap(nowRemoved);
+    }
+    return true;
+}
+
 int IndexProperty::getVariantType() const {
     return Variant::VariantTypeUserType + 1;
 }
 
 Variant IndexProperty::getVariant(bool normalized) const {
+    LinkSource source;
+    source.id = _id;
     Variant r;
-    r.set<std::set<unsigned int> >(get(), Variant::VariantTypeUserType + 1);
+    r.set<LinkSource>(source, Variant::VariantTypeUserType + 1);
     return r;
 }
 
 void IndexProperty::setVariant(const Variant& v, bool normalized) {
-    set(v.get<std::set<unsigned int> >());
+    const std::map<uint64_t, const IndexProperty*>::const_iterator i = existingProperties().find(v.get<LinkSource>().id);
+    if (i == existingProperties().end()) {
+        LWARNING("The source of the link to '" << getID() << "' does not exist anymore");
+        return;
+    }
+    const IndexProperty& source = *(i->second);
+
+	// The recorded changes of the source can only be applied if this property had the value of
+	// the source at the last transfer and has not been changed otherwise since
+    IndexSet added;
+    IndexSet removed;
+    if (source._id == _sourceId && _version == _linkedVersion && source.getChangesSince(_sourceVersion, added, removed))
+        applyChanges(added, removed);
+    else
+        set(source.get());
+
+    _sourceId = source._id;
+    _sourceVersion = source.getVersion();
+    _linkedVersion = _version;
+}
+
+void IndexProperty::serialize(XmlSerializer& s) const {
+    TemplateProperty<IndexSet>::serialize(s);
+    s.serialize("indices", encodeBase64(value_.encode()));
+}
+
+void IndexProperty::deserialize(XmlDeserializer& s) {
+    TemplateProperty<IndexSet>::deserialize(s);
+
+	// Workspaces that were saved before the indices were serialized keep the default value
+    std::string text;
+    try {
+        s.deserialize("indices", text);
+    }
+    catch (XmlSerializationNoSuchDataException&) {
+        s.removeLastError();
+        return;
+    }
+
+    std::string bytes;
+    IndexSet value;
+    if (!decodeBase64(text, bytes) || !value.decode(bytes)) {
+        LWARNING("The saved indices of '" << getID() << "' are damaged and are ignored");
+        value.clear();
+    }
+    set(value);
 }
 
 } // namespace voreen
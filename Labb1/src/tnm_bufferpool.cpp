@@ -0,0 +1,189 @@
+#include "modules/tnm093/include/tnm_bufferpool.h"
+
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace voreen {
+
+namespace {
+	// The default limit of the retained buffers: a sixteenth of the physical memory, at most
+	// MAX_DEFAULT_RETAIN_LIMIT, so that the columns of a large Data can be recycled without
+	// holding on to much memory that other applications need
+	const uint64_t MAX_DEFAULT_RETAIN_LIMIT = uint64_t(1) << 30;
+
+	uint64_t defaultRetainLimit() {
+		uint64_t physicalMemory = 0;
+#ifdef _WIN32
+		MEMORYSTATUSEX status;
+		status.dwLength = sizeof(status);
+		if (GlobalMemoryStatusEx(&status))
+			physicalMemory = status.ullTotalPhys;
+#elif defined(_SC_PHYS_PAGES) && defined(_SC_PAGESIZE)
+		const long pages = sysconf(_SC_PHYS_PAGES);
+		const long pageSize = sysconf(_SC_PAGESIZE);
+		if (pages > 0 && pageSize > 0)
+			physicalMemory = uint64_t(pages) * uint64_t(pageSize);
+#endif
+		return physicalMemory > 0 ? std::min(physicalMemory / 16, MAX_DEFAULT_RETAIN_LIMIT) : MAX_DEFAULT_RETAIN_LIMIT / 4;
+	}
+}
+
+const size_t BufferPool::HUGE_PAGE_SIZE;
+
+BufferPool::Counters::Counters()
+    : requests(0)
+    , hits(0)
+    , bytesRecycled(0)
+    , bytesAllocated(0)
+    , bytesRetained(0)
+{}
+
+BufferPool::BufferPool()
+    : _nextBuffer(0)
+    , _retainLimit(defaultRetainLimit())
+{}
+
+BufferPool::~BufferPool() {
+    trim();
+}
+
+BufferPool& BufferPool::instance() {
+	// The pool is never destroyed, so that Data objects that are destroyed during the exit of
+	// the process can still return their buffers
+    static BufferPool* pool = new BufferPool;
+    return *pool;
+}
+
+void* BufferPool::acquire(size_t bytes) {
+    const size_t size = sizeClass(bytes);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_counters.requests;
+	// The most recently returned buffer is the most likely to be resident
+        std::multimap<size_t, uint64_t>::iterator candidate = _bySize.upper_bound(size);
+        if (candidate != _bySize.begin() && (--candidate)->first == size) {
+            std::map<uint64_t, Buffer>::iterator buffer = _buffers.find(candidate->second);
+            void* memory = buffer->second.memory;
+            _buffers.erase(buffer);
+            _bySize.erase(candidate);
+            ++_counters.hits;
+            _counters.bytesRecycled += size;
+            _counters.bytesRetained -= size;
+            return memory;
+        }
+        _counters.bytesAllocated += size;
+    }
+    return allocate(size);
+}
+
+void BufferPool::release(void* buffer, size_t bytes) {
+    if (buffer == 0)
+        return;
+    const size_t size = sizeClass(bytes);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (size > _retainLimit) {
+        deallocate(buffer, size);
+        return;
+    }
+    evict(_retainLimit - size);
+    const Buffer retained = { buffer, size };
+    _buffers[_nextBuffer] = retained;
+    _bySize.insert(std::make_pair(size, _nextBuffer));
+    ++_nextBuffer;
+    _counters.bytesRetained += size;
+}
+
+void BufferPool::setRetainLimit(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _retainLimit = bytes;
+    evict(_retainLimit);
+}
+
+uint64_t BufferPool::getRetainLimit() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _retainLimit;
+}
+
+void BufferPool::trim() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    evict(0);
+}
+
+BufferPool::Counters BufferPool::getCounters() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _counters;
+}
+
+size_t BufferPool::sizeClass(size_t bytes) {
+    if (bytes <= 64)
+        return 64;
+	// For power / 2 < bytes <= power, the classes are the multiples of power / 8
+    size_t power = 128;
+    while (power < bytes)
+        power <<= 1;
+    const size_t step = power / 8;
+    return (bytes + step - 1) / step * step;
+}
+
+void BufferPool::evict(uint64_t limit) {
+    while (_counters.bytesRetained > limit && !_buffers.empty()) {
+        std::map<uint64_t, Buffer>::iterator oldest = _buffers.begin();
+        const Buffer buffer = oldest->second;
+        std::multimap<size_t, uint64_t>::iterator entry = _bySize.lower_bound(buffer.bytes);
+        while (entry->second != oldest->first)
+            ++entry;
+        _bySize.erase(entry);
+        _buffers.erase(oldest);
+        _counters.bytesRetained -= buffer.bytes;
+        deallocate(buffer.memory, buffer.bytes);
+    }
+}
+
+void* BufferPool::allocate(size_t bytes) {
+    if (bytes < HUGE_PAGE_SIZE)
+        return ::operator new(bytes);
+
+#ifdef _WIN32
+	// Large pages require the "Lock pages in memory" privilege; without it, the allocation fails
+	// and normal pages are used
+    const SIZE_T largePageSize = GetLargePageMinimum();
+    if (largePageSize > 0 && bytes % largePageSize == 0) {
+        void* memory = VirtualAlloc(0, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (memory)
+            return memory;
+    }
+    void* memory = VirtualAlloc(0, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (memory == 0)
+        throw std::bad_alloc();
+#else
+    void* memory = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+	// Transparent huge pages reduce the page faults and TLB misses of scanning the columns by a
+	// factor of 512; this is only a hint, which the kernel may ignore
+    madvise(memory, bytes, MADV_HUGEPAGE);
+#endif
+#endif
+    return memory;
+}
+
+void BufferPool::deallocate(void* buffer, size_t bytes) {
+    if (bytes < HUGE_PAGE_SIZE) {
+        ::operator delete(buffer);
+        return;
+    }
+#ifdef _WIN32
+    VirtualFree(buffer, 0, MEM_RELEASE);
+#else
+    munmap(buffer, bytes);
+#endif
+}
+
+} // namespace voreen
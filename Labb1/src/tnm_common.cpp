@@ -0,0 +1,544 @@
+#include "modules/tnm093/include/tnm_common.h"
+#include "modules/tnm093/include/tnm_bufferpool.h"
+#include "modules/tnm093/include/tnm_mappedfile.h"
+#include "modules/tnm093/include/tnm_parallel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace voreen {
+
+namespace {
+	// Copies the first 'nItems' values of each of the 'nColumns' columns that start 'stride'
+	// values apart into 'result', where they start 'resultStride' values apart. The values after
+	// the first 'nItems' of each column are undefined; resize() initializes the new items
+	template <typename T>
+	void relayoutColumns(const T* columns, size_t stride, size_t nItems, size_t nColumns,
+		PooledArray<T>& result, size_t resultStride)
+	{
+		PooledArray<T> relayouted;
+		relayouted.allocate(nColumns * resultStride);
+		for (size_t c = 0; c < nColumns && nItems > 0; ++c)
+			std::copy(columns + c * stride, columns + c * stride + nItems, &relayouted[c * resultStride]);
+		result.swap(relayouted);
+	}
+
+	// The number of items of a column each task of a StatisticsComputation scans
+	const size_t STATISTICS_CHUNK_SIZE = 65536;
+	// The number of histogram bins the quantiles are interpolated in
+	const size_t QUANTILE_BINS = 4096;
+
+	// The statistics of a chunk of a column; the variance is accumulated as the sum of the
+	// squared differences from the mean, so that the chunks can be merged without cancellation
+	struct PartialStatistics {
+		PartialStatistics()
+			: minimum(std::numeric_limits<float>::max())
+			, maximum(-std::numeric_limits<float>::max())
+			, count(0)
+			, mean(0.0)
+			, squaredDeviations(0.0)
+		{}
+
+		void merge(const PartialStatistics& other) {
+			if (other.count == 0)
+				return;
+			minimum = std::min(minimum, other.minimum);
+			maximum = std::max(maximum, other.maximum);
+			const double total = double(count + other.count);
+			const double delta = other.mean - mean;
+			mean += delta * other.count / total;
+			squaredDeviations += other.squaredDeviations + delta * delta * count * other.count / total;
+			count += other.count;
+		}
+
+		float minimum;
+		float maximum;
+		size_t count;
+		double mean;
+		double squaredDeviations;
+	};
+
+	// Decodes the chunk 'chunk' of the column 'feature' into the buffer of the thread
+	size_t decodeChunk(const Data& data, size_t feature, size_t chunk, std::vector<float>& buffer) {
+		const size_t first = chunk * STATISTICS_CHUNK_SIZE;
+		const size_t n = std::min(STATISTICS_CHUNK_SIZE, data.size() - first);
+		buffer.resize(STATISTICS_CHUNK_SIZE);
+		data.columnValues(feature, first, n, &buffer[0]);
+		return n;
+	}
+
+	// Computes the PartialStatistics of every chunk of every column; the task i is the chunk
+	// i % nChunks of the feature i / nChunks
+	struct StatisticsComputation {
+		const Data* data;
+		size_t nChunks;
+		std::vector<std::vector<float> >* buffers; // The decoded values of each thread
+		std::vector<PartialStatistics>* partials; // The statistics of each task
+
+		void operator()(size_t i, size_t thread) const {
+			std::vector<float>& values = (*buffers)[thread];
+			const size_t n = decodeChunk(*data, i / nChunks, i % nChunks, values);
+			PartialStatistics& partial = (*partials)[i];
+			double sum = 0.0;
+			for (size_t j = 0; j < n; ++j) {
+				partial.minimum = std::min(partial.minimum, values[j]);
+				partial.maximum = std::max(partial.maximum, values[j]);
+				sum += values[j];
+			}
+			partial.count = n;
+			partial.mean = (n > 0) ? sum / n : 0.0;
+			for (size_t j = 0; j < n; ++j)
+				partial.squaredDeviations += (values[j] - partial.mean) * (values[j] - partial.mean);
+		}
+	};
+
+	// Counts the values of every column in QUANTILE_BINS bins over the range of the column, with
+	// one histogram per thread and feature
+	struct QuantileHistograms {
+		const Data* data;
+		size_t nChunks;
+		const std::vector<ColumnStatistics>* statistics;
+		std::vector<std::vector<float> >* buffers; // The decoded values of each thread
+		std::vector<std::vector<uint64_t> >* counts; // The histograms of all features of each thread
+
+		void operator()(size_t i, size_t thread) const {
+			const size_t feature = i / nChunks;
+			std::vector<float>& values = (*buffers)[thread];
+			const size_t n = decodeChunk(*data, feature, i % nChunks, values);
+			const ColumnStatistics& column = (*statistics)[feature];
+			const float range = column.maximum - column.minimum;
+			const float binsPerUnit = (range > 0.f) ? QUANTILE_BINS / range : 0.f;
+			uint64_t* bins = &(*counts)[thread][feature * QUANTILE_BINS];
+			for (size_t j = 0; j < n; ++j) {
+				const float position = (values[j] - column.minimum) * binsPerUnit;
+				const size_t bin = (position > 0.f) ? std::min(static_cast<size_t>(position), QUANTILE_BINS - 1) : 0;
+				++bins[bin];
+			}
+		}
+	};
+}
+
+ColumnStatistics::ColumnStatistics()
+    : minimum(0.f)
+    , maximum(0.f)
+    , mean(0.0)
+    , variance(0.0)
+{}
+
+// The columns are borrowed from the BufferPool, so that a Data that replaces another one of the
+// same size reuses its memory instead of page faulting in fresh memory
+struct Data::Storage {
+    PooledArray<unsigned int> voxelIndices; // The column of the voxel indices
+    PooledArray<float> values; // The columns of the data values, one per feature
+    PooledArray<uint16_t> encodedValues; // Replaces 'values' for the 16 bit encodings
+};
+
+Data::Data()
+    : _hasImplicitVoxelIndices(false)
+    , _firstVoxelIndex(0)
+    , _encoding(ValueEncodingFloat32)
+    , _voxelIndexData(0)
+    , _valueData(0)
+    , _encodedValueData(0)
+    , _selectedItems(0)
+    , _size(0)
+    , _columnStride(0)
+{}
+
+Data Data::select(const std::vector<size_t>& items) const {
+	// A selection of a selection refers to the columns directly
+    std::shared_ptr<std::vector<size_t> > selection(new std::vector<size_t>(items.size()));
+    for (size_t i = 0; i < items.size(); ++i)
+        (*selection)[i] = storedItem(items[i]);
+    Data result(*this);
+    result._statistics.reset();
+    result._selection = selection;
+    result._selectedItems = selection->empty() ? 0 : &(*selection)[0];
+    result._size = items.size();
+	// An empty selection does not need the columns
+    if (!result._selectedItems)
+        result.clear();
+    return result;
+}
+
+void Data::setFeatureNames(const std::vector<std::string>& featureNames) {
+    _featureNames = featureNames;
+    _offsets.assign(featureNames.size(), 0.f);
+    _scales.assign(featureNames.size(), 1.f);
+    clear();
+}
+
+const std::vector<std::string>& Data::getFeatureNames() const {
+    return _featureNames;
+}
+
+int Data::getFeatureIndex(const std::string& name) const {
+    std::vector<std::string>::const_iterator it = std::find(_featureNames.begin(), _featureNames.end(), name);
+    if (it == _featureNames.end())
+        return -1;
+    return static_cast<int>(it - _featureNames.begin());
+}
+
+void Data::setValueEncoding(ValueEncoding encoding, const std::vector<float>& offsets,
+    const std::vector<float>& scales)
+{
+    _encoding = encoding;
+    if (encoding == ValueEncodingQuantized16) {
+        _offsets = offsets;
+        _scales = scales;
+        _offsets.resize(_featureNames.size(), 0.f);
+        _scales.resize(_featureNames.size(), 1.f);
+    }
+    clear();
+}
+
+const std::vector<float>& Data::getValueOffsets() const {
+    return _offsets;
+}
+
+const std::vector<float>& Data::getValueScales() const {
+    return _scales;
+}
+
+void Data::resize(size_t nItems) {
+    detachMappedStorage();
+    makeUnique();
+    invalidateStatistics();
+    if (nItems > _columnStride)
+        setColumnStride(nItems);
+	// Items that were removed by an earlier resize can still have values within the columns
+    if (nItems > _size) {
+        if (!_hasImplicitVoxelIndices)
+            std::fill(_voxelIndexData + _size, _voxelIndexData + nItems, 0u);
+        for (size_t f = 0; f < _featureNames.size(); ++f) {
+            if (_encoding == ValueEncodingFloat32)
+                std::fill(column(f) + _size, column(f) + nItems, 0.f);
+            else
+                std::fill(_encodedValueData + f * _columnStride + _size, _encodedValueData + f * _columnStride + nItems, uint16_t(0));
+        }
+    }
+    _size = nItems;
+}
+
+void Data::reserve(size_t nItems) {
+    detachMappedStorage();
+    makeUnique();
+    if (nItems > _columnStride)
+        setColumnStride(nItems);
+}
+
+void Data::clear() {
+	// Other Data sharing the columns keep them
+    _storage.reset();
+    _mappedStorage.reset();
+    _selection.reset();
+    _statistics.reset();
+    _selectedItems = 0;
+    _hasImplicitVoxelIndices = false;
+    _firstVoxelIndex = 0;
+    _size = 0;
+    _columnStride = 0;
+    updatePointers();
+}
+
+void Data::append(const Data& other, size_t item) {
+    detachMappedStorage();
+    makeUnique();
+    invalidateStatistics();
+	// The columns grow geometrically, as each growth moves all of them
+    if (_size == _columnStride)
+        setColumnStride(std::max<size_t>(2 * _columnStride, 16));
+    const size_t newItem = _size++;
+    setVoxelIndex(newItem, other.voxelIndex(item));
+    const size_t nFeatures = _featureNames.size();
+	// Items with the same encoding are copied without decoding them
+    if (_encoding != ValueEncodingFloat32 && hasSameEncoding(other)) {
+        const size_t otherItem = other.storedItem(item);
+        for (size_t f = 0; f < nFeatures; ++f)
+            _encodedValueData[f * _columnStride + newItem] = other._encodedValueData[f * other._columnStride + otherItem];
+    }
+    else {
+        for (size_t f = 0; f < nFeatures; ++f)
+            setValue(newItem, f, other.value(item, f));
+    }
+}
+
+void Data::copyItems(size_t first, const Data& other, size_t otherFirst, size_t n) {
+    makeUnique();
+    invalidateStatistics();
+    const size_t nFeatures = _featureNames.size();
+    if (_hasImplicitVoxelIndices || other._voxelIndexData == 0 || other.isSelection()) {
+        for (size_t i = 0; i < n; ++i)
+            setVoxelIndex(first + i, other.voxelIndex(otherFirst + i));
+    }
+    else
+        std::copy(other._voxelIndexData + otherFirst, other._voxelIndexData + otherFirst + n, _voxelIndexData + first);
+    if (!other.isSelection() && hasSameEncoding(other)) {
+        const size_t bytesPerValue = getBytesPerValue();
+        for (size_t f = 0; f < nFeatures; ++f) {
+            std::memcpy(static_cast<char*>(getRawColumn(f)) + first * bytesPerValue,
+                static_cast<const char*>(other.getRawColumn(f)) + otherFirst * bytesPerValue, n * bytesPerValue);
+        }
+        return;
+    }
+    std::vector<float> values(n);
+    for (size_t f = 0; f < nFeatures && n > 0; ++f) {
+        other.columnValues(f, otherFirst, n, &values[0]);
+        setColumnValues(f, first, n, &values[0]);
+    }
+}
+
+void Data::setColumnValues(size_t feature, size_t first, size_t nItems, const float* values) {
+    makeUnique();
+    invalidateStatistics();
+    if (_encoding == ValueEncodingFloat32) {
+        std::copy(values, values + nItems, column(feature) + first);
+        return;
+    }
+    uint16_t* encodedValues = _encodedValueData + feature * _columnStride + first;
+    for (size_t i = 0; i < nItems; ++i)
+        encodedValues[i] = encode(feature, values[i]);
+}
+
+void Data::columnValues(size_t feature, size_t first, size_t nItems, float* values) const {
+    if (_selectedItems) {
+        for (size_t i = 0; i < nItems; ++i)
+            values[i] = value(first + i, feature);
+        return;
+    }
+    if (_encoding == ValueEncodingFloat32) {
+        std::copy(column(feature) + first, column(feature) + first + nItems, values);
+        return;
+    }
+	// The encoding is resolved once per column, so the loops are free of branches
+    const uint16_t* encodedValues = _encodedValueData + feature * _columnStride + first;
+    if (_encoding == ValueEncodingFloat16) {
+        for (size_t i = 0; i < nItems; ++i)
+            values[i] = halfToFloat(encodedValues[i]);
+    }
+    else {
+        const float offset = _offsets[feature];
+        const float scale = _scales[feature];
+        for (size_t i = 0; i < nItems; ++i)
+            values[i] = offset + scale * encodedValues[i];
+    }
+}
+
+const void* Data::getRawColumn(size_t feature) const {
+    if (_encoding == ValueEncodingFloat32)
+        return column(feature);
+    return _encodedValueData + feature * _columnStride;
+}
+
+void* Data::getRawColumn(size_t feature) {
+    makeUnique();
+    invalidateStatistics();
+    if (_encoding == ValueEncodingFloat32)
+        return column(feature);
+    return _encodedValueData + feature * _columnStride;
+}
+
+void Data::computeStatistics(size_t nQuantiles, size_t nThreads) const {
+    const size_t nFeatures = _featureNames.size();
+    const size_t nChunks = (_size + STATISTICS_CHUNK_SIZE - 1) / STATISTICS_CHUNK_SIZE;
+    std::vector<std::vector<float> > buffers(std::max<size_t>(nThreads, 1));
+    std::shared_ptr<std::vector<ColumnStatistics> > statistics(new std::vector<ColumnStatistics>(nFeatures));
+
+    std::vector<PartialStatistics> partials(nFeatures * nChunks);
+    StatisticsComputation computation = { this, nChunks, &buffers, &partials };
+    parallelForThreads(partials.size(), nThreads, computation);
+	// The chunks are merged in order, so the result does not depend on the number of threads
+    for (size_t f = 0; f < nFeatures && nChunks > 0; ++f) {
+        PartialStatistics column;
+        for (size_t c = 0; c < nChunks; ++c)
+            column.merge(partials[f * nChunks + c]);
+        ColumnStatistics& result = (*statistics)[f];
+        result.minimum = column.minimum;
+        result.maximum = column.maximum;
+        result.mean = column.mean;
+        result.variance = column.squaredDeviations / column.count;
+    }
+
+    if (nQuantiles > 0 && nChunks > 0) {
+        std::vector<std::vector<uint64_t> > counts(buffers.size(), std::vector<uint64_t>(nFeatures * QUANTILE_BINS, 0));
+        QuantileHistograms histograms = { this, nChunks, statistics.get(), &buffers, &counts };
+        parallelForThreads(nFeatures * nChunks, nThreads, histograms);
+        for (size_t t = 1; t < counts.size(); ++t) {
+            for (size_t i = 0; i < counts[0].size(); ++i)
+                counts[0][i] += counts[t][i];
+        }
+        for (size_t f = 0; f < nFeatures; ++f) {
+            ColumnStatistics& result = (*statistics)[f];
+            const uint64_t* bins = &counts[0][f * QUANTILE_BINS];
+            const float binWidth = (result.maximum - result.minimum) / QUANTILE_BINS;
+            result.quantiles.resize(nQuantiles);
+            uint64_t below = 0;
+            size_t bin = 0;
+            for (size_t q = 0; q < nQuantiles; ++q) {
+	// The quantile lies in the first bin whose cumulative count reaches its rank; the values
+	// are assumed to be spread evenly within the bin
+                const double rank = double(_size) * (q + 1) / (nQuantiles + 1);
+                while (bin < QUANTILE_BINS - 1 && below + bins[bin] < rank)
+                    below += bins[bin++];
+                const double fraction = (bins[bin] > 0) ? std::min((rank - below) / bins[bin], 1.0) : 0.0;
+                result.quantiles[q] = result.minimum + binWidth * static_cast<float>(bin + fraction);
+            }
+        }
+    }
+    _statistics = statistics;
+}
+
+const ColumnStatistics& Data::statistics(size_t feature) const {
+    if (!_statistics)
+        computeStatistics();
+    return (*_statistics)[feature];
+}
+
+void Data::setMappedStorage(const std::shared_ptr<MappedFile>& file, size_t nItems,
+    size_t voxelIndicesOffset, size_t valuesOffset)
+{
+    _storage.reset();
+    _selection.reset();
+    _statistics.reset();
+    _selectedItems = 0;
+    _mappedStorage = file;
+    _voxelIndexData = _hasImplicitVoxelIndices ? 0 : reinterpret_cast<unsigned int*>(file->data() + voxelIndicesOffset);
+    _valueData = 0;
+    _encodedValueData = 0;
+    if (_encoding == ValueEncodingFloat32)
+        _valueData = reinterpret_cast<float*>(file->data() + valuesOffset);
+    else
+        _encodedValueData = reinterpret_cast<uint16_t*>(file->data() + valuesOffset);
+    _size = nItems;
+    _columnStride = nItems;
+}
+
+const std::shared_ptr<MappedFile>& Data::getMappedStorage() const {
+    return _mappedStorage;
+}
+
+void Data::releaseItems(size_t first, size_t n) {
+    if (!_mappedStorage || n == 0)
+        return;
+    const char* begin = _mappedStorage->data();
+    if (_voxelIndexData) {
+        _mappedStorage->release(reinterpret_cast<const char*>(_voxelIndexData + first) - begin,
+            n * sizeof(unsigned int));
+    }
+    const size_t bytesPerValue = getBytesPerValue();
+    for (size_t f = 0; f < _featureNames.size(); ++f) {
+        const char* column = static_cast<const char*>(static_cast<const Data*>(this)->getRawColumn(f));
+        _mappedStorage->release(column + first * bytesPerValue - begin, n * bytesPerValue);
+    }
+}
+
+void Data::detachMappedStorage() {
+    if (_mappedStorage)
+        copyStorage();
+}
+
+void Data::copyStorage() {
+    const size_t nFeatures = _featureNames.size();
+    std::shared_ptr<Storage> storage(new Storage);
+	// The voxel indices of selected items are in general not consecutive anymore
+    const bool hasImplicitVoxelIndices = _hasImplicitVoxelIndices && !_selectedItems;
+    if (!hasImplicitVoxelIndices) {
+        storage->voxelIndices.allocate(_size);
+        for (size_t i = 0; i < _size; ++i)
+            storage->voxelIndices[i] = voxelIndex(i);
+    }
+    if (_encoding == ValueEncodingFloat32) {
+        storage->values.allocate(_size * nFeatures);
+        for (size_t f = 0; f < nFeatures && _size > 0; ++f)
+            columnValues(f, 0, _size, &storage->values[f * _size]);
+    }
+    else {
+	// The encoded values are copied without decoding them
+        storage->encodedValues.allocate(_size * nFeatures);
+        for (size_t f = 0; f < nFeatures; ++f) {
+            for (size_t i = 0; i < _size; ++i)
+                storage->encodedValues[f * _size + i] = _encodedValueData[f * _columnStride + storedItem(i)];
+        }
+    }
+    _storage = storage;
+    _mappedStorage.reset();
+    _selection.reset();
+    _selectedItems = 0;
+    _hasImplicitVoxelIndices = hasImplicitVoxelIndices;
+    _columnStride = _size;
+    updatePointers();
+}
+
+void Data::storeVoxelIndices() {
+	// A mapped file with implicit voxel indices has no room for them
+    detachMappedStorage();
+    if (!_storage)
+        _storage.reset(new Storage);
+    _storage->voxelIndices.allocate(_columnStride);
+    for (size_t i = 0; i < _columnStride; ++i)
+        _storage->voxelIndices[i] = _firstVoxelIndex + static_cast<unsigned int>(i);
+    _hasImplicitVoxelIndices = false;
+    updatePointers();
+}
+
+void Data::setImplicitVoxelIndices(unsigned int firstVoxelIndex) {
+    makeUnique();
+    _hasImplicitVoxelIndices = true;
+    _firstVoxelIndex = firstVoxelIndex;
+    if (_storage)
+        _storage->voxelIndices.reset();
+    _voxelIndexData = 0;
+}
+
+size_t Data::findItem(unsigned int voxelIndex) const {
+    if (_hasImplicitVoxelIndices) {
+        if (voxelIndex < _firstVoxelIndex || voxelIndex - _firstVoxelIndex >= (_selectedItems ? _columnStride : _size))
+            return _size;
+        const size_t offset = voxelIndex - _firstVoxelIndex;
+        if (!_selectedItems)
+            return offset;
+	// The selected items are sorted as well
+        const size_t* item = std::lower_bound(_selectedItems, _selectedItems + _size, offset);
+        return (item != _selectedItems + _size && *item == offset) ? size_t(item - _selectedItems) : _size;
+    }
+    size_t low = 0;
+    size_t high = _size;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (this->voxelIndex(middle) < voxelIndex)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return (low < _size && this->voxelIndex(low) == voxelIndex) ? low : _size;
+}
+
+void Data::setColumnStride(size_t columnStride) {
+    const size_t nItems = std::min(_size, columnStride);
+    if (!_storage)
+        _storage.reset(new Storage);
+    if (!_hasImplicitVoxelIndices)
+        relayoutColumns(_voxelIndexData, _columnStride, nItems, 1, _storage->voxelIndices, columnStride);
+    if (_encoding == ValueEncodingFloat32)
+        relayoutColumns(_valueData, _columnStride, nItems, _featureNames.size(), _storage->values, columnStride);
+    else
+        relayoutColumns(_encodedValueData, _columnStride, nItems, _featureNames.size(), _storage->encodedValues, columnStride);
+    _size = nItems;
+    _columnStride = columnStride;
+    updatePointers();
+}
+
+bool Data::hasSameEncoding(const Data& other) const {
+    if (_encoding != other._encoding)
+        return false;
+    return _encoding != ValueEncodingQuantized16 || (_offsets == other._offsets && _scales == other._scales);
+}
+
+void Data::updatePointers() {
+    _voxelIndexData = _storage ? _storage->voxelIndices.data() : 0;
+    _valueData = _storage ? _storage->values.data() : 0;
+    _encodedValueData = _storage ? _storage->encodedValues.data() : 0;
+}
+
+} // namespace voreen
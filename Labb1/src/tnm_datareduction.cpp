@@ -1,14 +1,8 @@
 #include "modules/tnm093/include/tnm_datareduction.h"
 
-namespace voreen {
-
-namespace {
-	// We will sort the data using this function to ensure a strong ordering on the voxel indices
-	bool sortByIndex(const VoxelDataItem& lhs, const VoxelDataItem& rhs) {
-		return lhs.voxelIndex < rhs.voxelIndex;
-	}
+#include <algorithm>
 
-}
+namespace voreen {
 
 TNMDataReduction::TNMDataReduction()
     : _inport(Port::INPORT, "in.data")
@@ -32,41 +26,27 @@ void TNMDataReduction::process() {
     const Data& inportData = *(_inport.getData());
     const float percentage = _percentage.get();
 
-	// Our new data
-	Data* outportData = new Data;
-
 	int newSize = int(inportData.size()*percentage);
 
+	// Shuffle the item positions instead of the items, which have a variable number of values
+	std::vector<size_t> items(inportData.size());
+	for (size_t i = 0; i < items.size(); ++i)
+		items[i] = i;
 
-    //outportData->assign(inportData.begin(), inportData.end());
-
-
-
-    //outportData->assign(outportData.begin(), outportData.begin() + newSize );
-
-
-//    for (size_t i = 0; i < inportData.size(); ++i) {
-//
-//        const VoxelDataItem& item = inportData[i];
-//        outportData->assign(i, item);
-//
-//        // Filter the 'inportData' based on the percentage and add it to 'outportData'
-//
-//
-//    }
-
-    outportData->assign(inportData.begin(), inportData.end());
-
-    std::random_shuffle (outportData->begin(), outportData->end());
-
-    outportData->erase(outportData->begin(), outportData->begin() + newSize);
+    std::random_shuffle (items.begin(), items.end());
 
+    items.erase(items.begin(), items.begin() + newSize);
 
-    //outportData->resize(newSize);
+	// sort the data by the voxel index for faster processing later; the input is already
+	// sorted by the voxel index, so it is enough to sort the positions
+	std::sort(items.begin(), items.end());
 
+	// The reduced data is a selection of the input, which shares the columns of the values
+	// instead of copying them
+	Data* outportData = new Data(inportData.select(items));
+	// The statistics of the remaining items are computed once here instead of in every renderer
+	outportData->computeStatistics();
 
-	// sort the data by the voxel index for faster processing later
-	std::sort(outportData->begin(), outportData->end(), sortByIndex);
 	// Place the new data into the outport (and transferring ownership at the same time)
     _outport.setData(outportData);
 }
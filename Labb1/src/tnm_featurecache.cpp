@@ -0,0 +1,466 @@
+#include "modules/tnm093/include/tnm_featurecache.h"
+#include "modules/tnm093/include/tnm_mappedfile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+namespace voreen {
+
+namespace {
+	// The first bytes of every cache file
+	const char MAGIC[8] = { 'T', 'N', 'M', 'F', 'E', 'A', 'T', '\0' };
+	// Has to be increased whenever the layout of the file changes
+	const uint32_t FORMAT_VERSION = 5;
+	// The extension of all cache files; no other files in the directory are ever touched
+	const std::string EXTENSION = ".tnmcache";
+
+	// A file in the cache directory together with the information needed for the eviction
+	struct CacheFile {
+		std::string path;
+		uint64_t size;
+		int64_t lastUse;
+
+		// The last use has a resolution of seconds, so files used in the same second are
+		// ordered by their path, which makes the eviction deterministic
+		bool operator<(const CacheFile& rhs) const {
+			if (lastUse != rhs.lastUse)
+				return lastUse < rhs.lastUse;
+			return path < rhs.path;
+		}
+	};
+
+	template <typename T>
+	void appendValue(std::string& buffer, const T& value) {
+		buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void appendString(std::string& buffer, const std::string& value) {
+		appendValue(buffer, static_cast<uint32_t>(value.size()));
+		buffer.append(value);
+	}
+
+	// Reads a value at 'position' and advances it; returns false if the buffer is too short
+	template <typename T>
+	bool readValue(const char* buffer, size_t size, size_t& position, T& value) {
+		if (position + sizeof(T) > size)
+			return false;
+		std::memcpy(&value, buffer + position, sizeof(T));
+		position += sizeof(T);
+		return true;
+	}
+
+	bool readString(const char* buffer, size_t size, size_t& position, std::string& value) {
+		uint32_t length;
+		if (!readValue(buffer, size, position, length) || position + length > size)
+			return false;
+		value.assign(buffer + position, length);
+		position += length;
+		return true;
+	}
+
+	// Rounds 'size' up to the next multiple of 8 bytes
+	size_t alignedSize(size_t size) {
+		return (size + 7) / 8 * 8;
+	}
+
+	// Serializes everything that identifies an entry. The header of a cache file is this block
+	// preceded by the magic number and followed by the feature names
+	std::string serializeKey(const FeatureCacheKey& key, uint32_t nFeatures, uint64_t nItems) {
+		std::string buffer;
+		appendValue(buffer, FORMAT_VERSION);
+		appendValue(buffer, nFeatures);
+		appendValue(buffer, nItems);
+		appendValue(buffer, key.contentHash);
+		appendValue(buffer, static_cast<uint64_t>(key.dimensions.x));
+		appendValue(buffer, static_cast<uint64_t>(key.dimensions.y));
+		appendValue(buffer, static_cast<uint64_t>(key.dimensions.z));
+		appendValue(buffer, static_cast<int32_t>(key.timeframe));
+		appendString(buffer, key.url);
+		appendString(buffer, key.featureSignature);
+		return buffer;
+	}
+
+	std::string serializeKeyHeader(const FeatureCacheKey& key, uint32_t nFeatures, uint64_t nItems) {
+		return std::string(MAGIC, sizeof(MAGIC)) + serializeKey(key, nFeatures, nItems);
+	}
+
+	// The complete header, padded to a multiple of 8 bytes. The feature names are followed by the
+	// encoding of the values, the offset and scale of each feature, and whether the voxel indices
+	// are implicit together with the first of them. The header is followed by the voxel indices of
+	// all items, unless they are implicit, and then by their values, each padded to 8 bytes as well,
+	// so that both arrays are properly aligned in the mapping. The values are stored like in Data,
+	// one column per feature, so a mapped file is used as the storage of a Data directly
+	std::string serializeHeader(const FeatureCacheKey& key, const Data& data, uint64_t nItems) {
+		const std::vector<std::string>& featureNames = data.getFeatureNames();
+		std::string header = serializeKeyHeader(key, static_cast<uint32_t>(featureNames.size()), nItems);
+		for (size_t i = 0; i < featureNames.size(); ++i)
+			appendString(header, featureNames[i]);
+		appendValue(header, static_cast<uint32_t>(data.getValueEncoding()));
+		for (size_t i = 0; i < featureNames.size(); ++i) {
+			appendValue(header, data.getValueOffsets()[i]);
+			appendValue(header, data.getValueScales()[i]);
+		}
+		appendValue(header, static_cast<uint32_t>(data.hasImplicitVoxelIndices()));
+		appendValue(header, static_cast<uint32_t>(data.getFirstVoxelIndex()));
+		header.resize(alignedSize(header.size()), '\0');
+		return header;
+	}
+
+	// Marks the file as just used by setting its modification time to now
+	void touchFile(const std::string& path) {
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ, 0, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, 0);
+		if (file == INVALID_HANDLE_VALUE)
+			return;
+		FILETIME now;
+		GetSystemTimeAsFileTime(&now);
+		SetFileTime(file, 0, 0, &now);
+		CloseHandle(file);
+#else
+		utime(path.c_str(), 0);
+#endif
+	}
+
+	void createDirectory(const std::string& path) {
+#ifdef _WIN32
+		CreateDirectoryA(path.c_str(), 0);
+#else
+		mkdir(path.c_str(), 0755);
+#endif
+	}
+
+	bool replaceFile(const std::string& source, const std::string& destination) {
+#ifdef _WIN32
+		return MoveFileExA(source.c_str(), destination.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return std::rename(source.c_str(), destination.c_str()) == 0;
+#endif
+	}
+
+	// The name under which the entry 'path' is written before it is renamed to 'path'. It
+	// contains the process id, so that processes writing the same entry do not share the file
+	std::string temporaryFileName(const std::string& path) {
+		std::ostringstream name;
+#ifdef _WIN32
+		name << path << "." << GetCurrentProcessId() << ".tmp";
+#else
+		name << path << "." << getpid() << ".tmp";
+#endif
+		return name.str();
+	}
+
+	// A name for a temporary file in 'directory' that no other file created by this or another
+	// process uses. It does not end with EXTENSION, so the file is never taken for a cache entry
+	std::string uniqueTemporaryFileName(const std::string& directory) {
+		static std::atomic<unsigned int> counter(0);
+		std::ostringstream name;
+#ifdef _WIN32
+		name << directory << "/output." << GetCurrentProcessId() << "." << counter++ << ".tmp";
+#else
+		name << directory << "/output." << getpid() << "." << counter++ << ".tmp";
+#endif
+		return name.str();
+	}
+
+	// Lists all cache files in 'directory'
+	std::vector<CacheFile> listCacheFiles(const std::string& directory) {
+		std::vector<CacheFile> files;
+#ifdef _WIN32
+		WIN32_FIND_DATAA findData;
+		HANDLE find = FindFirstFileA((directory + "/*" + EXTENSION).c_str(), &findData);
+		if (find == INVALID_HANDLE_VALUE)
+			return files;
+		do {
+			CacheFile file;
+			file.path = directory + "/" + findData.cFileName;
+			file.size = (uint64_t(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+			file.lastUse = (int64_t(findData.ftLastWriteTime.dwHighDateTime) << 32) | findData.ftLastWriteTime.dwLowDateTime;
+			files.push_back(file);
+		} while (FindNextFileA(find, &findData));
+		FindClose(find);
+#else
+		DIR* dir = opendir(directory.c_str());
+		if (dir == 0)
+			return files;
+		while (dirent* entry = readdir(dir)) {
+			const std::string name = entry->d_name;
+			if (name.size() <= EXTENSION.size() ||
+				name.compare(name.size() - EXTENSION.size(), EXTENSION.size(), EXTENSION) != 0)
+			{
+				continue;
+			}
+
+			CacheFile file;
+			file.path = directory + "/" + name;
+			struct stat fileStatus;
+			if (stat(file.path.c_str(), &fileStatus) != 0)
+				continue;
+			file.size = fileStatus.st_size;
+			file.lastUse = fileStatus.st_mtime;
+			files.push_back(file);
+		}
+		closedir(dir);
+#endif
+		return files;
+	}
+
+}
+
+uint64_t FeatureCacheKey::hash() const {
+	const std::string key = serializeKey(*this, 0, 0);
+	return hashBytes(key.data(), key.size());
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+	const uint64_t prime = 1099511628211ULL;
+	const char* bytes = static_cast<const char*>(data);
+	uint64_t hash = seed;
+
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+		uint64_t word;
+		std::memcpy(&word, bytes + i, sizeof(word));
+		hash = (hash ^ word) * prime;
+	}
+	for (; i < size; ++i)
+		hash = (hash ^ static_cast<unsigned char>(bytes[i])) * prime;
+	return hash;
+}
+
+FeatureCache::FeatureCache()
+    : _directory(defaultDirectory())
+    , _sizeLimit(uint64_t(4) << 30)
+{}
+
+void FeatureCache::setDirectory(const std::string& directory) {
+    _directory = directory.empty() ? defaultDirectory() : directory;
+}
+
+const std::string& FeatureCache::getDirectory() const {
+    return _directory;
+}
+
+void FeatureCache::setSizeLimit(uint64_t bytes) {
+    _sizeLimit = bytes;
+}
+
+bool FeatureCache::load(const FeatureCacheKey& key, Data& data, bool mapped) const {
+    const std::string path = fileName(key);
+    std::shared_ptr<MappedFile> file(new MappedFile);
+    if (!file->open(path, mapped ? MappedFile::CopyOnWrite : MappedFile::ReadOnly))
+        return false;
+
+	// The file name is only a hash, so the complete key is compared to rule out collisions
+	// and files that were written by a different version
+    uint32_t nFeatures;
+    uint64_t nItems;
+    size_t position = sizeof(MAGIC) + sizeof(uint32_t);
+    if (!readValue(file->data(), file->size(), position, nFeatures) ||
+        !readValue(file->data(), file->size(), position, nItems))
+    {
+        return false;
+    }
+    const std::string keyHeader = serializeKeyHeader(key, nFeatures, nItems);
+    if (file->size() < keyHeader.size() || std::memcmp(file->data(), keyHeader.data(), keyHeader.size()) != 0)
+        return false;
+
+    position = keyHeader.size();
+    std::vector<std::string> featureNames(nFeatures);
+    for (uint32_t i = 0; i < nFeatures; ++i) {
+        if (!readString(file->data(), file->size(), position, featureNames[i]))
+            return false;
+    }
+    uint32_t encoding;
+    if (!readValue(file->data(), file->size(), position, encoding) || encoding > Data::ValueEncodingQuantized16)
+        return false;
+    std::vector<float> offsets(nFeatures);
+    std::vector<float> scales(nFeatures);
+    for (uint32_t i = 0; i < nFeatures; ++i) {
+        if (!readValue(file->data(), file->size(), position, offsets[i]) ||
+            !readValue(file->data(), file->size(), position, scales[i]))
+        {
+            return false;
+        }
+    }
+    uint32_t implicitVoxelIndices;
+    uint32_t firstVoxelIndex;
+    if (!readValue(file->data(), file->size(), position, implicitVoxelIndices) ||
+        !readValue(file->data(), file->size(), position, firstVoxelIndex))
+    {
+        return false;
+    }
+
+    const size_t bytesPerValue = (encoding == Data::ValueEncodingFloat32) ? sizeof(float) : sizeof(uint16_t);
+    const size_t indicesBegin = alignedSize(position);
+    const size_t valuesBegin = indicesBegin + (implicitVoxelIndices ? 0 : alignedSize(nItems * sizeof(uint32_t)));
+    const size_t valuesSize = nItems * nFeatures * bytesPerValue;
+    if (file->size() != valuesBegin + valuesSize)
+        return false;
+
+    data.setFeatureNames(featureNames);
+    data.setValueEncoding(static_cast<Data::ValueEncoding>(encoding), offsets, scales);
+    if (implicitVoxelIndices)
+        data.setImplicitVoxelIndices(firstVoxelIndex);
+
+    if (mapped)
+        data.setMappedStorage(file, nItems, indicesBegin, valuesBegin);
+    else {
+        data.resize(nItems);
+        const uint32_t* voxelIndices = reinterpret_cast<const uint32_t*>(file->data() + indicesBegin);
+        for (uint64_t i = 0; i < nItems && !implicitVoxelIndices; ++i)
+            data.setVoxelIndex(i, voxelIndices[i]);
+        const size_t columnSize = nItems * bytesPerValue;
+        for (uint32_t i = 0; i < nFeatures && columnSize > 0; ++i)
+            std::memcpy(data.getRawColumn(i), file->data() + valuesBegin + i * columnSize, columnSize);
+    }
+
+    touchFile(path);
+    return true;
+}
+
+bool FeatureCache::create(const FeatureCacheKey& key, size_t nItems, Data& data) const {
+    const std::string header = serializeHeader(key, data, nItems);
+    const size_t indicesSize = data.hasImplicitVoxelIndices() ? 0 : alignedSize(nItems * sizeof(uint32_t));
+    const uint64_t fileSize = header.size() + indicesSize + nItems * data.getNumFeatures() * data.getBytesPerValue();
+
+    createDirectory(_directory);
+    std::shared_ptr<MappedFile> file(new MappedFile);
+    if (!file->create(temporaryFileName(fileName(key)), fileSize))
+        return false;
+    std::memcpy(file->data(), header.data(), header.size());
+
+    data.setMappedStorage(file, nItems, header.size(), header.size() + indicesSize);
+    return true;
+}
+
+bool FeatureCache::createTemporary(size_t nItems, Data& data) const {
+    const size_t indicesSize = data.hasImplicitVoxelIndices() ? 0 : alignedSize(nItems * sizeof(uint32_t));
+    const uint64_t fileSize = indicesSize + nItems * data.getNumFeatures() * data.getBytesPerValue();
+
+    createDirectory(_directory);
+    std::shared_ptr<MappedFile> file(new MappedFile);
+    if (!file->create(uniqueTemporaryFileName(_directory), fileSize, true))
+        return false;
+
+    data.setMappedStorage(file, nItems, 0, indicesSize);
+    return true;
+}
+
+bool FeatureCache::commit(const FeatureCacheKey& key) const {
+    const std::string path = fileName(key);
+    const std::string temporaryPath = temporaryFileName(path);
+    if (!replaceFile(temporaryPath, path)) {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    evict(path);
+    return true;
+}
+
+void FeatureCache::discard(const FeatureCacheKey& key) const {
+    std::remove(temporaryFileName(fileName(key)).c_str());
+}
+
+bool FeatureCache::store(const FeatureCacheKey& key, const Data& data) const {
+	// The items of a selection are not contiguous in the columns, so they are copied first
+    if (data.isSelection()) {
+        Data copy(data);
+        copy.makeUnique();
+        return store(key, copy);
+    }
+
+    const std::string header = serializeHeader(key, data, data.size());
+    const size_t indicesSize = data.hasImplicitVoxelIndices() ? 0 : alignedSize(data.size() * sizeof(uint32_t));
+    const size_t valuesSize = data.size() * data.getNumFeatures() * data.getBytesPerValue();
+    const uint64_t fileSize = header.size() + indicesSize + valuesSize;
+    if (fileSize > _sizeLimit)
+        return false;
+
+    createDirectory(_directory);
+
+	// The entry is written under a temporary name first, so that other processes never map a
+	// partially written file
+    const std::string path = fileName(key);
+    const std::string temporaryPath = temporaryFileName(path);
+    {
+        std::ofstream file(temporaryPath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        file.write(header.data(), header.size());
+        std::vector<uint32_t> voxelIndices(indicesSize / sizeof(uint32_t), 0);
+        for (size_t i = 0; i < voxelIndices.size() && i < data.size(); ++i)
+            voxelIndices[i] = data.voxelIndex(i);
+        if (!voxelIndices.empty())
+            file.write(reinterpret_cast<const char*>(&voxelIndices[0]), indicesSize);
+	// The columns of a Data in memory can be further apart than their length
+        const size_t columnSize = data.size() * data.getBytesPerValue();
+        for (size_t i = 0; i < data.getNumFeatures() && columnSize > 0; ++i)
+            file.write(static_cast<const char*>(data.getRawColumn(i)), columnSize);
+        if (!file.good()) {
+            file.close();
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+    if (!replaceFile(temporaryPath, path)) {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+
+    evict(path);
+    return true;
+}
+
+void FeatureCache::clear() const {
+    const std::vector<CacheFile> files = listCacheFiles(_directory);
+    for (size_t i = 0; i < files.size(); ++i)
+        std::remove(files[i].path.c_str());
+}
+
+std::string FeatureCache::defaultDirectory() {
+    const char* variables[] = { "TMPDIR", "TEMP", "TMP" };
+    for (size_t i = 0; i < sizeof(variables) / sizeof(variables[0]); ++i) {
+        const char* value = std::getenv(variables[i]);
+        if (value && *value)
+            return std::string(value) + "/tnm093-featurecache";
+    }
+    return "/tmp/tnm093-featurecache";
+}
+
+std::string FeatureCache::fileName(const FeatureCacheKey& key) const {
+    std::ostringstream name;
+    name << _directory << "/" << std::hex << key.hash() << EXTENSION;
+    return name.str();
+}
+
+void FeatureCache::evict(const std::string& keep) const {
+    std::vector<CacheFile> files = listCacheFiles(_directory);
+    uint64_t totalSize = 0;
+    for (size_t i = 0; i < files.size(); ++i)
+        totalSize += files[i].size;
+
+	// Oldest first; the entry that was just written is never removed
+    std::sort(files.begin(), files.end());
+    for (size_t i = 0; i < files.size() && totalSize > _sizeLimit; ++i) {
+        if (files[i].path != keep && std::remove(files[i].path.c_str()) == 0)
+            totalSize -= files[i].size;
+    }
+}
+
+} // namespace voreen
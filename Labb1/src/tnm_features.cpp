@@ -0,0 +1,383 @@
+#include "modules/tnm093/include/tnm_features.h"
+#include "modules/tnm093/include/tnm_slidingwindow.h"
+#include "modules/tnm093/include/tnm_summedvolumetable.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace voreen {
+
+namespace {
+	// The central difference gradient magnitude of a voxel from its six face neighbors
+	inline float gradientMagnitude(float gx1, float gx2, float gy1, float gy2, float gz1, float gz2) {
+		const float gx = (gx1 - gx2) / 2;
+		const float gy = (gy1 - gy2) / 2;
+		const float gz = (gz1 - gz2) / 2;
+		return static_cast<float>(std::sqrt(double(gx) * gx + double(gy) * gy + double(gz) * gz));
+	}
+
+	// The stencils treat the voxels outside of the volume as 0, so their range includes 0
+	inline float paddedRange(float voxelMinimum, float voxelMaximum) {
+		return std::max(voxelMaximum, 0.f) - std::min(voxelMinimum, 0.f);
+	}
+
+	class IntensityFeature : public Feature {
+	public:
+		std::string getIdentifier() const { return "intensity"; }
+		std::string getName() const { return "Intensity"; }
+		bool isDefault() const { return true; }
+
+		bool valueRange(float voxelMinimum, float voxelMaximum, float& minimum, float& maximum) const {
+			minimum = voxelMinimum;
+			maximum = voxelMaximum;
+			return true;
+		}
+
+		void computeRow(FeatureRow& row, float* values, size_t stride) const {
+			const float* voxels = row.voxels();
+			for (size_t x = 0; x < row.getDimensions().x; ++x)
+				values[x * stride] = voxels[x];
+		}
+	};
+
+	class AverageFeature : public Feature {
+	public:
+		std::string getIdentifier() const { return "average"; }
+		std::string getName() const { return "Average"; }
+		bool isDefault() const { return true; }
+		bool usesNeighborhoodStatistics() const { return true; }
+
+		bool valueRange(float voxelMinimum, float voxelMaximum, float& minimum, float& maximum) const {
+			minimum = voxelMinimum;
+			maximum = voxelMaximum;
+			return true;
+		}
+
+		void computeRow(FeatureRow& row, float* values, size_t stride) const {
+			const float* averages = row.averages();
+			for (size_t x = 0; x < row.getDimensions().x; ++x)
+				values[x * stride] = averages[x];
+		}
+	};
+
+	class StandardDeviationFeature : public Feature {
+	public:
+		std::string getIdentifier() const { return "stddeviation"; }
+		std::string getName() const { return "Standard Deviation"; }
+		bool isDefault() const { return true; }
+		bool usesNeighborhoodStatistics() const { return true; }
+
+		// The sample standard deviation of n values in an interval of length d is at most
+		// d/2 * sqrt(n/(n-1)), which is largest for two values
+		bool valueRange(float voxelMinimum, float voxelMaximum, float& minimum, float& maximum) const {
+			minimum = 0.f;
+			maximum = (voxelMaximum - voxelMinimum) * 0.70710678f;
+			return true;
+		}
+
+		void computeRow(FeatureRow& row, float* values, size_t stride) const {
+			const float* stdDeviations = row.stdDeviations();
+			for (size_t x = 0; x < row.getDimensions().x; ++x)
+				values[x * stride] = stdDeviations[x];
+		}
+	};
+
+	// Central differences, with the voxels outside of the volume being 0
+	class GradientMagnitudeFeature : public Feature {
+	public:
+		std::string getIdentifier() const { return "gradientmagnitude"; }
+		std::string getName() const { return "Gradient Magnitude"; }
+		bool isDefault() const { return true; }
+
+		// Each central difference is at most half of the range
+		bool valueRange(float voxelMinimum, float voxelMaximum, float& minimum, float& maximum) const {
+			minimum = 0.f;
+			maximum = paddedRange(voxelMinimum, voxelMaximum) * 0.8660254f;
+			return true;
+		}
+
+		void computeRow(FeatureRow& row, float* values, size_t stride) const {
+			const FeatureSource& source = row.getSource();
+			const tgt::svec3& dimensions = row.getDimensions();
+
+			// 16 bit volumes use the vectorized kernel on the raw voxels for the interior of the
+			// row, which yields the same results without converting the neighboring rows
+			if (source.uint16Voxels && row.hasInteriorStencil()) {
+				const uint16_t* v = source.uint16Voxels + row.getFirstVoxelIndex();
+				const ptrdiff_t rowStride = dimensions.x;
+				const ptrdiff_t sliceStride = dimensions.x * dimensions.y;
+				float* magnitudes = row.scratch();
+				source.kernels->gradientMagnitude(v + 1, rowStride, sliceStride, dimensions.x - 2, magnitudes + 1);
+
+				const size_t last = dimensions.x - 1;
+				magnitudes[0] = gradientMagnitude(v[1], 0.f, v[rowStride], v[-rowStride],
+					v[sliceStride], v[-sliceStride]);
+				magnitudes[last] = gradientMagnitude(0.f, v[last - 1], v[last + rowStride], v[last - rowStride],
+					v[last + sliceStride], v[last - sliceStride]);
+
+				for (size_t x = 0; x < dimensions.x; ++x)
+					values[x * stride] = magnitudes[x];
+				return;
+			}
+
+			const float* center = row.voxels(0, 0);
+			const float* previousRow = row.voxels(-1, 0);
+			const float* nextRow = row.voxels(1, 0);
+			const float* previousSlice = row.voxels(0, -1);
+			const float* nextSlice = row.voxels(0, 1);
+			for (size_t x = 0; x < dimensions.x; ++x) {
+				values[x * stride] = gradientMagnitude(center[x + 1], center[x - 1], nextRow[x], previousRow[x],
+					nextSlice[x], previousSlice[x]);
+			}
+		}
+	};
+
+	// The sum of the second derivatives, from the six face neighbors
+	class LaplacianFeature : public Feature {
+	public:
+		std::string getIdentifier() const { return "laplacian"; }
+		std::string getName() const { return "Laplacian"; }
+
+		bool valueRange(float voxelMinimum, float voxelMaximum, float& minimum, float& maximum) const {
+			maximum = 6.f * paddedRange(voxelMinimum, voxelMaximum);
+			minimum = -maximum;
+			return true;
+		}
+
+		void computeRow(FeatureRow& row, float* values, size_t stride) const {
+			const float* center = row.voxels(0, 0);
+			const float* previousRow = row.voxels(-1, 0);
+			const float* nextRow = row.voxels(1, 0);
+			const float* previousSlice = row.voxels(0, -1);
+			const float* nextSlice = row.voxels(0, 1);
+			for (size_t x = 0; x < row.getDimensions().x; ++x) {
+				values[x * stride] = (center[x + 1] + center[x - 1]) + (nextRow[x] + previousRow[x])
+					+ (nextSlice[x] + previousSlice[x]) - 6.f * center[x];
+			}
+		}
+	};
+
+	// The gradient magnitude from the 3x3x3 Sobel operator, which smoothes with the weights 1, 2, 1
+	// perpendicular to each derivative. It is normalized so that it matches the central difference
+	// gradient on linear ramps, but is less sensitive to noise
+	class SobelGradientMagnitudeFeature : public Feature {
+	public:
+		std::string getIdentifier() const { return "sobelgradientmagnitude"; }
+		std::string getName() const { return "Sobel Gradient Magnitude"; }
+
+		// The weights of each derivative sum up to 16 on either side, which the normalization
+		// by 32 turns into the same bound as for the central differences
+		bool valueRange(float voxelMinimum, float voxelMaximum, float& minimum, float& maximum) const {
+			minimum = 0.f;
+			maximum = paddedRange(voxelMinimum, voxelMaximum) * 0.8660254f;
+			return true;
+		}
+
+		void computeRow(FeatureRow& row, float* values, size_t stride) const {
+			const float weights[3] = { 1.f, 2.f, 1.f };
+			const float* rows[3][3];
+			for (int dz = -1; dz <= 1; ++dz) {
+				for (int dy = -1; dy <= 1; ++dy)
+					rows[dz + 1][dy + 1] = row.voxels(dy, dz);
+			}
+
+			for (size_t x = 0; x < row.getDimensions().x; ++x) {
+				float gx = 0.f;
+				float gy = 0.f;
+				float gz = 0.f;
+				for (int k = 0; k < 3; ++k) {
+					for (int j = 0; j < 3; ++j) {
+						gx += weights[k] * weights[j] * (rows[k][j][x + 1] - rows[k][j][x - 1]);
+						gy += weights[k] * weights[j] * (rows[k][2][x + j - 1] - rows[k][0][x + j - 1]);
+						gz += weights[k] * weights[j] * (rows[2][k][x + j - 1] - rows[0][k][x + j - 1]);
+					}
+				}
+				values[x * stride] = static_cast<float>(
+					std::sqrt(double(gx) * gx + double(gy) * gy + double(gz) * gz) / 32.0);
+			}
+		}
+	};
+}
+
+FeatureRow::FeatureRow(const FeatureSource& source)
+    : _source(source)
+    , _y(0)
+    , _z(0)
+    , _firstVoxelIndex(0)
+    , _averages(source.dimensions.x)
+    , _stdDeviations(source.dimensions.x)
+    , _hasStatistics(false)
+    , _scratch(source.dimensions.x)
+{
+	// The padding at both ends is never overwritten
+    for (size_t i = 0; i < 9; ++i) {
+        _voxels[i].assign(source.dimensions.x + 2, 0.f);
+        _hasVoxels[i] = false;
+    }
+}
+
+void FeatureRow::setRow(size_t y, size_t z) {
+    _y = y;
+    _z = z;
+    _firstVoxelIndex = (z * _source.dimensions.y + y) * _source.dimensions.x;
+    for (size_t i = 0; i < 9; ++i)
+        _hasVoxels[i] = false;
+    _hasStatistics = false;
+}
+
+const FeatureSource& FeatureRow::getSource() const {
+    return _source;
+}
+
+const tgt::svec3& FeatureRow::getDimensions() const {
+    return _source.dimensions;
+}
+
+size_t FeatureRow::getY() const {
+    return _y;
+}
+
+size_t FeatureRow::getZ() const {
+    return _z;
+}
+
+size_t FeatureRow::getFirstVoxelIndex() const {
+    return _firstVoxelIndex;
+}
+
+bool FeatureRow::hasInteriorStencil() const {
+    const tgt::svec3& dimensions = _source.dimensions;
+    return dimensions.x > 2 && _y > 0 && _y + 1 < dimensions.y && _z > 0 && _z + 1 < dimensions.z;
+}
+
+const float* FeatureRow::voxels(int dy, int dz) {
+    const size_t i = (dz + 1) * 3 + (dy + 1);
+    std::vector<float>& voxels = _voxels[i];
+    if (!_hasVoxels[i]) {
+        const tgt::svec3& dimensions = _source.dimensions;
+        const ptrdiff_t y = ptrdiff_t(_y) + dy;
+        const ptrdiff_t z = ptrdiff_t(_z) + dz;
+        if (y < 0 || y >= ptrdiff_t(dimensions.y) || z < 0 || z >= ptrdiff_t(dimensions.z))
+            std::fill(voxels.begin() + 1, voxels.end() - 1, 0.f);
+        else {
+            const size_t first = (size_t(z) * dimensions.y + size_t(y)) * dimensions.x;
+            _source.convertVoxels(_source.volume, first, dimensions.x, &voxels[1]);
+        }
+        _hasVoxels[i] = true;
+    }
+    return &voxels[1];
+}
+
+const float* FeatureRow::averages() {
+    if (!_hasStatistics)
+        computeStatistics();
+    return &_averages[0];
+}
+
+const float* FeatureRow::stdDeviations() {
+    if (!_hasStatistics)
+        computeStatistics();
+    return &_stdDeviations[0];
+}
+
+float* FeatureRow::scratch() {
+    return &_scratch[0];
+}
+
+void FeatureRow::computeStatistics() {
+    const tgt::svec3& dimensions = _source.dimensions;
+    const size_t radius = _source.radius;
+
+	// If the whole box of the voxels radius <= x < dimensions.x-radius lies inside the volume,
+	// they are handled by the row kernels, and only the remaining voxels are clipped one by one
+    size_t interiorBegin = 0;
+    size_t interiorEnd = 0;
+    const bool isInteriorRow = (_source.summedVolumeTable || _source.slidingWindow) &&
+        dimensions.x > 2 * radius && _y >= radius && _y < dimensions.y - radius &&
+        _z >= radius && _z < dimensions.z - radius;
+    if (isInteriorRow) {
+        interiorBegin = radius;
+        interiorEnd = dimensions.x - radius;
+        const size_t n = interiorEnd - interiorBegin;
+        if (_source.summedVolumeTable) {
+            _source.summedVolumeTable->interiorNeighborhoodRow(radius, _y, _z, n, radius, *_source.kernels,
+                &_averages[radius], &_stdDeviations[radius]);
+        }
+        else
+            _source.slidingWindow->neighborhoodRow(radius, _y, _z, n, &_averages[radius], &_stdDeviations[radius]);
+    }
+
+    for (size_t x = 0; x < dimensions.x; ++x) {
+        if (x == interiorBegin && interiorEnd > interiorBegin) {
+            x = interiorEnd - 1;
+            continue;
+        }
+        if (_source.summedVolumeTable) {
+            _source.summedVolumeTable->neighborhood(tgt::svec3(x, _y, _z), radius,
+                _averages[x], _stdDeviations[x]);
+        }
+        else if (_source.slidingWindow)
+            _source.slidingWindow->neighborhood(x, _y, _z, _averages[x], _stdDeviations[x]);
+        else
+            _source.bruteForceNeighborhood(_source.volume, x, _y, _z, radius, _averages[x], _stdDeviations[x]);
+    }
+    _hasStatistics = true;
+}
+
+bool Feature::isDefault() const {
+    return false;
+}
+
+int Feature::getVersion() const {
+    return 1;
+}
+
+bool Feature::usesNeighborhoodStatistics() const {
+    return false;
+}
+
+bool Feature::valueRange(float, float, float&, float&) const {
+    return false;
+}
+
+FeatureRegistry::FeatureRegistry() {
+	// The first four are the measures that were originally extracted, in their original order
+    registerFeature(new IntensityFeature);
+    registerFeature(new AverageFeature);
+    registerFeature(new StandardDeviationFeature);
+    registerFeature(new GradientMagnitudeFeature);
+    registerFeature(new LaplacianFeature);
+    registerFeature(new SobelGradientMagnitudeFeature);
+}
+
+FeatureRegistry::~FeatureRegistry() {
+    for (size_t i = 0; i < _features.size(); ++i)
+        delete _features[i];
+}
+
+FeatureRegistry& FeatureRegistry::getInstance() {
+    static FeatureRegistry registry;
+    return registry;
+}
+
+void FeatureRegistry::registerFeature(Feature* feature) {
+    if (getFeature(feature->getIdentifier())) {
+        delete feature;
+        return;
+    }
+    _features.push_back(feature);
+}
+
+const std::vector<const Feature*>& FeatureRegistry::getFeatures() const {
+    return _features;
+}
+
+const Feature* FeatureRegistry::getFeature(const std::string& identifier) const {
+    for (size_t i = 0; i < _features.size(); ++i) {
+        if (_features[i]->getIdentifier() == identifier)
+            return _features[i];
+    }
+    return 0;
+}
+
+} // namespace voreen
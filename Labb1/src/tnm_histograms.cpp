@@ -0,0 +1,101 @@
+#include "modules/tnm093/include/tnm_histograms.h"
+
+#include <algorithm>
+
+namespace voreen {
+
+FeatureHistograms::FeatureHistograms()
+    : _nBins(0)
+    , _nItems(0)
+{}
+
+void FeatureHistograms::reset(const std::vector<std::string>& featureNames,
+    const std::vector<float>& minimums, const std::vector<float>& maximums, size_t nBins)
+{
+    const size_t nFeatures = featureNames.size();
+    _featureNames = featureNames;
+    _minimums = minimums;
+    _maximums = maximums;
+    _nBins = std::max<size_t>(nBins, 1);
+    _nItems = 0;
+    _binsPerUnit.resize(nFeatures);
+    for (size_t f = 0; f < nFeatures; ++f) {
+        const float width = _maximums[f] - _minimums[f];
+	// A constant feature falls into the first bin
+        _binsPerUnit[f] = width > 0.f ? float(_nBins) / width : 0.f;
+    }
+    _counts.assign(nFeatures * _nBins, 0);
+    _jointCounts.assign(nFeatures * (nFeatures - std::min<size_t>(nFeatures, 1)) / 2 * _nBins * _nBins, 0);
+    _bins.assign(nFeatures, 0);
+}
+
+const std::vector<std::string>& FeatureHistograms::getFeatureNames() const {
+    return _featureNames;
+}
+
+size_t FeatureHistograms::getNumBins() const {
+    return _nBins;
+}
+
+float FeatureHistograms::getMinimum(size_t feature) const {
+    return _minimums[feature];
+}
+
+float FeatureHistograms::getMaximum(size_t feature) const {
+    return _maximums[feature];
+}
+
+uint64_t FeatureHistograms::getNumItems() const {
+    return _nItems;
+}
+
+const uint64_t* FeatureHistograms::histogram(size_t feature) const {
+    return &_counts[feature * _nBins];
+}
+
+const uint64_t* FeatureHistograms::jointHistogram(size_t featureX, size_t featureY) const {
+    return &_jointCounts[pairIndex(featureX, featureY) * _nBins * _nBins];
+}
+
+uint64_t FeatureHistograms::jointCount(size_t featureX, size_t featureY, size_t x, size_t y) const {
+    if (featureX > featureY) {
+        std::swap(featureX, featureY);
+        std::swap(x, y);
+    }
+    return jointHistogram(featureX, featureY)[y * _nBins + x];
+}
+
+void FeatureHistograms::add(const Data& data, size_t first, size_t n) {
+	// The items are decoded column by column in chunks that stay in the cache
+    const size_t chunkSize = 1024;
+    const size_t nFeatures = _featureNames.size();
+    std::vector<float> values(nFeatures * chunkSize);
+    for (size_t chunk = first; chunk < first + n; chunk += chunkSize) {
+        const size_t nChunkItems = std::min(chunkSize, first + n - chunk);
+        for (size_t f = 0; f < nFeatures; ++f)
+            data.columnValues(f, chunk, nChunkItems, &values[f * chunkSize]);
+        for (size_t i = 0; i < nChunkItems; ++i)
+            add(values.data() + i, chunkSize);
+    }
+}
+
+void FeatureHistograms::merge(const FeatureHistograms& other) {
+    for (size_t i = 0; i < _counts.size(); ++i)
+        _counts[i] += other._counts[i];
+    for (size_t i = 0; i < _jointCounts.size(); ++i)
+        _jointCounts[i] += other._jointCounts[i];
+    _nItems += other._nItems;
+}
+
+uint64_t FeatureHistograms::memoryUsage(size_t nFeatures, size_t nBins) {
+    const uint64_t nPairs = nFeatures * (nFeatures - std::min<size_t>(nFeatures, 1)) / 2;
+    return (nFeatures * uint64_t(nBins) + nPairs * nBins * nBins) * sizeof(uint64_t);
+}
+
+size_t FeatureHistograms::pairIndex(size_t i, size_t j) const {
+	// The pairs (0, 1), ..., (0, n-1), (1, 2), ... are numbered row by row
+    const size_t nFeatures = _featureNames.size();
+    return i * (2 * nFeatures - i - 1) / 2 + (j - i - 1);
+}
+
+} // namespace voreen
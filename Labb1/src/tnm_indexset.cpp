@@ -0,0 +1,625 @@
+#include "modules/tnm093/include/tnm_indexset.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace voreen {
+
+namespace {
+	// The number of 64 bit words of the bitmap of a container
+	const size_t BITMAP_WORDS = 65536 / 64;
+
+	size_t popcount(uint64_t word) {
+#if defined(__GNUC__)
+		return static_cast<size_t>(__builtin_popcountll(word));
+#elif defined(_MSC_VER) && defined(_M_X64)
+		return static_cast<size_t>(__popcnt64(word));
+#else
+		size_t count = 0;
+		for (; word != 0; word &= word - 1)
+			++count;
+		return count;
+#endif
+	}
+
+	// The position of the lowest set bit of 'word', which must not be 0
+	size_t lowestBit(uint64_t word) {
+#if defined(__GNUC__)
+		return static_cast<size_t>(__builtin_ctzll(word));
+#elif defined(_MSC_VER) && defined(_M_X64)
+		unsigned long bit;
+		_BitScanForward64(&bit, word);
+		return bit;
+#else
+		size_t bit = 0;
+		while ((word & 1) == 0) {
+			word >>= 1;
+			++bit;
+		}
+		return bit;
+#endif
+	}
+
+	size_t bitmapCardinality(const std::vector<uint64_t>& bitmap) {
+		size_t count = 0;
+		for (size_t i = 0; i < bitmap.size(); ++i)
+			count += popcount(bitmap[i]);
+		return count;
+	}
+
+	// The position of the first bit at or after 'position' in 'bitmap' that is set, if 'set' is
+	// true, or cleared otherwise; 65536 if there is none
+	size_t nextBit(const std::vector<uint64_t>& bitmap, size_t position, bool set) {
+		for (size_t word = position >> 6; word < BITMAP_WORDS; ++word) {
+			uint64_t bits = set ? bitmap[word] : ~bitmap[word];
+			if (word == position >> 6)
+				bits &= ~uint64_t(0) << (position & 63);
+			if (bits != 0)
+				return word * 64 + lowestBit(bits);
+		}
+		return BITMAP_WORDS * 64;
+	}
+
+	// The number of runs of consecutive set bits in 'bitmap': the set bits whose preceding bit
+	// is cleared
+	size_t bitmapRuns(const std::vector<uint64_t>& bitmap) {
+		size_t count = 0;
+		uint64_t carry = 0;
+		for (size_t i = 0; i < bitmap.size(); ++i) {
+			count += popcount(bitmap[i] & ~((bitmap[i] << 1) | carry));
+			carry = bitmap[i] >> 63;
+		}
+		return count;
+	}
+
+	// The version of the format of IndexSet::encode
+	const unsigned char ENCODING_VERSION = 1;
+
+	// The forms in which IndexSet::encode stores a container
+	enum ContainerEncoding {
+		ENCODING_ARRAY = 0, // The sorted indices, 2 bytes each
+		ENCODING_BITMAP = 1, // The 65536 bits of the bitmap
+		ENCODING_RUNS = 2 // The first index and the length minus one of each run, 4 bytes per run
+	};
+
+	// The integers of the encoding are stored in little endian byte order
+	void appendUint16(std::string& bytes, uint16_t value) {
+		bytes.push_back(static_cast<char>(value & 0xff));
+		bytes.push_back(static_cast<char>(value >> 8));
+	}
+
+	void appendUint32(std::string& bytes, uint32_t value) {
+		appendUint16(bytes, static_cast<uint16_t>(value & 0xffff));
+		appendUint16(bytes, static_cast<uint16_t>(value >> 16));
+	}
+
+	// Reads the integer at 'position' and advances it; returns false if 'bytes' is too short
+	bool readUint16(const std::string& bytes, size_t& position, uint16_t& value) {
+		if (bytes.size() < 2 || position > bytes.size() - 2)
+			return false;
+		value = static_cast<uint16_t>(static_cast<unsigned char>(bytes[position])
+			| (static_cast<unsigned char>(bytes[position + 1]) << 8));
+		position += 2;
+		return true;
+	}
+
+	bool readUint32(const std::string& bytes, size_t& position, uint32_t& value) {
+		uint16_t low;
+		uint16_t high;
+		if (!readUint16(bytes, position, low) || !readUint16(bytes, position, high))
+			return false;
+		value = low | (static_cast<uint32_t>(high) << 16);
+		return true;
+	}
+}
+
+const size_t IndexSet::ARRAY_LIMIT;
+
+IndexSet::Container::Container()
+    : cardinality(0)
+{}
+
+bool IndexSet::Container::contains(uint16_t low) const {
+    if (!bitmap.empty())
+        return (bitmap[low >> 6] >> (low & 63)) & 1;
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+void IndexSet::Container::normalize() {
+    if (cardinality > ARRAY_LIMIT && bitmap.empty()) {
+        bitmap.assign(BITMAP_WORDS, 0);
+        for (size_t i = 0; i < array.size(); ++i)
+            bitmap[array[i] >> 6] |= uint64_t(1) << (array[i] & 63);
+        std::vector<uint16_t>().swap(array);
+    }
+    else if (cardinality <= ARRAY_LIMIT && !bitmap.empty()) {
+        array.clear();
+        array.reserve(cardinality);
+        for (size_t i = 0; i < BITMAP_WORDS; ++i) {
+            for (uint64_t word = bitmap[i]; word != 0; word &= word - 1)
+                array.push_back(static_cast<uint16_t>(i * 64 + lowestBit(word)));
+        }
+        std::vector<uint64_t>().swap(bitmap);
+    }
+}
+
+bool IndexSet::Container::operator==(const Container& rhs) const {
+    return cardinality == rhs.cardinality && array == rhs.array && bitmap == rhs.bitmap;
+}
+
+IndexSet::const_iterator::const_iterator()
+    : _set(0)
+    , _container(0)
+    , _position(0)
+{}
+
+IndexSet::const_iterator::const_iterator(const IndexSet* set, size_t container)
+    : _set(set)
+    , _container(container)
+    , _position(0)
+{
+    settle();
+}
+
+void IndexSet::const_iterator::settle() {
+    while (_container < _set->_containers.size()) {
+        const Container& container = _set->_containers[_container];
+        if (container.bitmap.empty()) {
+            if (_position < container.array.size())
+                return;
+        }
+        else {
+	// The bits below _position of its word are masked out
+            for (size_t word = _position >> 6; word < BITMAP_WORDS; ++word) {
+                const uint64_t bits = container.bitmap[word] & (~uint64_t(0) << ((word == _position >> 6) ? (_position & 63) : 0));
+                if (bits != 0) {
+                    _position = word * 64 + lowestBit(bits);
+                    return;
+                }
+            }
+        }
+        ++_container;
+        _position = 0;
+    }
+}
+
+unsigned int IndexSet::const_iterator::operator*() const {
+    const Container& container = _set->_containers[_container];
+    const unsigned int low = container.bitmap.empty() ? container.array[_position] : static_cast<unsigned int>(_position);
+    return (static_cast<unsigned int>(_set->_keys[_container]) << 16) | low;
+}
+
+IndexSet::const_iterator& IndexSet::const_iterator::operator++() {
+    ++_position;
+    settle();
+    return *this;
+}
+
+IndexSet::const_iterator IndexSet::const_iterator::operator++(int) {
+    const_iterator previous = *this;
+    ++(*this);
+    return previous;
+}
+
+bool IndexSet::const_iterator::operator==(const const_iterator& rhs) const {
+    return _container == rhs._container && _position == rhs._position;
+}
+
+bool IndexSet::const_iterator::operator!=(const const_iterator& rhs) const {
+    return !(*this == rhs);
+}
+
+IndexSet::IndexSet()
+    : _size(0)
+{}
+
+size_t IndexSet::findContainer(uint16_t high) const {
+	// Indices are usually inserted in ascending order, so the last container is checked first
+    if (!_keys.empty() && _keys.back() <= high)
+        return (_keys.back() == high) ? _keys.size() - 1 : _keys.size();
+    return std::lower_bound(_keys.begin(), _keys.end(), high) - _keys.begin();
+}
+
+bool IndexSet::insert(unsigned int index) {
+    const uint16_t high = static_cast<uint16_t>(index >> 16);
+    const uint16_t low = static_cast<uint16_t>(index & 0xffff);
+    const size_t i = findContainer(high);
+    if (i == _keys.size() || _keys[i] != high) {
+        _keys.insert(_keys.begin() + i, high);
+        _containers.insert(_containers.begin() + i, Container());
+    }
+    Container& container = _containers[i];
+    if (!container.bitmap.empty()) {
+        uint64_t& word = container.bitmap[low >> 6];
+        const uint64_t bit = uint64_t(1) << (low & 63);
+        if (word & bit)
+            return false;
+        word |= bit;
+    }
+    else {
+        std::vector<uint16_t>::iterator position = std::lower_bound(container.array.begin(), container.array.end(), low);
+        if (position != container.array.end() && *position == low)
+            return false;
+        container.array.insert(position, low);
+    }
+    ++container.cardinality;
+    ++_size;
+    container.normalize();
+    return true;
+}
+
+bool IndexSet::erase(unsigned int index) {
+    const uint16_t high = static_cast<uint16_t>(index >> 16);
+    const uint16_t low = static_cast<uint16_t>(index & 0xffff);
+    const size_t i = findContainer(high);
+    if (i == _keys.size() || _keys[i] != high || !_containers[i].contains(low))
+        return false;
+    Container& container = _containers[i];
+    if (!container.bitmap.empty())
+        container.bitmap[low >> 6] &= ~(uint64_t(1) << (low & 63));
+    else
+        container.array.erase(std::lower_bound(container.array.begin(), container.array.end(), low));
+    --container.cardinality;
+    --_size;
+    if (container.cardinality == 0) {
+        _keys.erase(_keys.begin() + i);
+        _containers.erase(_containers.begin() + i);
+    }
+    else
+        container.normalize();
+    return true;
+}
+
+bool IndexSet::contains(unsigned int index) const {
+    const uint16_t high = static_cast<uint16_t>(index >> 16);
+    const size_t i = findContainer(high);
+    return i < _keys.size() && _keys[i] == high && _containers[i].contains(static_cast<uint16_t>(index & 0xffff));
+}
+
+void IndexSet::clear() {
+    _keys.clear();
+    _containers.clear();
+    _size = 0;
+}
+
+void IndexSet::swap(IndexSet& other) {
+    _keys.swap(other._keys);
+    _containers.swap(other._containers);
+    std::swap(_size, other._size);
+}
+
+IndexSet& IndexSet::operator|=(const IndexSet& other) {
+	// Both key lists are sorted, so they are merged in one pass
+    std::vector<uint16_t> keys;
+    std::vector<Container> containers;
+    keys.reserve(_keys.size() + other._keys.size());
+    containers.reserve(_keys.size() + other._keys.size());
+    size_t i = 0;
+    size_t j = 0;
+    _size = 0;
+    while (i < _keys.size() || j < other._keys.size()) {
+        if (j == other._keys.size() || (i < _keys.size() && _keys[i] < other._keys[j])) {
+            keys.push_back(_keys[i]);
+            containers.push_back(Container());
+            containers.back().cardinality = _containers[i].cardinality;
+            containers.back().array.swap(_containers[i].array);
+            containers.back().bitmap.swap(_containers[i].bitmap);
+            ++i;
+        }
+        else if (i == _keys.size() || other._keys[j] < _keys[i]) {
+            keys.push_back(other._keys[j]);
+            containers.push_back(other._containers[j]);
+            ++j;
+        }
+        else {
+            const Container& a = _containers[i];
+            const Container& b = other._containers[j];
+            keys.push_back(_keys[i]);
+            containers.push_back(Container());
+            Container& result = containers.back();
+            if (a.bitmap.empty() && b.bitmap.empty()) {
+                result.array.resize(a.array.size() + b.array.size());
+                result.array.erase(std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                    result.array.begin()), result.array.end());
+                result.cardinality = result.array.size();
+            }
+            else {
+	// At least one side is a bitmap, so the union has more than ARRAY_LIMIT indices
+                const Container& bitmap = a.bitmap.empty() ? b : a;
+                const Container& rest = a.bitmap.empty() ? a : b;
+                result.bitmap = bitmap.bitmap;
+                if (rest.bitmap.empty()) {
+                    for (size_t k = 0; k < rest.array.size(); ++k)
+                        result.bitmap[rest.array[k] >> 6] |= uint64_t(1) << (rest.array[k] & 63);
+                }
+                else {
+                    for (size_t k = 0; k < BITMAP_WORDS; ++k)
+                        result.bitmap[k] |= rest.bitmap[k];
+                }
+                result.cardinality = bitmapCardinality(result.bitmap);
+            }
+            result.normalize();
+            ++i;
+            ++j;
+        }
+        _size += containers.back().cardinality;
+    }
+    _keys.swap(keys);
+    _containers.swap(containers);
+    return *this;
+}
+
+IndexSet& IndexSet::operator&=(const IndexSet& other) {
+    size_t kept = 0;
+    size_t j = 0;
+    _size = 0;
+    for (size_t i = 0; i < _keys.size(); ++i) {
+        while (j < other._keys.size() && other._keys[j] < _keys[i])
+            ++j;
+        if (j == other._keys.size() || other._keys[j] != _keys[i])
+            continue;
+        Container& a = _containers[i];
+        const Container& b = other._containers[j];
+        if (a.bitmap.empty()) {
+	// The result is at most as large as the array, so it is filtered in place
+            std::vector<uint16_t>::iterator end = a.array.begin();
+            for (size_t k = 0; k < a.array.size(); ++k) {
+                if (b.contains(a.array[k]))
+                    *end++ = a.array[k];
+            }
+            a.array.erase(end, a.array.end());
+            a.cardinality = a.array.size();
+        }
+        else if (b.bitmap.empty()) {
+            std::vector<uint16_t> array;
+            for (size_t k = 0; k < b.array.size(); ++k) {
+                if (a.contains(b.array[k]))
+                    array.push_back(b.array[k]);
+            }
+            std::vector<uint64_t>().swap(a.bitmap);
+            a.array.swap(array);
+            a.cardinality = a.array.size();
+        }
+        else {
+            for (size_t k = 0; k < BITMAP_WORDS; ++k)
+                a.bitmap[k] &= b.bitmap[k];
+            a.cardinality = bitmapCardinality(a.bitmap);
+            a.normalize();
+        }
+        if (a.cardinality == 0)
+            continue;
+        _size += a.cardinality;
+        if (kept != i) {
+            _keys[kept] = _keys[i];
+            std::swap(_containers[kept], _containers[i]);
+        }
+        ++kept;
+    }
+    _keys.resize(kept);
+    _containers.resize(kept);
+    return *this;
+}
+
+IndexSet& IndexSet::operator-=(const IndexSet& other) {
+    size_t kept = 0;
+    size_t j = 0;
+    _size = 0;
+    for (size_t i = 0; i < _keys.size(); ++i) {
+        while (j < other._keys.size() && other._keys[j] < _keys[i])
+            ++j;
+        Container& a = _containers[i];
+        if (j < other._keys.size() && other._keys[j] == _keys[i]) {
+            const Container& b = other._containers[j];
+            if (a.bitmap.empty()) {
+                std::vector<uint16_t>::iterator end = a.array.begin();
+                for (size_t k = 0; k < a.array.size(); ++k) {
+                    if (!b.contains(a.array[k]))
+                        *end++ = a.array[k];
+                }
+                a.array.erase(end, a.array.end());
+                a.cardinality = a.array.size();
+            }
+            else {
+                if (b.bitmap.empty()) {
+                    for (size_t k = 0; k < b.array.size(); ++k)
+                        a.bitmap[b.array[k] >> 6] &= ~(uint64_t(1) << (b.array[k] & 63));
+                }
+                else {
+                    for (size_t k = 0; k < BITMAP_WORDS; ++k)
+                        a.bitmap[k] &= ~b.bitmap[k];
+                }
+                a.cardinality = bitmapCardinality(a.bitmap);
+                a.normalize();
+            }
+        }
+        if (a.cardinality == 0)
+            continue;
+        _size += a.cardinality;
+        if (kept != i) {
+            _keys[kept] = _keys[i];
+            std::swap(_containers[kept], _containers[i]);
+        }
+        ++kept;
+    }
+    _keys.resize(kept);
+    _containers.resize(kept);
+    return *this;
+}
+
+IndexSet::const_iterator IndexSet::begin() const {
+    return const_iterator(this, 0);
+}
+
+IndexSet::const_iterator IndexSet::end() const {
+    return const_iterator(this, _containers.size());
+}
+
+size_t IndexSet::memoryUsage() const {
+    size_t bytes = _keys.capacity() * sizeof(uint16_t) + _containers.capacity() * sizeof(Container);
+    for (size_t i = 0; i < _containers.size(); ++i) {
+        bytes += _containers[i].array.capacity() * sizeof(uint16_t);
+        bytes += _containers[i].bitmap.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+std::string IndexSet::encode() const {
+    std::string bytes;
+    bytes.push_back(static_cast<char>(ENCODING_VERSION));
+    appendUint32(bytes, static_cast<uint32_t>(_keys.size()));
+
+    std::vector<uint16_t> runs; // The first and the last index of each run
+    for (size_t i = 0; i < _keys.size(); ++i) {
+        const Container& container = _containers[i];
+        runs.clear();
+        if (container.bitmap.empty()) {
+            for (size_t k = 0; k < container.array.size(); ++k) {
+                if (k == 0 || container.array[k] != runs.back() + 1) {
+                    runs.push_back(container.array[k]);
+                    runs.push_back(container.array[k]);
+                }
+                else
+                    runs.back() = container.array[k];
+            }
+        }
+	// The runs of a bitmap are only collected if they are smaller than the bitmap
+        else if (bitmapRuns(container.bitmap) * 2 * sizeof(uint16_t) < BITMAP_WORDS * sizeof(uint64_t)) {
+            for (size_t first = nextBit(container.bitmap, 0, true); first < BITMAP_WORDS * 64; ) {
+                const size_t end = nextBit(container.bitmap, first, false);
+                runs.push_back(static_cast<uint16_t>(first));
+                runs.push_back(static_cast<uint16_t>(end - 1));
+                first = (end < BITMAP_WORDS * 64) ? nextBit(container.bitmap, end, true) : end;
+            }
+        }
+
+	// A container has between 1 and 65536 indices and at most 32768 runs, so both are stored
+	// minus one in 16 bits
+        const size_t arrayBytes = container.cardinality * sizeof(uint16_t);
+        const size_t bitmapBytes = BITMAP_WORDS * sizeof(uint64_t);
+        const size_t runBytes = runs.empty() ? bitmapBytes + 1 : runs.size() * sizeof(uint16_t) + sizeof(uint16_t);
+        appendUint16(bytes, _keys[i]);
+        appendUint16(bytes, static_cast<uint16_t>(container.cardinality - 1));
+        if (runBytes <= std::min(arrayBytes, bitmapBytes)) {
+            bytes.push_back(static_cast<char>(ENCODING_RUNS));
+            appendUint16(bytes, static_cast<uint16_t>(runs.size() / 2 - 1));
+            for (size_t k = 0; k < runs.size(); k += 2) {
+                appendUint16(bytes, runs[k]);
+                appendUint16(bytes, static_cast<uint16_t>(runs[k + 1] - runs[k]));
+            }
+        }
+        else if (container.bitmap.empty()) {
+            bytes.push_back(static_cast<char>(ENCODING_ARRAY));
+            for (size_t k = 0; k < container.array.size(); ++k)
+                appendUint16(bytes, container.array[k]);
+        }
+        else {
+            bytes.push_back(static_cast<char>(ENCODING_BITMAP));
+            for (size_t k = 0; k < BITMAP_WORDS; ++k) {
+                appendUint32(bytes, static_cast<uint32_t>(container.bitmap[k] & 0xffffffff));
+                appendUint32(bytes, static_cast<uint32_t>(container.bitmap[k] >> 32));
+            }
+        }
+    }
+    return bytes;
+}
+
+bool IndexSet::decode(const std::string& bytes) {
+    clear();
+    size_t position = 1;
+    uint32_t nContainers;
+    if (bytes.empty() || static_cast<unsigned char>(bytes[0]) != ENCODING_VERSION || !readUint32(bytes, position, nContainers))
+        return false;
+
+	// Every value is checked, so that a damaged workspace cannot produce a set that breaks the
+	// invariants of the containers
+    bool isValid = true;
+    for (uint32_t i = 0; i < nContainers && isValid; ++i) {
+        uint16_t key;
+        uint16_t cardinality;
+        isValid = readUint16(bytes, position, key) && readUint16(bytes, position, cardinality) && position < bytes.size()
+            && (_keys.empty() || key > _keys.back());
+        if (!isValid)
+            break;
+        const int encoding = static_cast<unsigned char>(bytes[position++]);
+
+        Container container;
+        container.cardinality = size_t(cardinality) + 1;
+        if (encoding == ENCODING_ARRAY) {
+            container.array.resize(container.cardinality);
+            for (size_t k = 0; k < container.cardinality && isValid; ++k)
+                isValid = readUint16(bytes, position, container.array[k]) && (k == 0 || container.array[k] > container.array[k - 1]);
+        }
+        else if (encoding == ENCODING_BITMAP) {
+            container.bitmap.resize(BITMAP_WORDS);
+            for (size_t k = 0; k < BITMAP_WORDS && isValid; ++k) {
+                uint32_t low;
+                uint32_t high;
+                isValid = readUint32(bytes, position, low) && readUint32(bytes, position, high);
+                container.bitmap[k] = low | (static_cast<uint64_t>(high) << 32);
+            }
+            isValid = isValid && bitmapCardinality(container.bitmap) == container.cardinality;
+        }
+        else if (encoding == ENCODING_RUNS) {
+            uint16_t nRuns;
+            isValid = readUint16(bytes, position, nRuns);
+            container.bitmap.assign(BITMAP_WORDS, 0);
+            size_t end = 0; // One past the last index of the previous run
+            size_t count = 0;
+            for (size_t k = 0; k <= nRuns && isValid; ++k) {
+                uint16_t first;
+                uint16_t length;
+                isValid = readUint16(bytes, position, first) && readUint16(bytes, position, length)
+                    && first >= end && size_t(first) + length < BITMAP_WORDS * 64;
+                for (size_t index = first; isValid && index <= size_t(first) + length; ++index)
+                    container.bitmap[index >> 6] |= uint64_t(1) << (index & 63);
+                end = size_t(first) + length + 1;
+                count += size_t(length) + 1;
+            }
+            isValid = isValid && count == container.cardinality;
+        }
+        else
+            isValid = false;
+
+        if (isValid) {
+            container.normalize();
+            _keys.push_back(key);
+            _containers.push_back(Container());
+            std::swap(_containers.back(), container);
+            _size += _containers.back().cardinality;
+        }
+    }
+
+    if (!isValid || position != bytes.size()) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool IndexSet::operator==(const IndexSet& rhs) const {
+    return _size == rhs._size && _keys == rhs._keys && _containers == rhs._containers;
+}
+
+bool IndexSet::operator!=(const IndexSet& rhs) const {
+    return !(*this == rhs);
+}
+
+IndexSet operator|(IndexSet lhs, const IndexSet& rhs) {
+    lhs |= rhs;
+    return lhs;
+}
+
+IndexSet operator&(IndexSet lhs, const IndexSet& rhs) {
+    lhs &= rhs;
+    return lhs;
+}
+
+IndexSet operator-(IndexSet lhs, const IndexSet& rhs) {
+    lhs -= rhs;
+    return lhs;
+}
+
+} // namespace voreen
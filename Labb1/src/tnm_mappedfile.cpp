@@ -0,0 +1,184 @@
+#include "modules/tnm093/include/tnm_mappedfile.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace voreen {
+
+MappedFile::MappedFile()
+    : _data(0)
+    , _size(0)
+#ifdef _WIN32
+    , _file(INVALID_HANDLE_VALUE)
+    , _mapping(0)
+#else
+    , _file(-1)
+#endif
+{}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& fileName, Mode mode) {
+    close();
+
+#ifdef _WIN32
+    const DWORD access = (mode == ReadWrite) ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+	// Sharing the deletion lets other processes replace or evict the file while it is mapped
+    _file = CreateFileA(fileName.c_str(), access, FILE_SHARE_READ | FILE_SHARE_DELETE, 0, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, 0);
+    if (_file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(_file, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        return false;
+    }
+    _size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    _file = ::open(fileName.c_str(), (mode == ReadWrite) ? O_RDWR : O_RDONLY);
+    if (_file == -1)
+        return false;
+
+    struct stat fileStatus;
+    if (fstat(_file, &fileStatus) != 0 || fileStatus.st_size == 0) {
+        close();
+        return false;
+    }
+    _size = static_cast<size_t>(fileStatus.st_size);
+#endif
+
+    return map(mode);
+}
+
+bool MappedFile::create(const std::string& fileName, size_t size, bool isTemporary) {
+    close();
+    if (size == 0)
+        return false;
+
+#ifdef _WIN32
+	// A created file is renamed to its final name while it is still mapped, which requires
+	// sharing the deletion. A temporary file is deleted once the mapping and the file handle,
+	// which both refer to it, are closed
+    const DWORD flags = isTemporary ? FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE : FILE_ATTRIBUTE_NORMAL;
+    _file = CreateFileA(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, 0,
+        CREATE_ALWAYS, flags, 0);
+    if (_file == INVALID_HANDLE_VALUE)
+        return false;
+
+	// The file mapping object extends the file to the requested size
+    _size = size;
+#else
+    _file = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (_file == -1)
+        return false;
+	// The name of a temporary file is removed right away; its content stays accessible through
+	// the descriptor and the mapping and is freed when both are closed
+    if (isTemporary)
+        unlink(fileName.c_str());
+
+	// The file is extended without writing, so file systems supporting it create a sparse file
+    if (ftruncate(_file, static_cast<off_t>(size)) != 0) {
+        close();
+        return false;
+    }
+    _size = size;
+#endif
+
+    return map(ReadWrite);
+}
+
+bool MappedFile::map(Mode mode) {
+#ifdef _WIN32
+    const unsigned long long size = _size;
+    const DWORD protection = (mode == ReadWrite) ? PAGE_READWRITE : (mode == CopyOnWrite) ? PAGE_WRITECOPY : PAGE_READONLY;
+    _mapping = CreateFileMappingA(_file, 0, protection, DWORD(size >> 32), DWORD(size & 0xFFFFFFFF), 0);
+    if (_mapping == 0) {
+        close();
+        return false;
+    }
+    const DWORD access = (mode == ReadWrite) ? FILE_MAP_WRITE : (mode == CopyOnWrite) ? FILE_MAP_COPY : FILE_MAP_READ;
+    _data = static_cast<char*>(MapViewOfFile(_mapping, access, 0, 0, 0));
+#else
+    const int protection = (mode == ReadOnly) ? PROT_READ : PROT_READ | PROT_WRITE;
+    const int flags = (mode == CopyOnWrite) ? MAP_PRIVATE : MAP_SHARED;
+    void* mapping = mmap(0, _size, protection, flags, _file, 0);
+    _data = (mapping == MAP_FAILED) ? 0 : static_cast<char*>(mapping);
+#endif
+
+    if (_data == 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::release(size_t offset, size_t size) {
+    if (_data == 0 || offset >= _size)
+        return;
+    size = std::min(size, _size - offset);
+
+#ifdef _WIN32
+    FlushViewOfFile(_data + offset, size);
+	// Unlocking pages that are not locked removes them from the working set
+    VirtualUnlock(_data + offset, size);
+#else
+	// Both calls require page aligned addresses; the partial pages at the ends stay resident
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t begin = (offset + pageSize - 1) / pageSize * pageSize;
+    const size_t end = (offset + size) / pageSize * pageSize;
+    if (end <= begin)
+        return;
+    msync(_data + begin, end - begin, MS_SYNC);
+    madvise(_data + begin, end - begin, MADV_DONTNEED);
+#endif
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (_data)
+        UnmapViewOfFile(_data);
+    if (_mapping)
+        CloseHandle(_mapping);
+    if (_file != INVALID_HANDLE_VALUE)
+        CloseHandle(_file);
+    _mapping = 0;
+    _file = INVALID_HANDLE_VALUE;
+#else
+    if (_data)
+        munmap(_data, _size);
+    if (_file != -1)
+        ::close(_file);
+    _file = -1;
+#endif
+    _data = 0;
+    _size = 0;
+}
+
+bool MappedFile::isOpen() const {
+    return _data != 0;
+}
+
+const char* MappedFile::data() const {
+    return _data;
+}
+
+char* MappedFile::data() {
+    return _data;
+}
+
+size_t MappedFile::size() const {
+    return _size;
+}
+
+} // namespace voreen
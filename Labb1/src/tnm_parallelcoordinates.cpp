@@ -1,13 +1,16 @@
 
 #include "modules/tnm093/include/tnm_parallelcoordinates.h"
+#include <algorithm>
 #include <iostream>
 #include <iterator>
+#include <limits>
 
 namespace voreen {
 
-
-float minimum [4] = { 0.5, 0.5, 0.5, 0.5 };
-float maximum [4] = { 0.5, 0.5, 0.5, 0.5 };
+namespace {
+	// The handles and the ends of the lines lie at +-AXIS_EXTENT, so that they stay visible
+	const float AXIS_EXTENT = 0.95f;
+}
 
 TNMParallelCoordinates::AxisHandle::AxisHandle(AxisHandlePosition location, int index, const tgt::vec2& position)
     : _location(location)
@@ -93,23 +96,7 @@ TNMParallelCoordinates::TNMParallelCoordinates()
         tgt::MouseEvent::MOUSE_BUTTON_LEFT, tgt::MouseEvent::RELEASED, tgt::Event::MODIFIER_NONE);
     addEventProperty(_mouseReleaseEvent);
 
-	//
-    // Create AxisHandles here with a unique id
-    // _handles.push_back(AxisHandle(AxisHandle::AxisHandlePositionTop, 0, /* fix startposition */));
-    // ...
-	//
-     _handles.push_back(AxisHandle(AxisHandle::AxisHandlePositionBottom, 0, tgt::vec2(-0.95,-0.95)));
-     _handles.push_back(AxisHandle(AxisHandle::AxisHandlePositionTop,    1, tgt::vec2(-0.95, 0.95)));
-
-     _handles.push_back(AxisHandle(AxisHandle::AxisHandlePositionBottom, 2, tgt::vec2(-0.5,-0.95)));
-     _handles.push_back(AxisHandle(AxisHandle::AxisHandlePositionTop,    3, tgt::vec2(-0.5, 0.95)));
-
-     _handles.push_back(AxisHandle(AxisHandle::AxisHandlePositionBottom, 4, tgt::vec2(0.5,-0.95)));
-     _handles.push_back(AxisHandle(AxisHandle::AxisHandlePositionTop,    5, tgt::vec2(0.5, 0.95)));
-
-     _handles.push_back(AxisHandle(AxisHandle::AxisHandlePositionBottom, 6, tgt::vec2(0.95,-0.95)));
-     _handles.push_back(AxisHandle(AxisHandle::AxisHandlePositionTop,    7, tgt::vec2(0.95, 0.95)));
-
+	// The handles are created in updateAxes, once the number of features is known
 }
 
 TNMParallelCoordinates::~TNMParallelCoordinates() {
@@ -118,6 +105,13 @@ TNMParallelCoordinates::~TNMParallelCoordinates() {
 }
 
 void TNMParallelCoordinates::process() {
+    if (!_inport.hasData())
+        return;
+    updateAxes(*(_inport.getData()));
+	// The handles keep their positions for new data, but other items lie outside of them
+    if (_inport.hasChanged())
+        updateBrushing();
+
 	// Activate the user-outport as the rendering target
     _outport.activateTarget();
 	// Clear the buffer
@@ -176,16 +170,21 @@ void TNMParallelCoordinates::handleMouseClick(tgt::MouseEvent* e) {
 	// renderLinesPicking method
 
 	LINFOC("Picking", "Picked line index: " << lineId);
+	// Only the clicked line, or the lines that are deselected, are published to the Scatterplot
+	// instead of the whole list of selected indices
+	IndexSet added;
+	IndexSet removed;
 	if (lineId != -1)
 		// We want to add it only if a line was clicked
-		_linkingList.insert(lineId);
+		added.insert(lineId);
 
 	// if the right mouse button is pressed and no line is clicked, clear the list:
 	if ((e->button() == tgt::MouseEvent::MOUSE_BUTTON_RIGHT) && (lineId == -1))
-		_linkingList.clear();
+		removed = _linkingList;
 
-	// Make the list of selected indices available to the Scatterplot
-	_linkingIndices.set(_linkingList);
+	_linkingList |= added;
+	_linkingList -= removed;
+	_linkingIndices.applyChanges(added, removed);
 }
 
 void TNMParallelCoordinates::handleMouseMove(tgt::MouseEvent* e) {
@@ -194,12 +193,11 @@ void TNMParallelCoordinates::handleMouseMove(tgt::MouseEvent* e) {
     const tgt::vec2& normalizedDeviceCoordinates = (tgt::vec2(screenCoords) / tgt::vec2(_privatePort.getSize()) - 0.5f) * 2.f;
 
     // Move the stored index along its axis (if it is a valid picking point)
-    AxisHandle& handle = _handles.at(_pickedHandle);
-
-    if (_pickedHandle == -1 ) {
+    if (_pickedHandle < 0 || _pickedHandle >= static_cast<int>(_handles.size())) {
         return;
     }
 	else {
+        AxisHandle& handle = _handles.at(_pickedHandle);
         //AxisHandle& handle = _handles.at(_pickedHandle);
         if (_pickedHandle % 2 == 0){
             //nere
@@ -232,7 +230,7 @@ void TNMParallelCoordinates::handleMouseMove(tgt::MouseEvent* e) {
 
     //-----------------------------
 	// update the _brushingList with the indices of the lines that are not rendered anymore
-	_brushingIndices.set(_brushingList);
+	updateBrushing();
 
     // This re-renders the scene (which will call process in turn)
     invalidate();
@@ -242,215 +240,113 @@ void TNMParallelCoordinates::handleMouseRelease(tgt::MouseEvent* e) {
 
 }
 
-void TNMParallelCoordinates::renderLines() {
-	//
-    // Implement your line drawing
-	//
-	const Data* _data = _inport.getData();
-
-    for (int i = 0; i < 4; i++) {
-        for (size_t t = 0; t < _data->size();t++) {
-            if (_data->at(t).dataValues[i]<minimum[i]) {
-                minimum[i] = _data->at(t).dataValues[i];
-            }
-            if (_data->at(t).dataValues[i]>maximum[i]) {
-                maximum[i] = _data->at(t).dataValues[i];
-            }
+void TNMParallelCoordinates::updateAxes(const Data& data) {
+    const size_t nAxes = data.getNumFeatures();
+
+	// Each axis k has the bottom handle 2k and the top handle 2k+1. They are only recreated if the
+	// number of features changed, so that the brushing survives new data with the same features
+    if (_handles.size() != 2 * nAxes) {
+        _handles.clear();
+        _pickedHandle = -1;
+        for (size_t k = 0; k < nAxes; ++k) {
+            const float x = axisX(k, nAxes);
+            _handles.push_back(AxisHandle(AxisHandle::AxisHandlePositionBottom, int(2 * k), tgt::vec2(x, -AXIS_EXTENT)));
+            _handles.push_back(AxisHandle(AxisHandle::AxisHandlePositionTop, int(2 * k + 1), tgt::vec2(x, AXIS_EXTENT)));
         }
     }
 
-
-
-    _brushingList.clear();
-int t=0;
-
-        for (size_t i = 0; i < _data->size(); i++){
-
-
-                if (_handles.at(0).getPosition().y > (-1 + (2*(_data->at(i).dataValues[t]-minimum[t]))/(maximum[t]-minimum[t])) ) {
-
-                    _brushingList.insert(_data->at(i).voxelIndex);
-                }
-
-                if (_handles.at(1).getPosition().y < (-1 + (2*(_data->at(i).dataValues[t]-minimum[t]))/(maximum[t]-minimum[t])) ) {
-
-                    _brushingList.insert(_data->at(i).voxelIndex);
-
-                }
-
-
-
-    }
-
-t=1;
-      for (size_t i = 0; i < _data->size(); i++){
-
-
-                if (_handles.at(2).getPosition().y > (-1 + (2*(_data->at(i).dataValues[t]-minimum[t]))/(maximum[t]-minimum[t])) ) {
-
-                    _brushingList.insert(_data->at(i).voxelIndex);
-                }
-
-                if (_handles.at(3).getPosition().y < (-1 + (2*(_data->at(i).dataValues[t]-minimum[t]))/(maximum[t]-minimum[t])) ) {
-
-                    _brushingList.insert(_data->at(i).voxelIndex);
-
-                }
-
-    }
-
-    t=2;
-
-    for (size_t i = 0; i < _data->size(); i++){
-
-
-                if (_handles.at(4).getPosition().y > (-1 + (2*(_data->at(i).dataValues[t]-minimum[t]))/(maximum[t]-minimum[t])) ) {
-
-                    _brushingList.insert(_data->at(i).voxelIndex);
-                }
-
-                if (_handles.at(5).getPosition().y < (-1 + (2*(_data->at(i).dataValues[t]-minimum[t]))/(maximum[t]-minimum[t])) ) {
-
-                    _brushingList.insert(_data->at(i).voxelIndex);
-
-                }
-
-
-    }
-
-t=3;
-    for (size_t i = 0; i < _data->size(); i++){
-
-
-                if (_handles.at(6).getPosition().y > (-1 + (2*(_data->at(i).dataValues[t]-minimum[t]))/(maximum[t]-minimum[t])) ) {
-
-                    _brushingList.insert(_data->at(i).voxelIndex);
-                }
-
-                if (_handles.at(7).getPosition().y < (-1 + (2*(_data->at(i).dataValues[t]-minimum[t]))/(maximum[t]-minimum[t])) ) {
-
-                    _brushingList.insert(_data->at(i).voxelIndex);
-
-                }
-
-
-
+	// The value range of every axis, which is mapped to [-AXIS_EXTENT, AXIS_EXTENT]. The ranges
+	// are taken from the statistics of the columns, which the producer of the data computed once
+    _minimum.resize(nAxes);
+    _maximum.resize(nAxes);
+    for (size_t k = 0; k < nAxes; ++k) {
+        const ColumnStatistics& statistics = data.statistics(k);
+        _minimum[k] = statistics.minimum;
+        _maximum[k] = statistics.maximum;
     }
+}
 
+float TNMParallelCoordinates::axisX(size_t axis, size_t nAxes) {
+    if (nAxes < 2)
+        return 0.f;
+    return AXIS_EXTENT * (-1.f + 2.f * axis / (nAxes - 1));
+}
 
- glBegin(GL_LINES);
-glColor3f(1,0,0);
-
-    for (size_t i = 0; i < _data->size(); i++) {
-
-            if ( _brushingList.find(_data->at(i).voxelIndex) == _brushingList.end()){
-
-
-                if (_linkingList.find(_data->at(i).voxelIndex) != _linkingList.end() )
-                {
-                    glColor4f(1.f,0.f,0.f, 1.f);
-                }else{
-                    glColor4f(0.f,1.f,0.f, 0.6f);
-                }
-
-
-                glVertex2f( -1.0f, -1 + (2*(_data->at(i).dataValues[0]-minimum[0]))/(maximum[0]-minimum[0]));
-                glVertex2f( -0.5f, -1 + (2*(_data->at(i).dataValues[1]-minimum[1]))/(maximum[1]-minimum[1]));
-
-            }
-        }
-
-
-    for (size_t i = 0; i < _data->size(); i++){
-
-
-
-        if ( _brushingList.find(_data->at(i).voxelIndex) == _brushingList.end()){
-
-
-            if (_linkingList.find(_data->at(i).voxelIndex) != _linkingList.end() )
-              {
-                    glColor4f(1.f,0.f,0.f, 1.f);
-                }else{
-                    glColor4f(0.f,1.f,0.f, 0.6f);
-                }
-
-
-
-            glVertex2f( -0.5f, -1 + (2*(_data->at(i).dataValues[1]-minimum[1]))/(maximum[1]-minimum[1]));
-            glVertex2f(  0.5f, -1 + (2*(_data->at(i).dataValues[2]-minimum[2]))/(maximum[2]-minimum[2]));
+float TNMParallelCoordinates::axisY(const Data& data, size_t item, size_t axis) const {
+    const float range = _maximum[axis] - _minimum[axis];
+    if (range <= 0.f)
+        return 0.f;
+    return AXIS_EXTENT * (-1 + (2 * (data.value(item, axis) - _minimum[axis])) / range);
+}
 
+void TNMParallelCoordinates::updateBrushing() {
+    if (!_inport.hasData())
+        return;
+	const Data* _data = _inport.getData();
+    const size_t nAxes = std::min(_data->getNumFeatures(), _handles.size() / 2);
+
+	// A line is brushed if its value lies outside of the two handles on any of the axes
+    IndexSet brushingList;
+    for (size_t k = 0; k < nAxes; ++k) {
+        const float bottom = _handles.at(2 * k).getPosition().y;
+        const float top = _handles.at(2 * k + 1).getPosition().y;
+        for (size_t i = 0; i < _data->size(); i++) {
+            const float y = axisY(*_data, i, k);
+            if (bottom > y || top < y)
+                brushingList.insert(_data->voxelIndex(i));
         }
     }
 
-    for (size_t i = 0; i < _data->size(); i++){
-
-
-
-        if ( _brushingList.find(_data->at(i).voxelIndex) == _brushingList.end()){
-
+	// Moving a handle only brushes or unbrushes the few lines it passes, so only those are
+	// published to the Scatterplot
+    const IndexSet added = brushingList - _brushingList;
+    const IndexSet removed = _brushingList - brushingList;
+    _brushingList.swap(brushingList);
+    _brushingIndices.applyChanges(added, removed);
+}
 
-            if (_linkingList.find(_data->at(i).voxelIndex) != _linkingList.end() )
-              {
-                    glColor4f(1.f,0.f,0.f, 1.f);
-                }else{
-                    glColor4f(0.f,1.f,0.f, 0.6f);
-                }
+void TNMParallelCoordinates::renderLines() {
+	const Data* _data = _inport.getData();
+    const size_t nAxes = _data->getNumFeatures();
 
+    glBegin(GL_LINES);
+    for (size_t i = 0; i < _data->size(); i++) {
+        if (_brushingList.contains(_data->voxelIndex(i)))
+            continue;
 
-            glVertex2f( 0.5f, -1 + (2*(_data->at(i).dataValues[2]-minimum[2]))/(maximum[2]-minimum[2]));
-            glVertex2f( 1.0f, -1 + (2*(_data->at(i).dataValues[3]-minimum[3]))/(maximum[3]-minimum[3]));
+        if (_linkingList.contains(_data->voxelIndex(i)))
+            glColor4f(1.f, 0.f, 0.f, 1.f);
+        else
+            glColor4f(0.f, 1.f, 0.f, 0.6f);
 
+        for (size_t k = 0; k + 1 < nAxes; ++k) {
+            glVertex2f(axisX(k, nAxes), axisY(*_data, i, k));
+            glVertex2f(axisX(k + 1, nAxes), axisY(*_data, i, k + 1));
         }
-
     }
-
-   glEnd();
+    glEnd();
 }
 
 void TNMParallelCoordinates::renderLinesPicking() {
 	// Use the same code to render lines (without duplicating it), but think of a way to encode the
 	// voxel identifier into the color. The red color channel is already occupied, so you have 3
 	// channels with 32-bit each at your disposal (green, blue, alpha)
-
-
 	const Data* _data = _inport.getData();
+    const size_t nAxes = _data->getNumFeatures();
 
-	for (size_t i = 0; i < _data->size(); i++){
-
-        float color = (_data->at(i).voxelIndex + 1) / (_data->size() * 255.f) ;
-
-        //std::cout << "color: " << color << std::endl;
-
-        //std::cout << "color: " << _linkingList.size() << std::endl;
+    glBegin(GL_LINES);
+	for (size_t i = 0; i < _data->size(); i++) {
+        if (_brushingList.contains(_data->voxelIndex(i)))
+            continue;
 
-        glBegin(GL_LINES);
+        const float color = (_data->voxelIndex(i) + 1) / (_data->size() * 255.f);
         glColor3f(0.f, color, 0.f);
-
-        if ( _brushingList.find(_data->at(i).voxelIndex) == _brushingList.end()  ){
-
-                glVertex2f( -1.0f, -1 + (2*(_data->at(i).dataValues[0]-minimum[0]))/(maximum[0]-minimum[0]));
-                glVertex2f( -0.5f, -1 + (2*(_data->at(i).dataValues[1]-minimum[1]))/(maximum[1]-minimum[1]));
-
-                glVertex2f( -0.5f, -1 + (2*(_data->at(i).dataValues[1]-minimum[1]))/(maximum[1]-minimum[1]));
-                glVertex2f(  0.5f, -1 + (2*(_data->at(i).dataValues[2]-minimum[2]))/(maximum[2]-minimum[2]));
-
-                glVertex2f( 0.5f, -1 + (2*(_data->at(i).dataValues[2]-minimum[2]))/(maximum[2]-minimum[2]));
-                glVertex2f( 1.0f, -1 + (2*(_data->at(i).dataValues[3]-minimum[3]))/(maximum[3]-minimum[3]));
-
-            }
-
-
-
-
-         glEnd();
-    //int handleId = static_cast<int>(pickingTexture->texelAsFloat(_data->at(i).voxelIndex / _data->size()).g * 255 - 1);
-
-
+        for (size_t k = 0; k + 1 < nAxes; ++k) {
+            glVertex2f(axisX(k, nAxes), axisY(*_data, i, k));
+            glVertex2f(axisX(k + 1, nAxes), axisY(*_data, i, k + 1));
+        }
     }
-
-
-
+    glEnd();
 }
 
 void TNMParallelCoordinates::renderHandles() {
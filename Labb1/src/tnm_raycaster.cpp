@@ -15,6 +15,7 @@ const std::string TNMRaycaster::loggerCat_("voreen.TNMRaycaster");
 TNMRaycaster::TNMRaycaster()
     : VolumeRaycaster()
     , volumeInport_(Port::INPORT, "volumehandle.volumehandle", false, Processor::INVALID_PROGRAM)
+    , gradientInport_(Port::INPORT, "volumehandle.gradients", false, Processor::INVALID_PROGRAM)
     , entryPort_(Port::INPORT, "image.entrypoints")
     , exitPort_(Port::INPORT, "image.exitpoints")
     , outport_(Port::OUTPORT, "image.output", true, Processor::INVALID_PROGRAM)
@@ -25,6 +26,9 @@ TNMRaycaster::TNMRaycaster()
     // ports
     volumeInport_.addCondition(new PortConditionVolumeTypeGL());
     addPort(volumeInport_);
+    // the gradients are optional; without them, they are computed for each sample
+    gradientInport_.addCondition(new PortConditionVolumeTypeGL());
+    addPort(gradientInport_);
     addPort(entryPort_);
     addPort(exitPort_);
     addPort(outport_);
@@ -148,6 +152,19 @@ void TNMRaycaster::process() {
         GL_LINEAR)
     );
 
+    // add the precomputed gradients, which replace the six additional fetches per sample
+    TextureUnit gradientUnit;
+    if (gradientInport_.getData()) {
+        volumeTextures.push_back(VolumeStruct(
+            gradientInport_.getData(),
+            &gradientUnit,
+            "gradientVolumeStruct_",
+            GL_CLAMP,
+            tgt::vec4(0.f),
+            GL_LINEAR)
+        );
+    }
+
     // initialize shader
     raycastPrg_->activate();
 
@@ -186,6 +203,9 @@ std::string TNMRaycaster::generateHeader() {
 
     headerSource += transferFunc_.get()->getShaderDefines();
 
+    if (gradientInport_.getData())
+        headerSource += "#define USE_GRADIENT_VOLUME\n";
+
     return headerSource;
 }
 
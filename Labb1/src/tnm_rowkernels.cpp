@@ -0,0 +1,280 @@
+#include "modules/tnm093/include/tnm_rowkernels.h"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TNM_X86_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit instructions for the extensions a function is compiled for, while
+// MSVC accepts all intrinsics everywhere
+#if defined(TNM_X86_SIMD) && (defined(__GNUC__) || defined(__clang__))
+#define TNM_TARGET(isa) __attribute__((target(isa)))
+#else
+#define TNM_TARGET(isa)
+#endif
+
+namespace voreen {
+
+namespace {
+
+	//
+	// Scalar reference kernels
+	//
+
+	// Gradient magnitude of a single voxel. (g/2)^2 is computed as g^2/4, which is exact in
+	// double precision, so only the square root and the conversion to float round
+	inline float gradientMagnitudeScalar(const uint16_t* v, ptrdiff_t rowStride, ptrdiff_t sliceStride) {
+		const int gx = int(v[1]) - int(v[-1]);
+		const int gy = int(v[rowStride]) - int(v[-rowStride]);
+		const int gz = int(v[sliceStride]) - int(v[-sliceStride]);
+		return static_cast<float>(std::sqrt(0.25 * (double(gx) * gx + double(gy) * gy + double(gz) * gz)));
+	}
+
+	void gradientMagnitudeRowScalar(const uint16_t* voxels, ptrdiff_t rowStride, ptrdiff_t sliceStride,
+		size_t n, float* magnitudes)
+	{
+		for (size_t i = 0; i < n; ++i)
+			magnitudes[i] = gradientMagnitudeScalar(voxels + i, rowStride, sliceStride);
+	}
+
+	// Sums the box whose lower corner entry is 'p' using inclusion-exclusion over its corners
+	inline uint64_t boxSum(const uint64_t* p, ptrdiff_t dX, ptrdiff_t dY, ptrdiff_t dZ) {
+		return p[dZ + dY + dX] - p[dY + dX] - p[dZ + dX] - p[dZ + dY] + p[dX] + p[dY] + p[dZ] - p[0];
+	}
+
+	void boxStatisticsRowScalar(const uint64_t* sum, const uint64_t* sumSquared,
+		ptrdiff_t dX, ptrdiff_t dY, ptrdiff_t dZ, uint64_t count, double offset, size_t n,
+		float* averages, float* stdDeviations)
+	{
+		const double c = double(count);
+		const double normalization = double(count * (count - 1));
+		for (size_t i = 0; i < n; ++i) {
+			const uint64_t s = boxSum(sum + i, dX, dY, dZ);
+			const uint64_t q = boxSum(sumSquared + i, dX, dY, dZ);
+			averages[i] = static_cast<float>(double(s) / c - offset);
+			stdDeviations[i] = static_cast<float>(std::sqrt(double(count * q - s * s) / normalization));
+		}
+	}
+
+	const RowKernels scalarKernels = {
+		"scalar",
+		&gradientMagnitudeRowScalar,
+		&boxStatisticsRowScalar
+	};
+
+#ifdef TNM_X86_SIMD
+
+	//
+	// SSE2 kernels, two voxels per double precision vector
+	//
+
+	// Converts unsigned 64 bit integers below 2^52 to double by placing them in the mantissa of
+	// 2^52 and subtracting 2^52 again; SSE2 and AVX2 have no direct conversion for them
+	TNM_TARGET("sse2") inline __m128d uint52ToDouble(__m128i v) {
+		const __m128i magic = _mm_set1_epi64x(0x4330000000000000LL);
+		return _mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(v, magic)), _mm_castsi128_pd(magic));
+	}
+
+	TNM_TARGET("sse2") inline __m128i loadBoxSumSse2(const uint64_t* p, ptrdiff_t dX, ptrdiff_t dY, ptrdiff_t dZ) {
+#define TNM_LOAD(offset) _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + (offset)))
+		__m128i s = TNM_LOAD(dZ + dY + dX);
+		s = _mm_sub_epi64(s, TNM_LOAD(dY + dX));
+		s = _mm_sub_epi64(s, TNM_LOAD(dZ + dX));
+		s = _mm_sub_epi64(s, TNM_LOAD(dZ + dY));
+		s = _mm_add_epi64(s, TNM_LOAD(dX));
+		s = _mm_add_epi64(s, TNM_LOAD(dY));
+		s = _mm_add_epi64(s, TNM_LOAD(dZ));
+		s = _mm_sub_epi64(s, TNM_LOAD(0));
+#undef TNM_LOAD
+		return s;
+	}
+
+	// Loads four uint16 values and returns their differences a - b as 32 bit integers
+	TNM_TARGET("sse2") inline __m128i differenceSse2(const uint16_t* a, const uint16_t* b) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i va = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a)), zero);
+		const __m128i vb = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(b)), zero);
+		return _mm_sub_epi32(va, vb);
+	}
+
+	// Gradient magnitude of two lanes, using the same order of operations as the scalar kernel
+	TNM_TARGET("sse2") inline __m128 magnitudeSse2(__m128d gx, __m128d gy, __m128d gz) {
+		__m128d sq = _mm_add_pd(_mm_add_pd(_mm_mul_pd(gx, gx), _mm_mul_pd(gy, gy)), _mm_mul_pd(gz, gz));
+		sq = _mm_mul_pd(_mm_set1_pd(0.25), sq);
+		return _mm_cvtpd_ps(_mm_sqrt_pd(sq));
+	}
+
+	TNM_TARGET("sse2") void gradientMagnitudeRowSse2(const uint16_t* voxels, ptrdiff_t rowStride,
+		ptrdiff_t sliceStride, size_t n, float* magnitudes)
+	{
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			const uint16_t* v = voxels + i;
+			const __m128i gx = differenceSse2(v + 1, v - 1);
+			const __m128i gy = differenceSse2(v + rowStride, v - rowStride);
+			const __m128i gz = differenceSse2(v + sliceStride, v - sliceStride);
+
+			const __m128 low = magnitudeSse2(_mm_cvtepi32_pd(gx), _mm_cvtepi32_pd(gy), _mm_cvtepi32_pd(gz));
+			const __m128 high = magnitudeSse2(
+				_mm_cvtepi32_pd(_mm_srli_si128(gx, 8)),
+				_mm_cvtepi32_pd(_mm_srli_si128(gy, 8)),
+				_mm_cvtepi32_pd(_mm_srli_si128(gz, 8)));
+			_mm_storeu_ps(magnitudes + i, _mm_movelh_ps(low, high));
+		}
+		for (; i < n; ++i)
+			magnitudes[i] = gradientMagnitudeScalar(voxels + i, rowStride, sliceStride);
+	}
+
+	TNM_TARGET("sse2") void boxStatisticsRowSse2(const uint64_t* sum, const uint64_t* sumSquared,
+		ptrdiff_t dX, ptrdiff_t dY, ptrdiff_t dZ, uint64_t count, double offset, size_t n,
+		float* averages, float* stdDeviations)
+	{
+		const __m128d c = _mm_set1_pd(double(count));
+		const __m128d o = _mm_set1_pd(offset);
+		const __m128d normalization = _mm_set1_pd(double(count * (count - 1)));
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2) {
+			const __m128d s = uint52ToDouble(loadBoxSumSse2(sum + i, dX, dY, dZ));
+			const __m128d q = uint52ToDouble(loadBoxSumSse2(sumSquared + i, dX, dY, dZ));
+
+			const __m128 average = _mm_cvtpd_ps(_mm_sub_pd(_mm_div_pd(s, c), o));
+			// count * q and s * s are exact, so is their difference
+			const __m128d numerator = _mm_sub_pd(_mm_mul_pd(c, q), _mm_mul_pd(s, s));
+			const __m128 stdDeviation = _mm_cvtpd_ps(_mm_sqrt_pd(_mm_div_pd(numerator, normalization)));
+
+			_mm_storel_pi(reinterpret_cast<__m64*>(averages + i), average);
+			_mm_storel_pi(reinterpret_cast<__m64*>(stdDeviations + i), stdDeviation);
+		}
+		boxStatisticsRowScalar(sum + i, sumSquared + i, dX, dY, dZ, count, offset, n - i, averages + i, stdDeviations + i);
+	}
+
+	const RowKernels sse2Kernels = {
+		"SSE2",
+		&gradientMagnitudeRowSse2,
+		&boxStatisticsRowSse2
+	};
+
+	//
+	// AVX2 kernels, four voxels per double precision vector
+	//
+
+	TNM_TARGET("avx2") inline __m256d uint52ToDoubleAvx2(__m256i v) {
+		const __m256i magic = _mm256_set1_epi64x(0x4330000000000000LL);
+		return _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(v, magic)), _mm256_castsi256_pd(magic));
+	}
+
+	TNM_TARGET("avx2") inline __m256i loadBoxSumAvx2(const uint64_t* p, ptrdiff_t dX, ptrdiff_t dY, ptrdiff_t dZ) {
+#define TNM_LOAD(offset) _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + (offset)))
+		__m256i s = TNM_LOAD(dZ + dY + dX);
+		s = _mm256_sub_epi64(s, TNM_LOAD(dY + dX));
+		s = _mm256_sub_epi64(s, TNM_LOAD(dZ + dX));
+		s = _mm256_sub_epi64(s, TNM_LOAD(dZ + dY));
+		s = _mm256_add_epi64(s, TNM_LOAD(dX));
+		s = _mm256_add_epi64(s, TNM_LOAD(dY));
+		s = _mm256_add_epi64(s, TNM_LOAD(dZ));
+		s = _mm256_sub_epi64(s, TNM_LOAD(0));
+#undef TNM_LOAD
+		return s;
+	}
+
+	// Loads four uint16 values and returns their differences a - b as doubles
+	TNM_TARGET("avx2") inline __m256d differenceAvx2(const uint16_t* a, const uint16_t* b) {
+		const __m128i va = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a)));
+		const __m128i vb = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(b)));
+		return _mm256_cvtepi32_pd(_mm_sub_epi32(va, vb));
+	}
+
+	TNM_TARGET("avx2") void gradientMagnitudeRowAvx2(const uint16_t* voxels, ptrdiff_t rowStride,
+		ptrdiff_t sliceStride, size_t n, float* magnitudes)
+	{
+		const __m256d quarter = _mm256_set1_pd(0.25);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			const uint16_t* v = voxels + i;
+			const __m256d gx = differenceAvx2(v + 1, v - 1);
+			const __m256d gy = differenceAvx2(v + rowStride, v - rowStride);
+			const __m256d gz = differenceAvx2(v + sliceStride, v - sliceStride);
+
+			__m256d sq = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(gx, gx), _mm256_mul_pd(gy, gy)), _mm256_mul_pd(gz, gz));
+			sq = _mm256_mul_pd(quarter, sq);
+			_mm_storeu_ps(magnitudes + i, _mm256_cvtpd_ps(_mm256_sqrt_pd(sq)));
+		}
+		for (; i < n; ++i)
+			magnitudes[i] = gradientMagnitudeScalar(voxels + i, rowStride, sliceStride);
+	}
+
+	TNM_TARGET("avx2") void boxStatisticsRowAvx2(const uint64_t* sum, const uint64_t* sumSquared,
+		ptrdiff_t dX, ptrdiff_t dY, ptrdiff_t dZ, uint64_t count, double offset, size_t n,
+		float* averages, float* stdDeviations)
+	{
+		const __m256d c = _mm256_set1_pd(double(count));
+		const __m256d o = _mm256_set1_pd(offset);
+		const __m256d normalization = _mm256_set1_pd(double(count * (count - 1)));
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			const __m256d s = uint52ToDoubleAvx2(loadBoxSumAvx2(sum + i, dX, dY, dZ));
+			const __m256d q = uint52ToDoubleAvx2(loadBoxSumAvx2(sumSquared + i, dX, dY, dZ));
+
+			_mm_storeu_ps(averages + i, _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_div_pd(s, c), o)));
+			const __m256d numerator = _mm256_sub_pd(_mm256_mul_pd(c, q), _mm256_mul_pd(s, s));
+			_mm_storeu_ps(stdDeviations + i, _mm256_cvtpd_ps(_mm256_sqrt_pd(_mm256_div_pd(numerator, normalization))));
+		}
+		boxStatisticsRowScalar(sum + i, sumSquared + i, dX, dY, dZ, count, offset, n - i, averages + i, stdDeviations + i);
+	}
+
+	const RowKernels avx2Kernels = {
+		"AVX2",
+		&gradientMagnitudeRowAvx2,
+		&boxStatisticsRowAvx2
+	};
+
+	bool cpuSupportsAvx2() {
+#if defined(__GNUC__) || defined(__clang__)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		// The OS has to save the AVX registers (OSXSAVE and XCR0 bits 1 and 2)
+		const bool osSupportsAvx = (info[2] & (1 << 27)) && ((_xgetbv(0) & 0x6) == 0x6);
+		__cpuidex(info, 7, 0);
+		return osSupportsAvx && (info[1] & (1 << 5));
+#else
+		return false;
+#endif
+	}
+
+	const RowKernels& selectKernels() {
+		if (cpuSupportsAvx2())
+			return avx2Kernels;
+		return sse2Kernels;
+	}
+
+#else
+
+	const RowKernels& selectKernels() {
+		return scalarKernels;
+	}
+
+#endif // TNM_X86_SIMD
+
+} // namespace
+
+const RowKernels& rowKernels() {
+	static const RowKernels& kernels = selectKernels();
+	return kernels;
+}
+
+const RowKernels& scalarRowKernels() {
+	return scalarKernels;
+}
+
+} // namespace voreen
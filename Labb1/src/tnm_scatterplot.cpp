@@ -2,9 +2,16 @@
 
 #include <algorithm>
 #include <limits>
+#include <sstream>
 
 namespace voreen {
 
+namespace {
+	// The flags of an item in the flag buffer; they match the vertex shader
+	const unsigned char FLAG_LINKED = 1;
+	const unsigned char FLAG_BRUSHED = 2;
+}
+
 TNMScatterPlot::TNMScatterPlot()
     : RenderProcessor()
     , _inport(Port::INPORT, "in.data")
@@ -14,7 +21,14 @@ TNMScatterPlot::TNMScatterPlot()
     , _secondAxis("secondAxis", "Second Axis")
 	, _brushingIndices("brushingIndices", "Brushing Indices")
 	, _linkingIndices("linkingIndices", "Linking Indices")
+	, _positionVbo(0)
+	, _flagVbo(0)
+	, _brushingVersion(0)
+	, _linkingVersion(0)
 {
+    _bufferAxes[0] = -1;
+    _bufferAxes[1] = -1;
+
     addPort(_inport);
     addPort(_outport);
 
@@ -23,16 +37,33 @@ TNMScatterPlot::TNMScatterPlot()
 	addProperty(_brushingIndices);
 	addProperty(_linkingIndices);
 
-	// Assign the option value "Intensity" to the value 0 etc
-    _firstAxis.addOption("0", "Intensity", 0);
-    _firstAxis.addOption("1", "Average", 1);
-    _firstAxis.addOption("2", "Standard Deviation", 2);
-    _firstAxis.addOption("3", "Gradient Magnitude", 3);
+	// Assign the option value "Intensity" to the value 0 etc. These are the default features of
+	// TNMVolumeInformation; the options are replaced by the features of the data once it arrives
+    const char* defaultFeatures[] = { "Intensity", "Average", "Standard Deviation", "Gradient Magnitude" };
+    std::vector<std::string> featureNames(defaultFeatures, defaultFeatures + 4);
+    updateAxisOptions(featureNames);
+}
 
-    _secondAxis.addOption("0", "Intensity", 0);
-    _secondAxis.addOption("1", "Average", 1);
-    _secondAxis.addOption("2", "Standard Deviation", 2);
-    _secondAxis.addOption("3", "Gradient Magnitude", 3);
+void TNMScatterPlot::updateAxisOptions(const std::vector<std::string>& featureNames) {
+    if (featureNames == _featureNames)
+        return;
+    _featureNames = featureNames;
+
+	// The key of an option is the index of the feature, so that saved workspaces keep their axes
+    std::vector<Option<int> > options;
+    for (size_t i = 0; i < featureNames.size(); ++i) {
+        std::ostringstream key;
+        key << i;
+        options.push_back(Option<int>(key.str(), featureNames[i], static_cast<int>(i)));
+    }
+
+    IntOptionProperty* axes[] = { &_firstAxis, &_secondAxis };
+    for (size_t i = 0; i < 2; ++i) {
+        const std::string key = axes[i]->getOptions().empty() ? "" : axes[i]->getKey();
+        axes[i]->setOptions(options);
+        if (axes[i]->hasKey(key))
+            axes[i]->selectByKey(key);
+    }
 }
 
 void TNMScatterPlot::initialize() throw (tgt::Exception) {
@@ -42,6 +73,12 @@ void TNMScatterPlot::initialize() throw (tgt::Exception) {
 
 void TNMScatterPlot::deinitialize() throw (tgt::Exception) {
 	ShdrMgr.dispose(_shader);
+	if (_positionVbo != 0) {
+		glDeleteBuffers(1, &_positionVbo);
+		glDeleteBuffers(1, &_flagVbo);
+	}
+	_positionVbo = 0;
+	_flagVbo = 0;
 }
 
 void TNMScatterPlot::process() {
@@ -55,108 +92,123 @@ void TNMScatterPlot::process() {
 
 	// Access the provided data. We have already checked before that it exists, so dereferencing it here is safe
     const Data& data = *(_inport.getData());
-
-	// The set contains all indices of voxels that should be ignored
-	const std::set<unsigned int>& brushingIndices = _brushingIndices.get();
-	// The set contains all indices of voxels that should be visually selected
-	const std::set<unsigned int>& selectionIndices = _linkingIndices.get();
-
-	// The number of points is equal to the number in the original dataset minus the number we are ignoring
-	const size_t dataSize = data.size() - brushingIndices.size();
-	// There are 2 coordinate components for each point
-	const size_t nCoordinateComponents = dataSize * 2;
-
-	// The vector containing the position data
-	std::vector<float> positionData;
-	// Make room in the vector
-	positionData.resize(nCoordinateComponents); 
-
-	// The vector containing boolean flags saying for each position if it is selected
-	// OpenGL doesn't support boolean values for the vertex buffer, so we take the next best thing instead
-	std::vector<unsigned char> selectionData(dataSize, 0);
-	
-	// In order to map the value ranges to [-1,1] we need to find the mininum and maximum values
-	float minimumFirstCoordinate = std::numeric_limits<float>::max();
-	float maximumFirstCoordinate = -std::numeric_limits<float>::max();
-	float minimumSecondCoordinate = std::numeric_limits<float>::max();
-	float maximumSecondCoordinate = -std::numeric_limits<float>::max();
-	// i: index into the data
-	// j: index into the coordinates
-	for (size_t i = 0, j = 0; i < data.size(); ++i) {
-		//// See if the index i is in the vector for brushing
-		if (brushingIndices.find(data[i].voxelIndex) != brushingIndices.end())
-			// If it is, we ignore it
-			continue;
-		else {
-			// otherwise add it to the position data
-			// _firstAxis.getValue() and _secondAxis.getValue() returns the integer value specified above
-			// to determine which selection was chosen in the GUI
-			const float firstCoordinate = data[i].dataValues[_firstAxis.getValue()];
-			const float secondCoordinate = data[i].dataValues[_secondAxis.getValue()];
-			positionData[j] = firstCoordinate;
-			positionData[j+1] = secondCoordinate;
-			j += 2;
-
-			minimumFirstCoordinate = std::min(minimumFirstCoordinate, firstCoordinate);
-			maximumFirstCoordinate = std::max(maximumFirstCoordinate, firstCoordinate);
-			minimumSecondCoordinate = std::min(minimumSecondCoordinate, secondCoordinate);
-			maximumSecondCoordinate = std::max(maximumSecondCoordinate, secondCoordinate);
-		}
-	}
-
-	// In a second step, we need to normalize the found data. By now we have looked at each value and found the
-	// min/max values
-	// Normalizing the data values to the range [-1,1]
-	for (size_t i = 0; i < nCoordinateComponents; i+=2) {
-		// First normalize to [0,1]
-		positionData[i] = (positionData[i] - minimumFirstCoordinate) / (maximumFirstCoordinate - minimumFirstCoordinate);
-		positionData[i+1] = (positionData[i+1] - minimumSecondCoordinate) / (maximumSecondCoordinate - minimumSecondCoordinate);
-		
-		// Then shift the normalized values to [-1,1]
-		positionData[i] = (positionData[i] - 0.5f) * 2.f;
-		positionData[i+1] = (positionData[i+1] - 0.5f) * 2.f;
-	}
-
-	// Set the selection array for all selected indices
-	for (std::set<unsigned int>::const_iterator i = selectionIndices.begin();
-		i != selectionIndices.end();
-		++i) 
-	{
-		const unsigned int thisIndex = *i;
-		selectionData[thisIndex] = 1;
-	}
+	// The axes can only show the features that were actually extracted
+    updateAxisOptions(data.getFeatureNames());
+    if (data.getNumFeatures() == 0) {
+        _outport.deactivateTarget();
+        return;
+    }
+
+	// Only the flags of the items whose indices changed since the last frame are updated, unless
+	// the data or the axes changed or the changes are not recorded anymore
+    const bool isSameBuffer = _positionVbo != 0 && !_inport.hasChanged() && _flags.size() == data.size()
+        && _bufferAxes[0] == _firstAxis.getValue() && _bufferAxes[1] == _secondAxis.getValue();
+    IndexSet brushed;
+    IndexSet unbrushed;
+    IndexSet linked;
+    IndexSet unlinked;
+    if (isSameBuffer && _brushingIndices.getChangesSince(_brushingVersion, brushed, unbrushed)
+        && _linkingIndices.getChangesSince(_linkingVersion, linked, unlinked))
+    {
+        size_t first = data.size();
+        size_t last = 0;
+        updateFlags(data, brushed, FLAG_BRUSHED, true, first, last);
+        updateFlags(data, unbrushed, FLAG_BRUSHED, false, first, last);
+        updateFlags(data, linked, FLAG_LINKED, true, first, last);
+        updateFlags(data, unlinked, FLAG_LINKED, false, first, last);
+        if (first <= last) {
+            glBindBuffer(GL_ARRAY_BUFFER, _flagVbo);
+            glBufferSubData(GL_ARRAY_BUFFER, first, last - first + 1, &(_flags[first]));
+        }
+    }
+    else
+        rebuildBuffers(data);
+    _brushingVersion = _brushingIndices.getVersion();
+    _linkingVersion = _linkingIndices.getVersion();
 
 	// We want to be able to set the point size from the vertex shader
 	glEnable(GL_PROGRAM_POINT_SIZE);
 
-	// Activate, create, and fill the vbo containing the position data
-	GLuint vbo;
+	glBindBuffer(GL_ARRAY_BUFFER, _positionVbo);
 	glEnableVertexAttribArray(0);
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, positionData.size() * sizeof(float), &(positionData[0]), GL_STATIC_DRAW);
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-	// Activate, create, and fill the vbo containing the selection data
-	GLuint selectionVbo;
+	glBindBuffer(GL_ARRAY_BUFFER, _flagVbo);
 	glEnableVertexAttribArray(1);
-	glGenBuffers(1, &selectionVbo);
-	glBindBuffer(GL_ARRAY_BUFFER, selectionVbo);
-	glBufferData(GL_ARRAY_BUFFER, selectionData.size() * sizeof(unsigned char), &(selectionData[0]), GL_STATIC_DRAW);
 	glVertexAttribIPointer(1, 1, GL_UNSIGNED_BYTE, 0, 0);
 
 	// Activate the shader required for rendering
 	_shader->activate();
 
-	// Draw the points
-	glDrawArrays(GL_POINTS, 0, dataSize);
+	// Draw the points; the brushed points are discarded by the vertex shader
+	glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(data.size()));
 
 	// And be a good citizen and clean up
 	_shader->deactivate();
-	glDeleteBuffers(1, &vbo);
+	glDisableVertexAttribArray(0);
+	glDisableVertexAttribArray(1);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glDisable(GL_PROGRAM_POINT_SIZE);
     _outport.deactivateTarget();
 }
 
+void TNMScatterPlot::rebuildBuffers(const Data& data) {
+	// There are 2 coordinate components for each point
+	std::vector<float> positionData(data.size() * 2);
+
+	// In order to map the value ranges to [-1,1] we need the minimum and maximum values, which
+	// the producer of the data has computed for all items, so the axes stay fixed while brushing
+	const ColumnStatistics& firstStatistics = data.statistics(_firstAxis.getValue());
+	const ColumnStatistics& secondStatistics = data.statistics(_secondAxis.getValue());
+	const float minimumFirstCoordinate = firstStatistics.minimum;
+	const float maximumFirstCoordinate = firstStatistics.maximum;
+	const float minimumSecondCoordinate = secondStatistics.minimum;
+	const float maximumSecondCoordinate = secondStatistics.maximum;
+	for (size_t i = 0; i < data.size(); ++i) {
+		// _firstAxis.getValue() and _secondAxis.getValue() returns the integer value specified above
+		// to determine which selection was chosen in the GUI. The values are normalized to [0,1]
+		// and then shifted to [-1,1]
+		const float firstCoordinate = (data.value(i, _firstAxis.getValue()) - minimumFirstCoordinate) / (maximumFirstCoordinate - minimumFirstCoordinate);
+		const float secondCoordinate = (data.value(i, _secondAxis.getValue()) - minimumSecondCoordinate) / (maximumSecondCoordinate - minimumSecondCoordinate);
+		positionData[2 * i] = (firstCoordinate - 0.5f) * 2.f;
+		positionData[2 * i + 1] = (secondCoordinate - 0.5f) * 2.f;
+	}
+
+	// OpenGL doesn't support boolean values for the vertex buffer, so the flags are bytes
+	_flags.assign(data.size(), 0);
+	size_t first = data.size();
+	size_t last = 0;
+	updateFlags(data, _brushingIndices.get(), FLAG_BRUSHED, true, first, last);
+	updateFlags(data, _linkingIndices.get(), FLAG_LINKED, true, first, last);
+
+	if (_positionVbo == 0) {
+		glGenBuffers(1, &_positionVbo);
+		glGenBuffers(1, &_flagVbo);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, _positionVbo);
+	glBufferData(GL_ARRAY_BUFFER, positionData.size() * sizeof(float), positionData.empty() ? 0 : &(positionData[0]), GL_STATIC_DRAW);
+	// The flags change with every interaction
+	glBindBuffer(GL_ARRAY_BUFFER, _flagVbo);
+	glBufferData(GL_ARRAY_BUFFER, _flags.size() * sizeof(unsigned char), _flags.empty() ? 0 : &(_flags[0]), GL_DYNAMIC_DRAW);
+
+	_bufferAxes[0] = _firstAxis.getValue();
+	_bufferAxes[1] = _secondAxis.getValue();
+}
+
+void TNMScatterPlot::updateFlags(const Data& data, const IndexSet& indices, unsigned char flag, bool set,
+    size_t& first, size_t& last)
+{
+	for (IndexSet::const_iterator i = indices.begin(); i != indices.end(); ++i) {
+		// Indices of voxels that are not part of the data, e.g. because it was reduced, are skipped
+		const size_t item = data.findItem(*i);
+		if (item == data.size())
+			continue;
+		if (set)
+			_flags[item] |= flag;
+		else
+			_flags[item] &= ~flag;
+		first = std::min(first, item);
+		last = std::max(last, item);
+	}
+}
 
 } // namespace
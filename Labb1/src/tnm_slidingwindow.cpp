@@ -0,0 +1,133 @@
+#include "modules/tnm093/include/tnm_slidingwindow.h"
+
+namespace voreen {
+
+namespace {
+	// Replaces every element data[o][l][j] (o < outer, l < length, j < inner) by the sum of the
+	// elements data[o][l - radius .. l + radius][j] that lie inside the line. The window is moved
+	// along l by adding the entering and subtracting the leaving element. As the inner index is
+	// contiguous, the y and z passes add and subtract whole rows or slices at once.
+	// The element leaving the window was already overwritten, so the original values of the last
+	// radius + 1 positions are kept in 'history'
+	void runningSum(double* data, size_t outer, size_t length, size_t inner, size_t radius,
+		std::vector<double>& window, std::vector<double>& history)
+	{
+		window.resize(inner);
+		history.resize((radius + 1) * inner);
+
+		for (size_t o = 0; o < outer; ++o) {
+			double* block = data + o * length * inner;
+
+			std::fill(window.begin(), window.end(), 0.0);
+			for (size_t l = 0; l <= radius && l < length; ++l) {
+				const double* entering = block + l * inner;
+				for (size_t j = 0; j < inner; ++j)
+					window[j] += entering[j];
+			}
+
+			for (size_t l = 0; l < length; ++l) {
+				double* current = block + l * inner;
+				double* saved = &history[(l % (radius + 1)) * inner];
+				const double* entering = (l + radius + 1 < length) ? block + (l + radius + 1) * inner : 0;
+				const double* leaving = (l >= radius) ? &history[((l - radius) % (radius + 1)) * inner] : 0;
+
+				for (size_t j = 0; j < inner; ++j) {
+					saved[j] = current[j];
+					current[j] = window[j];
+				}
+				if (entering) {
+					for (size_t j = 0; j < inner; ++j)
+						window[j] += entering[j];
+				}
+				if (leaving) {
+					for (size_t j = 0; j < inner; ++j)
+						window[j] -= leaving[j];
+				}
+			}
+		}
+	}
+}
+
+SlidingWindowStatistics::SlidingWindowStatistics()
+    : _dimensions(0, 0, 0)
+    , _firstSlice(0)
+    , _endSlice(0)
+    , _radius(1)
+    , _shift(0.0)
+{}
+
+void SlidingWindowStatistics::build(const VolumeUInt8* volume, size_t radius, size_t firstSlice, size_t endSlice) {
+    _radius = radius;
+    build(volume, firstSlice, endSlice);
+}
+
+void SlidingWindowStatistics::build(const VolumeUInt16* volume, size_t radius, size_t firstSlice, size_t endSlice) {
+    _radius = radius;
+    build(volume, firstSlice, endSlice);
+}
+
+void SlidingWindowStatistics::build(const VolumeInt16* volume, size_t radius, size_t firstSlice, size_t endSlice) {
+    _radius = radius;
+    build(volume, firstSlice, endSlice);
+}
+
+void SlidingWindowStatistics::build(const VolumeFloat* volume, size_t radius, size_t firstSlice, size_t endSlice) {
+    _radius = radius;
+    build(volume, firstSlice, endSlice);
+}
+
+template <typename T>
+void SlidingWindowStatistics::build(const VolumeAtomic<T>* volume, size_t firstSlice, size_t endSlice) {
+    _dimensions = volume->getDimensions();
+    _firstSlice = firstSlice;
+    _endSlice = endSlice;
+    const size_t nSlices = endSlice - firstSlice;
+    const size_t nVoxels = _dimensions.x * _dimensions.y * nSlices;
+    if (nVoxels == 0)
+        return;
+    const T* voxels = volume->voxel() + firstSlice * _dimensions.x * _dimensions.y;
+
+    double total = 0.0;
+    for (size_t i = 0; i < nVoxels; ++i)
+        total += voxels[i];
+    _shift = total / nVoxels;
+
+    _sum.resize(nVoxels);
+    _sumSquared.resize(nVoxels);
+    for (size_t i = 0; i < nVoxels; ++i) {
+        const double value = double(voxels[i]) - _shift;
+        _sum[i] = value;
+        _sumSquared[i] = value * value;
+    }
+
+	// x, then y, then z; each pass sums the results of the previous one along the next axis
+    std::vector<double> window;
+    std::vector<double> history;
+    std::vector<double>* tables[] = { &_sum, &_sumSquared };
+    for (size_t t = 0; t < 2; ++t) {
+        double* data = &(*tables[t])[0];
+        runningSum(data, _dimensions.y * nSlices, _dimensions.x, 1, _radius, window, history);
+        runningSum(data, nSlices, _dimensions.y, _dimensions.x, _radius, window, history);
+        runningSum(data, 1, nSlices, _dimensions.x * _dimensions.y, _radius, window, history);
+    }
+}
+
+void SlidingWindowStatistics::clear() {
+    _dimensions = tgt::svec3(0, 0, 0);
+    _firstSlice = 0;
+    _endSlice = 0;
+    _shift = 0.0;
+	// swapping with an empty vector is the only portable way to release the memory
+    std::vector<double>().swap(_sum);
+    std::vector<double>().swap(_sumSquared);
+}
+
+size_t SlidingWindowStatistics::getRadius() const {
+    return _radius;
+}
+
+size_t SlidingWindowStatistics::memoryUsage(const tgt::svec3& dimensions, size_t nSlices) {
+    return 2 * sizeof(double) * dimensions.x * dimensions.y * nSlices;
+}
+
+} // namespace voreen
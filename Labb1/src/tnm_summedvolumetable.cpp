@@ -0,0 +1,131 @@
+#include "modules/tnm093/include/tnm_summedvolumetable.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace voreen {
+
+SummedVolumeTable::SummedVolumeTable()
+    : _dimensions(0, 0, 0)
+    , _firstSlice(0)
+    , _endSlice(0)
+    , _offset(0.0)
+{}
+
+void SummedVolumeTable::build(const VolumeUInt8* volume, size_t firstSlice, size_t endSlice) {
+    build(volume, firstSlice, endSlice, 0);
+}
+
+void SummedVolumeTable::build(const VolumeUInt16* volume, size_t firstSlice, size_t endSlice) {
+    build(volume, firstSlice, endSlice, 0);
+}
+
+void SummedVolumeTable::build(const VolumeInt16* volume, size_t firstSlice, size_t endSlice) {
+	// Maps -32768 to 0; the standard deviation does not depend on the shift at all
+    build(volume, firstSlice, endSlice, 32768);
+}
+
+size_t SummedVolumeTable::memoryUsage(const tgt::svec3& dimensions, size_t nSlices) {
+    return 2 * sizeof(uint64_t) * (dimensions.x + 1) * (dimensions.y + 1) * (nSlices + 1);
+}
+
+template <typename T>
+void SummedVolumeTable::build(const VolumeAtomic<T>* volume, size_t firstSlice, size_t endSlice, int offset) {
+    _dimensions = volume->getDimensions();
+    _firstSlice = firstSlice;
+    _endSlice = endSlice;
+    _offset = offset;
+    const size_t nSlices = endSlice - firstSlice;
+    const size_t nEntries = (_dimensions.x + 1) * (_dimensions.y + 1) * (nSlices + 1);
+
+	// assign also resets the zero border at x = 0, y = 0, and z = 0
+    _sum.assign(nEntries, 0);
+    _sumSquared.assign(nEntries, 0);
+
+	// The entry (x+1, y+1, z+1) is the running sum along the current row plus the entries
+	// of the previous row and the previous slice, minus their common part
+    for (size_t iZ = 0; iZ < nSlices; ++iZ) {
+        const size_t slice = firstSlice + iZ;
+        for (size_t iY = 0; iY < _dimensions.y; ++iY) {
+            uint64_t rowSum = 0;
+            uint64_t rowSumSquared = 0;
+            for (size_t iX = 0; iX < _dimensions.x; ++iX) {
+                const uint64_t value = static_cast<uint64_t>(
+                    int(volume->voxel(VolumeAtomic<T>::calcPos(_dimensions, tgt::svec3(iX, iY, slice)))) + offset);
+                rowSum += value;
+                rowSumSquared += value * value;
+
+                const size_t current = index(iX + 1, iY + 1, iZ + 1);
+                const size_t previousRow = index(iX + 1, iY, iZ + 1);
+                const size_t previousSlice = index(iX + 1, iY + 1, iZ);
+                const size_t previousBoth = index(iX + 1, iY, iZ);
+
+                _sum[current] = rowSum + _sum[previousRow] + _sum[previousSlice] - _sum[previousBoth];
+                _sumSquared[current] = rowSumSquared + _sumSquared[previousRow]
+                    + _sumSquared[previousSlice] - _sumSquared[previousBoth];
+            }
+        }
+    }
+}
+
+void SummedVolumeTable::clear() {
+    _dimensions = tgt::svec3(0, 0, 0);
+    _firstSlice = 0;
+    _endSlice = 0;
+    _offset = 0.0;
+	// swapping with an empty vector is the only portable way to release the memory
+    std::vector<uint64_t>().swap(_sum);
+    std::vector<uint64_t>().swap(_sumSquared);
+}
+
+const tgt::svec3& SummedVolumeTable::getDimensions() const {
+    return _dimensions;
+}
+
+void SummedVolumeTable::boxSums(const tgt::svec3& llf, const tgt::svec3& urb,
+    uint64_t& count, uint64_t& sum, uint64_t& sumSquared) const
+{
+    const size_t x0 = llf.x;
+    const size_t y0 = llf.y;
+    const size_t z0 = llf.z - _firstSlice;
+    const size_t x1 = urb.x + 1;
+    const size_t y1 = urb.y + 1;
+    const size_t z1 = urb.z + 1 - _firstSlice;
+
+    count = uint64_t(x1 - x0) * (y1 - y0) * (z1 - z0);
+
+	// Inclusion-exclusion over the eight corners of the box. Intermediate values might wrap
+	// around, but the unsigned arithmetic guarantees that the final result is exact
+    sum = _sum[index(x1, y1, z1)]
+        - _sum[index(x0, y1, z1)] - _sum[index(x1, y0, z1)] - _sum[index(x1, y1, z0)]
+        + _sum[index(x0, y0, z1)] + _sum[index(x0, y1, z0)] + _sum[index(x1, y0, z0)]
+        - _sum[index(x0, y0, z0)];
+
+    sumSquared = _sumSquared[index(x1, y1, z1)]
+        - _sumSquared[index(x0, y1, z1)] - _sumSquared[index(x1, y0, z1)] - _sumSquared[index(x1, y1, z0)]
+        + _sumSquared[index(x0, y0, z1)] + _sumSquared[index(x0, y1, z0)] + _sumSquared[index(x1, y0, z0)]
+        - _sumSquared[index(x0, y0, z0)];
+}
+
+void SummedVolumeTable::neighborhood(const tgt::svec3& center, size_t radius,
+    float& average, float& stdDeviation) const
+{
+	// Clip the box against the volume in the same way the brute-force loops do
+    const tgt::svec3 llf(
+        center.x > radius ? center.x - radius : 0,
+        center.y > radius ? center.y - radius : 0,
+        std::max(center.z > radius ? center.z - radius : 0, _firstSlice));
+    const tgt::svec3 urb(
+        std::min(center.x + radius, _dimensions.x - 1),
+        std::min(center.y + radius, _dimensions.y - 1),
+        std::min(center.z + radius, _endSlice - 1));
+
+    uint64_t count;
+    uint64_t sum;
+    uint64_t sumSquared;
+    boxSums(llf, urb, count, sum, sumSquared);
+
+    statistics(count, sum, sumSquared, average, stdDeviation);
+}
+
+} // namespace voreen
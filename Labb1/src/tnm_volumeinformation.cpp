@@ -1,274 +1,1580 @@
 #include "modules/tnm093/include/tnm_volumeinformation.h"
+#include "modules/tnm093/include/tnm_bufferpool.h"
+#include "modules/tnm093/include/tnm_features.h"
+#include "modules/tnm093/include/tnm_histograms.h"
+#include "modules/tnm093/include/tnm_parallel.h"
+#include "modules/tnm093/include/tnm_rowkernels.h"
+#include "modules/tnm093/include/tnm_slidingwindow.h"
+#include "modules/tnm093/include/tnm_summedvolumetable.h"
 #include "voreen/core/datastructures/volume/volumeatomic.h"
+#include "voreen/core/voreenapplication.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <typeinfo>
 namespace voreen {
 
 	const std::string loggerCat_ = "TNMVolumeInformation";
 
 namespace {
-	// This ordering function allows us to sort the Data vector by the voxelIndex
-	// The extraction *should* produce a sorted list, but you never know
-	bool sortByIndex(const VoxelDataItem& lhs, const VoxelDataItem& rhs) {
-		return lhs.voxelIndex < rhs.voxelIndex;
+	// Has to be increased whenever the computation of any measure changes its results, so that
+	// old entries in the feature cache are not used anymore
+	const int FEATURE_DEFINITION_VERSION = 1;
+
+	// The largest box that the summed volume table kernels handle exactly is 11x11x11
+	const int MAX_NEIGHBORHOOD_RADIUS = 5;
+
+	// The coarsest level of the resolution pyramid, which has 1/64 of the voxels
+	const int MAX_RESOLUTION_LEVEL = 2;
+
+	// The largest coordinate of the region of interest; the default region ends here, which
+	// covers every volume
+	const int MAX_VOXEL_COORDINATE = (1 << 20) - 1;
+
+	// The number of z-slabs each worker thread processes on average
+	const size_t SLABS_PER_THREAD = 4;
+
+	// The number of rows along y that extractSlab sweeps through the slices of a slab together
+	const size_t TILE_ROWS = 16;
+
+	// The number of bytes the histograms of all threads may occupy together. With many bins, the
+	// joint histograms of a single thread take up more than 100 MB, so fewer copies than threads
+	// are accumulated then
+	const uint64_t HISTOGRAM_MEMORY_BUDGET = uint64_t(512) << 20;
+
+	// The number of bytes the tables for the neighborhood statistics may occupy if the extraction
+	// has no memory budget of its own. The tables take 16 bytes per voxel, so for a 512^3 volume
+	// they would need 2 GB if they were built for the whole volume at once
+	const size_t TABLE_MEMORY_BUDGET = size_t(512) << 20;
+
+	// The interval in milliseconds in which a running extraction is polled for its progress
+	const int PROGRESS_INTERVAL = 100;
+
+	// Shared between an extraction running on a background thread and the processor. The
+	// extraction counts the rows it has finished and stops as soon as 'cancelled' is set
+	struct ExtractionProgress {
+		std::atomic<bool> cancelled;
+		std::atomic<size_t> rowsDone;
+
+		ExtractionProgress() : cancelled(false), rowsDone(0) {}
+	};
+
+	// Describes which voxels of the volume the features are extracted from become items, and
+	// where they are stored. The items are the voxels inside the box [begin, end) whose intensity
+	// is at least 'threshold', if it is used, in memory order.
+	// The volume can be a downsampled part of the original volume, in which case the items still
+	// refer to the voxels of the original volume: (x, y, z) is the voxel (origin + (x, y, z)) of
+	// the original volume downsampled by 2^level, which covers the block starting at the voxel
+	// (origin + (x, y, z)) * 2^level of the original volume
+	struct ItemLayout {
+		tgt::svec3 begin; // The first voxel of the box
+		tgt::svec3 end; // One past the last voxel of the box
+		bool useThreshold; // Whether voxels below 'threshold' are skipped
+		float threshold; // The smallest intensity of a voxel that becomes an item
+		std::vector<size_t> rowOffsets; // The first item of each row of the box, followed by the number of items
+
+		tgt::svec3 origin; // The position of the volume in the downsampled original volume
+		int level; // The original volume is downsampled by 2^level
+		tgt::svec3 originalDimensions; // The dimensions of the original volume
+
+		// The index of the row (y, z) of the box in rowOffsets
+		size_t row(size_t y, size_t z) const {
+			return (z - begin.z) * (end.y - begin.y) + (y - begin.y);
+		}
+
+		// The first item of the slice z, or the number of items for z == end.z
+		size_t firstItem(size_t z) const {
+			return rowOffsets[row(begin.y, z)];
+		}
+
+		// Whether the items are consecutive voxels of the original volume, so that their voxel
+		// indices are implicit. This is the case for whole slices of the original resolution
+		bool isDense() const {
+			return level == 0 && !useThreshold &&
+				origin.x + begin.x == 0 && origin.x + end.x == originalDimensions.x &&
+				origin.y + begin.y == 0 && origin.y + end.y == originalDimensions.y;
+		}
+
+		// The index of the voxel (x, y, z) in the original volume
+		unsigned int voxelIndex(size_t x, size_t y, size_t z) const {
+			return static_cast<unsigned int>((((origin.z + z) << level) * originalDimensions.y
+				+ ((origin.y + y) << level)) * originalDimensions.x + ((origin.x + x) << level));
+		}
+	};
+
+	// Counts the voxels of each row of one slice of the box of an ItemLayout that are not below
+	// its threshold, so that the slices can be counted in parallel
+	template <typename T>
+	struct ItemCount {
+		const VolumeAtomic<T>* volume;
+		const ItemLayout* layout;
+		std::vector<size_t>* counts;
+
+		void operator()(size_t slice) const {
+			const size_t z = layout->begin.z + slice;
+			const tgt::svec3 dimensions = volume->getDimensions();
+			for (size_t y = layout->begin.y; y < layout->end.y; ++y) {
+				const T* row = volume->voxel() + (z * dimensions.y + y) * dimensions.x;
+				size_t count = 0;
+				for (size_t x = layout->begin.x; x < layout->end.x; ++x)
+					count += (static_cast<float>(row[x]) >= layout->threshold) ? 1 : 0;
+				(*counts)[layout->row(y, z)] = count;
+			}
+		}
+	};
+
+	// Computes the 'features' for the items of 'layout' in the slab of slices [zBegin, zEnd).
+	// Neighbors in the adjacent slabs are read directly from the shared volume, so the one voxel
+	// halo needed by the stencils requires no copy. Every voxel only writes its own item in
+	// 'data', which allows several slabs to be processed at the same time.
+	// The voxels are visited in memory order (x fastest, then y, then z), blocked into tiles of
+	// TILE_ROWS rows that are swept through all slices of the slab, so that the rows of the
+	// stencil are still in the cache when the next slice needs them. Each row is handed to every
+	// feature in turn, so all features are computed in a single sweep over the volume.
+	// Cancellation is checked once per tile, which bounds the time until a cancelled
+	// extraction stops without slowing down the loops over the voxels.
+	// If the values of 'data' are encoded with 16 bits, the largest difference between a value
+	// and its encoding is accumulated for each feature in 'encodingErrors'. The unencoded values
+	// of the items are added to 'histograms', if it is not 0.
+	// Each feature writes the values of a row contiguously into its column of 'data'
+	void extractSlab(const FeatureSource& source, const std::vector<const Feature*>& features,
+		const ItemLayout& layout, size_t zBegin, size_t zEnd, Data& data, ExtractionProgress& progress,
+		float* encodingErrors, FeatureHistograms* histograms)
+	{
+        const tgt::svec3& dimensions = source.dimensions;
+        const size_t nFeatures = features.size();
+        FeatureRow row(source);
+        const bool isEncoded = data.getValueEncoding() != Data::ValueEncodingFloat32;
+        std::vector<float> rowValues(dimensions.x * nFeatures);
+
+        for (size_t yTile = layout.begin.y; yTile < layout.end.y; yTile += TILE_ROWS) {
+            if (progress.cancelled)
+                return;
+            const size_t yTileEnd = std::min(yTile + TILE_ROWS, layout.end.y);
+            for (size_t iZ = zBegin; iZ < zEnd; ++iZ) {
+                for (size_t iY = yTile; iY < yTileEnd; ++iY) {
+                    row.setRow(iY, iZ);
+                    const size_t rowIndex = layout.row(iY, iZ);
+                    const size_t firstItem = layout.rowOffsets[rowIndex];
+                    const size_t nItems = layout.rowOffsets[rowIndex + 1] - firstItem;
+                    if (nItems == 0)
+                        continue;
+
+	// Every feature computes the row into its own column. If every voxel of the row is an item,
+	// the float values are written into the columns of 'data' without a copy
+                    const bool isBuffered = isEncoded || nItems != dimensions.x || histograms != 0;
+                    for (size_t f = 0; f < nFeatures; ++f) {
+                        float* values = isBuffered ? &rowValues[f * dimensions.x] : data.column(f) + firstItem;
+                        features[f]->computeRow(row, values, 1);
+                    }
+
+	// The values of the items are moved to the front of each row of rowValues
+                    const float* intensities = layout.useThreshold ? row.voxels() : 0;
+                    const bool storesVoxelIndices = !data.hasImplicitVoxelIndices();
+                    size_t item = firstItem;
+                    for (size_t iX = layout.begin.x; iX < layout.end.x; ++iX) {
+                        if (intensities && !(intensities[iX] >= layout.threshold))
+                            continue;
+                        if (storesVoxelIndices)
+                            data.setVoxelIndex(item, layout.voxelIndex(iX, iY, iZ));
+                        for (size_t f = 0; isBuffered && f < nFeatures; ++f)
+                            rowValues[f * dimensions.x + item - firstItem] = rowValues[f * dimensions.x + iX];
+                        ++item;
+                    }
+                    if (!isBuffered)
+                        continue;
+
+                    for (size_t f = 0; f < nFeatures; ++f) {
+                        const float* values = &rowValues[f * dimensions.x];
+                        data.setColumnValues(f, firstItem, nItems, values);
+                        for (size_t i = 0; isEncoded && i < nItems; ++i) {
+                            const float error = std::fabs(data.value(firstItem + i, f) - values[i]);
+                            encodingErrors[f] = std::max(encodingErrors[f], error);
+                        }
+                    }
+                    for (size_t i = 0; histograms && i < nItems; ++i)
+                        histograms->add(rowValues.data() + i, dimensions.x);
+                }
+            }
+            progress.rowsDone += (yTileEnd - yTile) * (zEnd - zBegin);
+        }
+	}
+
+	// Wraps extractSlab so that parallelFor can hand out one slab of the slices
+	// [firstSlice, endSlice) per task
+	struct SlabExtraction {
+		const FeatureSource* source;
+		const std::vector<const Feature*>* features;
+		const ItemLayout* layout;
+		size_t firstSlice;
+		size_t endSlice;
+		size_t slabThickness;
+		Data* data;
+		ExtractionProgress* progress;
+		std::vector<float>* encodingErrors; // The errors of each slab, one per feature, if the values are encoded
+		std::vector<FeatureHistograms>* histograms; // The histograms of each thread, or 0
+
+		void operator()(size_t slab, size_t thread) const {
+			const size_t zBegin = firstSlice + slab * slabThickness;
+			const size_t zEnd = std::min(zBegin + slabThickness, endSlice);
+			float* slabErrors = encodingErrors->empty() ? 0 : &(*encodingErrors)[slab * features->size()];
+			FeatureHistograms* threadHistograms = histograms ? &(*histograms)[thread] : 0;
+			extractSlab(*source, *features, *layout, zBegin, zEnd, *data, *progress, slabErrors, threadHistograms);
+		}
+	};
+
+	// The summed volume table needs exact integer sums, so it is not available for floating
+	// point volumes, which use the sliding window instead
+	template <typename T>
+	bool buildSummedVolumeTable(const VolumeAtomic<T>* volume, size_t firstSlice, size_t endSlice,
+		SummedVolumeTable& summedVolumeTable)
+	{
+		summedVolumeTable.build(volume, firstSlice, endSlice);
+		return true;
+	}
+
+	bool buildSummedVolumeTable(const VolumeFloat*, size_t, size_t, SummedVolumeTable&) {
+		return false;
+	}
+
+	template <typename T>
+	bool supportsSummedVolumeTable(const VolumeAtomic<T>*) {
+		return true;
+	}
+
+	bool supportsSummedVolumeTable(const VolumeFloat*) {
+		return false;
+	}
+
+	// Returns the number of slices of a box of 'boxSize' voxels that can be processed at once
+	// without exceeding 'memoryBudget' bytes. A brick of n slices needs the tables for the n
+	// slices plus the halo of 'radius' slices on both sides, and keeps the output items of its n
+	// slices in memory until they are written to the file
+	size_t brickSlices(const tgt::svec3& boxSize, size_t radius, size_t bytesPerTableSlice,
+		size_t bytesPerItem, size_t memoryBudget)
+	{
+		const size_t bytesPerSlice = bytesPerTableSlice + bytesPerItem * boxSize.x * boxSize.y;
+		const size_t halo = 2 * radius * bytesPerTableSlice;
+		if (memoryBudget <= halo + bytesPerSlice) {
+			LWARNING("The memory budget is too small for a single slice, processing one slice at a time");
+			return 1;
+		}
+		return std::min((memoryBudget - halo) / bytesPerSlice, boxSize.z);
+	}
+
+	// Computes the 'features' for the items of 'layout' in the slices [firstSlice, endSlice) of
+	// its box in 'volume' into 'data', which has to have the number of items of the layout. This
+	// is instantiated once for each supported voxel type, so that the type is dispatched once per
+	// volume instead of once per voxel.
+	// The box is processed in bricks of whole slices, each with its own tables for the
+	// neighborhood statistics. If 'memoryBudget' is not 0, neither the tables nor the output of a
+	// brick exceed the budget, and the output of each finished brick is written to the mapped file
+	// of 'data' and dropped from memory. Otherwise the output stays in memory and only the tables
+	// are kept within TABLE_MEMORY_BUDGET.
+	// If 'progress' is cancelled, the extraction returns early and leaves 'data' incomplete.
+	// 'encodingErrors' is raised to the largest error of each feature caused by the value
+	// encoding of 'data'. If 'histograms' is not 0, each worker thread adds the items it extracts
+	// to its own element, so that no locking is needed; it needs one element per thread
+	template <typename T>
+	void extractFeatures(const VolumeAtomic<T>* volume, const std::vector<const Feature*>& features,
+		const ItemLayout& layout, size_t firstSlice, size_t endSlice,
+		TNMVolumeInformation::NeighborhoodMethod method, size_t radius, size_t nThreads,
+		size_t memoryBudget, Data& data, ExtractionProgress& progress, std::vector<float>& encodingErrors,
+		std::vector<FeatureHistograms>* histograms)
+	{
+        const tgt::svec3 dimensions = volume->getDimensions();
+        encodingErrors.resize(features.size(), 0.f);
+
+	// The vectorized kernels are chosen at runtime, depending on the instruction sets of the CPU
+        FeatureSource source = createFeatureSource(volume, radius);
+
+	// The tables for the neighborhood statistics are only built if a selected feature needs them
+        bool needsNeighborhoodStatistics = false;
+        for (size_t i = 0; i < features.size(); ++i)
+            needsNeighborhoodStatistics |= features[i]->usesNeighborhoodStatistics();
+        if (!needsNeighborhoodStatistics)
+            method = TNMVolumeInformation::NeighborhoodMethodBruteForce;
+
+        if (method == TNMVolumeInformation::NeighborhoodMethodSummedVolumeTable && !supportsSummedVolumeTable(volume)) {
+            LINFO("The summed volume table requires integer voxels, using the sliding window instead");
+            method = TNMVolumeInformation::NeighborhoodMethodSlidingWindow;
+        }
+
+        size_t bytesPerTableSlice = 0;
+        if (method == TNMVolumeInformation::NeighborhoodMethodSummedVolumeTable)
+            bytesPerTableSlice = SummedVolumeTable::memoryUsage(dimensions, 1);
+        else if (method == TNMVolumeInformation::NeighborhoodMethodSlidingWindow)
+            bytesPerTableSlice = SlidingWindowStatistics::memoryUsage(dimensions, 1);
+        const size_t bytesPerItem = sizeof(unsigned int) + features.size() * data.getBytesPerValue();
+        const tgt::svec3 boxSize(layout.end.x - layout.begin.x, layout.end.y - layout.begin.y, endSlice - firstSlice);
+        size_t nBrickSlices = boxSize.z;
+        if (memoryBudget != 0)
+            nBrickSlices = brickSlices(boxSize, radius, bytesPerTableSlice, bytesPerItem, memoryBudget);
+        else if (bytesPerTableSlice != 0)
+            nBrickSlices = brickSlices(boxSize, radius, bytesPerTableSlice, 0, TABLE_MEMORY_BUDGET);
+
+        SummedVolumeTable summedVolumeTable;
+        SlidingWindowStatistics slidingWindow;
+        for (size_t brickBegin = firstSlice; brickBegin < endSlice; brickBegin += nBrickSlices) {
+            if (progress.cancelled)
+                return;
+            const size_t brickEnd = std::min(brickBegin + nBrickSlices, endSlice);
+	// The tables include the 'radius' slices on both sides of the brick, so that the neighborhoods
+	// of its outermost slices are complete. The voxels of the halo are read from the shared
+	// volume again, so no data has to be exchanged between the bricks
+            const size_t tableBegin = brickBegin > radius ? brickBegin - radius : 0;
+            const size_t tableEnd = std::min(brickEnd + radius, dimensions.z);
+
+	// The summed volume table answers every neighborhood query with a constant number of lookups,
+	// at the cost of two 64 bit entries per voxel that are only kept during the extraction
+            if (method == TNMVolumeInformation::NeighborhoodMethodSummedVolumeTable) {
+                PROFILING_BLOCK("summedvolumetable");
+                if (buildSummedVolumeTable(volume, tableBegin, tableEnd, summedVolumeTable))
+                    source.summedVolumeTable = &summedVolumeTable;
+            }
+
+	// The sliding window has the same radius-independent cost, but works in double precision
+            if (method == TNMVolumeInformation::NeighborhoodMethodSlidingWindow) {
+                PROFILING_BLOCK("slidingwindow");
+                slidingWindow.build(volume, radius, tableBegin, tableEnd);
+                source.slidingWindow = &slidingWindow;
+            }
+
+	// The brick is split into slabs along z, which are distributed over the worker threads.
+	// Using several slabs per thread keeps the threads busy if some slabs are more expensive
+            const size_t nSlices = brickEnd - brickBegin;
+            const size_t nSlabs = std::max<size_t>(std::min(nSlices, nThreads * SLABS_PER_THREAD), 1);
+            SlabExtraction extraction;
+            extraction.source = &source;
+            extraction.features = &features;
+            extraction.layout = &layout;
+            extraction.firstSlice = brickBegin;
+            extraction.endSlice = brickEnd;
+            extraction.slabThickness = (nSlices + nSlabs - 1) / nSlabs;
+            extraction.data = &data;
+            extraction.progress = &progress;
+            const size_t nTasks = (nSlices + extraction.slabThickness - 1) / extraction.slabThickness;
+            std::vector<float> slabErrors;
+            if (data.getValueEncoding() != Data::ValueEncodingFloat32)
+                slabErrors.assign(nTasks * features.size(), 0.f);
+            extraction.encodingErrors = &slabErrors;
+            extraction.histograms = histograms;
+            {
+                PROFILING_BLOCK("extraction");
+                parallelForThreads(nTasks, nThreads, extraction);
+            }
+            for (size_t i = 0; i < slabErrors.size(); ++i)
+                encodingErrors[i % features.size()] = std::max(encodingErrors[i % features.size()], slabErrors[i]);
+
+            data.releaseItems(layout.firstItem(brickBegin), layout.firstItem(brickEnd) - layout.firstItem(brickBegin));
+        }
+	}
+
+	// Resolves the voxel type of 'volume' once for all of its voxels, see above
+	void extractFeatures(const Volume* volume, const std::vector<const Feature*>& features,
+		const ItemLayout& layout, size_t firstSlice, size_t endSlice,
+		TNMVolumeInformation::NeighborhoodMethod method, size_t radius, size_t nThreads,
+		size_t memoryBudget, Data& data, ExtractionProgress& progress, std::vector<float>& encodingErrors,
+		std::vector<FeatureHistograms>* histograms)
+	{
+		if (const VolumeUInt8* volumeUInt8 = dynamic_cast<const VolumeUInt8*>(volume))
+			extractFeatures(volumeUInt8, features, layout, firstSlice, endSlice, method, radius, nThreads, memoryBudget, data, progress, encodingErrors, histograms);
+		else if (const VolumeUInt16* volumeUInt16 = dynamic_cast<const VolumeUInt16*>(volume))
+			extractFeatures(volumeUInt16, features, layout, firstSlice, endSlice, method, radius, nThreads, memoryBudget, data, progress, encodingErrors, histograms);
+		else if (const VolumeInt16* volumeInt16 = dynamic_cast<const VolumeInt16*>(volume))
+			extractFeatures(volumeInt16, features, layout, firstSlice, endSlice, method, radius, nThreads, memoryBudget, data, progress, encodingErrors, histograms);
+		else if (const VolumeFloat* volumeFloat = dynamic_cast<const VolumeFloat*>(volume))
+			extractFeatures(volumeFloat, features, layout, firstSlice, endSlice, method, radius, nThreads, memoryBudget, data, progress, encodingErrors, histograms);
+	}
+
+	// Determines the smallest and the largest voxel of 'volume'
+	template <typename T>
+	void voxelRange(const VolumeAtomic<T>* volume, float& minimum, float& maximum) {
+		const T* voxels = volume->voxel();
+		const size_t nVoxels = volume->getNumBytes() / sizeof(T);
+		T low = nVoxels > 0 ? voxels[0] : T(0);
+		T high = low;
+		for (size_t i = 1; i < nVoxels; ++i) {
+			low = std::min(low, voxels[i]);
+			high = std::max(high, voxels[i]);
+		}
+		minimum = static_cast<float>(low);
+		maximum = static_cast<float>(high);
+	}
+
+	// Determines the range of the values of each feature from the range the feature reports for
+	// the voxels of 'volume'. Returns false if a feature can not bound its values
+	bool featureRanges(const Volume* volume, const std::vector<const Feature*>& features,
+		std::vector<float>& minimums, std::vector<float>& maximums)
+	{
+		float voxelMinimum = 0.f;
+		float voxelMaximum = 0.f;
+		if (const VolumeUInt8* volumeUInt8 = dynamic_cast<const VolumeUInt8*>(volume))
+			voxelRange(volumeUInt8, voxelMinimum, voxelMaximum);
+		else if (const VolumeUInt16* volumeUInt16 = dynamic_cast<const VolumeUInt16*>(volume))
+			voxelRange(volumeUInt16, voxelMinimum, voxelMaximum);
+		else if (const VolumeInt16* volumeInt16 = dynamic_cast<const VolumeInt16*>(volume))
+			voxelRange(volumeInt16, voxelMinimum, voxelMaximum);
+		else if (const VolumeFloat* volumeFloat = dynamic_cast<const VolumeFloat*>(volume))
+			voxelRange(volumeFloat, voxelMinimum, voxelMaximum);
+
+		minimums.resize(features.size());
+		maximums.resize(features.size());
+		for (size_t i = 0; i < features.size(); ++i) {
+			if (!features[i]->valueRange(voxelMinimum, voxelMaximum, minimums[i], maximums[i]))
+				return false;
+		}
+		return true;
+	}
+
+	// Chooses the offset and scale of each feature for a ValueEncodingQuantized16 encoding, so
+	// that the 16 bits cover the range the feature reports for the voxels of 'volume'. Returns
+	// false if a feature can not bound its values
+	bool quantization(const Volume* volume, const std::vector<const Feature*>& features,
+		std::vector<float>& offsets, std::vector<float>& scales)
+	{
+		std::vector<float> maximums;
+		if (!featureRanges(volume, features, offsets, maximums))
+			return false;
+		scales.resize(features.size());
+		for (size_t i = 0; i < features.size(); ++i)
+			scales[i] = (maximums[i] - offsets[i]) / 65535.f;
+		return true;
 	}
 
+	// The number of items each task of a HistogramAccumulation adds
+	const size_t HISTOGRAM_CHUNK_SIZE = 1 << 16;
+
+	// Adds the 'n' items of 'data' starting at 'first' to the histograms of the threads, for the
+	// items that were not extracted but loaded or copied
+	struct HistogramAccumulation {
+		const Data* data;
+		size_t first;
+		size_t n;
+		std::vector<FeatureHistograms>* histograms; // The histograms of each thread
+
+		void operator()(size_t chunk, size_t thread) const {
+			const size_t begin = first + chunk * HISTOGRAM_CHUNK_SIZE;
+			const size_t end = std::min(begin + HISTOGRAM_CHUNK_SIZE, first + n);
+			(*histograms)[thread].add(*data, begin, end - begin);
+		}
+	};
+
+	void accumulateHistograms(const Data& data, size_t first, size_t n, size_t nThreads,
+		std::vector<FeatureHistograms>& histograms)
+	{
+		HistogramAccumulation accumulation;
+		accumulation.data = &data;
+		accumulation.first = first;
+		accumulation.n = n;
+		accumulation.histograms = &histograms;
+		parallelForThreads((n + HISTOGRAM_CHUNK_SIZE - 1) / HISTOGRAM_CHUNK_SIZE, nThreads, accumulation);
+	}
+
+	struct MergeHistograms {
+		void operator()(FeatureHistograms& histograms, const FeatureHistograms& other) const {
+			histograms.merge(other);
+		}
+	};
+
+	// Merges the histograms of the threads into 'result'
+	void reduceHistograms(std::vector<FeatureHistograms>& histograms, size_t nThreads, FeatureHistograms& result) {
+		parallelReduce(histograms, nThreads, MergeHistograms());
+		std::swap(result, histograms[0]);
+	}
+
+	// Rounds the average of integer voxels to the nearest integer
+	template <typename T>
+	T averageVoxel(double sum, size_t count) {
+		return static_cast<T>(std::floor(sum / double(count) + 0.5));
+	}
+
+	template <>
+	float averageVoxel<float>(double sum, size_t count) {
+		return static_cast<float>(sum / double(count));
+	}
+
+	// The number of voxels along an axis with 'size' voxels after downsampling by 2^level
+	size_t downsampledSize(size_t size, int level) {
+		return (size + (size_t(1) << level) - 1) >> level;
+	}
+
+	// Creates a copy of 'volume' with a resolution reduced by 2^level along each axis. Each voxel
+	// is the average of its block of 2^level x 2^level x 2^level voxels; the blocks at the upper
+	// borders are clipped against the volume
+	template <typename T>
+	Volume* downsample(const VolumeAtomic<T>* volume, int level) {
+		const tgt::svec3 dimensions = volume->getDimensions();
+		const tgt::svec3 downsampledDimensions(downsampledSize(dimensions.x, level),
+			downsampledSize(dimensions.y, level), downsampledSize(dimensions.z, level));
+		VolumeAtomic<T>* downsampled = new VolumeAtomic<T>(downsampledDimensions);
+
+		const T* voxels = volume->voxel();
+		T* downsampledVoxels = downsampled->voxel();
+		std::vector<double> sums(downsampledDimensions.x);
+		std::vector<size_t> counts(downsampledDimensions.x);
+	// Each downsampled row accumulates the full-resolution rows of its blocks in memory order
+		for (size_t z = 0; z < downsampledDimensions.z; ++z) {
+			for (size_t y = 0; y < downsampledDimensions.y; ++y) {
+				std::fill(sums.begin(), sums.end(), 0.0);
+				std::fill(counts.begin(), counts.end(), 0);
+				for (size_t iZ = z << level; iZ < std::min((z + 1) << level, dimensions.z); ++iZ) {
+					for (size_t iY = y << level; iY < std::min((y + 1) << level, dimensions.y); ++iY) {
+						const T* row = voxels + (iZ * dimensions.y + iY) * dimensions.x;
+						for (size_t iX = 0; iX < dimensions.x; ++iX) {
+							sums[iX >> level] += static_cast<double>(row[iX]);
+							++counts[iX >> level];
+						}
+					}
+				}
+				T* downsampledRow = downsampledVoxels + (z * downsampledDimensions.y + y) * downsampledDimensions.x;
+				for (size_t x = 0; x < downsampledDimensions.x; ++x)
+					downsampledRow[x] = averageVoxel<T>(sums[x], counts[x]);
+			}
+		}
+		return downsampled;
+	}
+
+	Volume* downsample(const Volume* volume, int level) {
+		if (const VolumeUInt8* volumeUInt8 = dynamic_cast<const VolumeUInt8*>(volume))
+			return downsample(volumeUInt8, level);
+		if (const VolumeUInt16* volumeUInt16 = dynamic_cast<const VolumeUInt16*>(volume))
+			return downsample(volumeUInt16, level);
+		if (const VolumeInt16* volumeInt16 = dynamic_cast<const VolumeInt16*>(volume))
+			return downsample(volumeInt16, level);
+		if (const VolumeFloat* volumeFloat = dynamic_cast<const VolumeFloat*>(volume))
+			return downsample(volumeFloat, level);
+		return 0;
+	}
+
+	// Creates a copy of the box [begin, end) of 'volume'
+	template <typename T>
+	Volume* crop(const VolumeAtomic<T>* volume, const tgt::svec3& begin, const tgt::svec3& end) {
+		const tgt::svec3 dimensions = volume->getDimensions();
+		const tgt::svec3 croppedDimensions = end - begin;
+		VolumeAtomic<T>* cropped = new VolumeAtomic<T>(croppedDimensions);
+		T* croppedVoxels = cropped->voxel();
+		for (size_t z = begin.z; z < end.z; ++z) {
+			for (size_t y = begin.y; y < end.y; ++y) {
+				const T* row = volume->voxel() + (z * dimensions.y + y) * dimensions.x;
+				std::copy(row + begin.x, row + end.x, croppedVoxels);
+				croppedVoxels += croppedDimensions.x;
+			}
+		}
+		return cropped;
+	}
+
+	Volume* crop(const Volume* volume, const tgt::svec3& begin, const tgt::svec3& end) {
+		if (const VolumeUInt8* volumeUInt8 = dynamic_cast<const VolumeUInt8*>(volume))
+			return crop(volumeUInt8, begin, end);
+		if (const VolumeUInt16* volumeUInt16 = dynamic_cast<const VolumeUInt16*>(volume))
+			return crop(volumeUInt16, begin, end);
+		if (const VolumeInt16* volumeInt16 = dynamic_cast<const VolumeInt16*>(volume))
+			return crop(volumeInt16, begin, end);
+		if (const VolumeFloat* volumeFloat = dynamic_cast<const VolumeFloat*>(volume))
+			return crop(volumeFloat, begin, end);
+		return 0;
+	}
+
+	// Fills the rowOffsets of 'layout' for the voxels of 'volume'. Without a threshold, every row
+	// of the box has the same number of items and the voxels are not read
+	template <typename T>
+	void countItems(const VolumeAtomic<T>* volume, size_t nThreads, ItemLayout& layout) {
+		const tgt::svec3 boxSize = layout.end - layout.begin;
+		const size_t nRows = boxSize.y * boxSize.z;
+		std::vector<size_t> counts(nRows, boxSize.x);
+		if (layout.useThreshold) {
+			ItemCount<T> count;
+			count.volume = volume;
+			count.layout = &layout;
+			count.counts = &counts;
+			parallelFor(boxSize.z, nThreads, count);
+		}
+
+		layout.rowOffsets.resize(nRows + 1);
+		layout.rowOffsets[0] = 0;
+		for (size_t i = 0; i < nRows; ++i)
+			layout.rowOffsets[i + 1] = layout.rowOffsets[i] + counts[i];
+	}
+
+	void countItems(const Volume* volume, size_t nThreads, ItemLayout& layout) {
+		if (const VolumeUInt8* volumeUInt8 = dynamic_cast<const VolumeUInt8*>(volume))
+			countItems(volumeUInt8, nThreads, layout);
+		else if (const VolumeUInt16* volumeUInt16 = dynamic_cast<const VolumeUInt16*>(volume))
+			countItems(volumeUInt16, nThreads, layout);
+		else if (const VolumeInt16* volumeInt16 = dynamic_cast<const VolumeInt16*>(volume))
+			countItems(volumeInt16, nThreads, layout);
+		else if (const VolumeFloat* volumeFloat = dynamic_cast<const VolumeFloat*>(volume))
+			countItems(volumeFloat, nThreads, layout);
+	}
+
+	// Returns the name of the voxel type of 'volume', or 0 if the type is not supported
+	const char* voxelTypeName(const Volume* volume) {
+		if (dynamic_cast<const VolumeUInt8*>(volume))
+			return "uint8";
+		if (dynamic_cast<const VolumeUInt16*>(volume))
+			return "uint16";
+		if (dynamic_cast<const VolumeInt16*>(volume))
+			return "int16";
+		if (dynamic_cast<const VolumeFloat*>(volume))
+			return "float";
+		return 0;
+	}
+
+	// Converts a value in [0, 1] to an unsigned normalized component, as read by the raycaster
+	template <typename C>
+	C packComponent(float value) {
+		const float maximum = static_cast<float>(std::numeric_limits<C>::max());
+		return static_cast<C>(std::min(std::max(value, 0.f), 1.f) * maximum + 0.5f);
+	}
+
+	// Computes the central difference gradients of the voxels in one slab of slices per task with
+	// the zero padded stencil of the gradient magnitude feature, so that the gradient volume and
+	// the feature agree. Without 'gradients', only the largest magnitude of each slab is found;
+	// otherwise, the normalized direction is packed into the first three components as
+	// direction * 0.5 + 0.5 and the magnitude, multiplied by 'magnitudeScale', into the fourth
+	template <typename C>
+	struct GradientPacking {
+		const FeatureSource* source;
+		size_t slabThickness;
+		tgt::Vector4<C>* gradients; // The packed gradients of the volume, or 0
+		float magnitudeScale;
+		std::vector<float>* maximumMagnitudes; // The largest magnitude of each slab, if there are no 'gradients'
+		const ExtractionProgress* progress;
+
+		void operator()(size_t slab) const {
+			const tgt::svec3& dimensions = source->dimensions;
+			const size_t zBegin = slab * slabThickness;
+			const size_t zEnd = std::min(zBegin + slabThickness, dimensions.z);
+			FeatureRow row(*source);
+			float maximumMagnitude = 0.f;
+			for (size_t z = zBegin; z < zEnd && !progress->cancelled; ++z) {
+				for (size_t y = 0; y < dimensions.y; ++y) {
+					row.setRow(y, z);
+					const float* center = row.voxels(0, 0);
+					const float* previousRow = row.voxels(-1, 0);
+					const float* nextRow = row.voxels(1, 0);
+					const float* previousSlice = row.voxels(0, -1);
+					const float* nextSlice = row.voxels(0, 1);
+					tgt::Vector4<C>* packed = gradients ? gradients + row.getFirstVoxelIndex() : 0;
+					for (size_t x = 0; x < dimensions.x; ++x) {
+						const float gx = (center[x + 1] - center[x - 1]) / 2;
+						const float gy = (nextRow[x] - previousRow[x]) / 2;
+						const float gz = (nextSlice[x] - previousSlice[x]) / 2;
+						const float magnitude = static_cast<float>(std::sqrt(double(gx) * gx + double(gy) * gy + double(gz) * gz));
+						if (!packed) {
+							maximumMagnitude = std::max(maximumMagnitude, magnitude);
+							continue;
+						}
+	// A vanishing gradient has no direction and is stored as the zero vector
+						const float inverse = magnitude > 0.f ? 0.5f / magnitude : 0.f;
+						packed[x] = tgt::Vector4<C>(packComponent<C>(gx * inverse + 0.5f),
+							packComponent<C>(gy * inverse + 0.5f), packComponent<C>(gz * inverse + 0.5f),
+							packComponent<C>(magnitude * magnitudeScale));
+					}
+				}
+			}
+			if (!gradients)
+				(*maximumMagnitudes)[slab] = maximumMagnitude;
+		}
+	};
+
+	// Creates the gradient volume of 'volume' with 'C' as the type of each of the four components.
+	// The magnitudes are normalized by the largest magnitude of the volume, which takes a first
+	// pass over the volume, so that the components use their whole range. Returns 0 if 'progress'
+	// was cancelled
+	template <typename C, typename T>
+	Volume* gradientVolume(const VolumeAtomic<T>* volume, size_t nThreads, const ExtractionProgress& progress) {
+		const tgt::svec3 dimensions = volume->getDimensions();
+		const FeatureSource source = createFeatureSource(volume, 0);
+
+		const size_t nSlabs = std::max<size_t>(std::min(dimensions.z, nThreads * SLABS_PER_THREAD), 1);
+		GradientPacking<C> packing;
+		packing.source = &source;
+		packing.slabThickness = std::max<size_t>((dimensions.z + nSlabs - 1) / nSlabs, 1);
+		packing.gradients = 0;
+		packing.magnitudeScale = 0.f;
+		const size_t nTasks = (dimensions.z + packing.slabThickness - 1) / packing.slabThickness;
+		std::vector<float> maximumMagnitudes(nTasks, 0.f);
+		packing.maximumMagnitudes = &maximumMagnitudes;
+		packing.progress = &progress;
+		parallelFor(nTasks, nThreads, packing);
+		if (progress.cancelled)
+			return 0;
+
+		const float maximumMagnitude = maximumMagnitudes.empty() ? 0.f :
+			*std::max_element(maximumMagnitudes.begin(), maximumMagnitudes.end());
+		packing.magnitudeScale = maximumMagnitude > 0.f ? 1.f / maximumMagnitude : 0.f;
+		std::unique_ptr<VolumeAtomic<tgt::Vector4<C> > > gradients(new VolumeAtomic<tgt::Vector4<C> >(dimensions));
+		packing.gradients = gradients->voxel();
+		parallelFor(nTasks, nThreads, packing);
+		if (progress.cancelled)
+			return 0;
+		return gradients.release();
+	}
+
+	// Creates a Volume4xUInt8 or, for 16 'bits', a Volume4xUInt16 gradient volume of 'volume'
+	Volume* gradientVolume(const Volume* volume, int bits, size_t nThreads, const ExtractionProgress& progress) {
+		if (const VolumeUInt8* volumeUInt8 = dynamic_cast<const VolumeUInt8*>(volume))
+			return bits == 16 ? gradientVolume<uint16_t>(volumeUInt8, nThreads, progress) : gradientVolume<uint8_t>(volumeUInt8, nThreads, progress);
+		if (const VolumeUInt16* volumeUInt16 = dynamic_cast<const VolumeUInt16*>(volume))
+			return bits == 16 ? gradientVolume<uint16_t>(volumeUInt16, nThreads, progress) : gradientVolume<uint8_t>(volumeUInt16, nThreads, progress);
+		if (const VolumeInt16* volumeInt16 = dynamic_cast<const VolumeInt16*>(volume))
+			return bits == 16 ? gradientVolume<uint16_t>(volumeInt16, nThreads, progress) : gradientVolume<uint8_t>(volumeInt16, nThreads, progress);
+		if (const VolumeFloat* volumeFloat = dynamic_cast<const VolumeFloat*>(volume))
+			return bits == 16 ? gradientVolume<uint16_t>(volumeFloat, nThreads, progress) : gradientVolume<uint8_t>(volumeFloat, nThreads, progress);
+		return 0;
+	}
+
+	// The part of the previous timeframe that the next timeframe of a time series can reuse
+	struct PreviousTimeframe {
+		const Volume* volume; // The voxels the items were extracted from, or 0 if there are none
+		std::unique_ptr<Volume> ownedVolume; // Owns 'volume' if it is a cropped or downsampled copy
+		ItemLayout layout; // The layout of the items
+		const Data* data; // The items
+
+		PreviousTimeframe() : volume(0), data(0) {}
+	};
+
+	// Marks the slices of the box of 'layout' in 'volume' whose items are the same as in the
+	// previous timeframe, as none of the slices within 'halo' around them changed
+	std::vector<bool> reusableSlices(const Volume* volume, const ItemLayout& layout, size_t halo,
+		const PreviousTimeframe& previous)
+	{
+		const tgt::svec3 dimensions = volume->getDimensions();
+		std::vector<bool> reusable(dimensions.z, false);
+		if (previous.volume == 0 || previous.volume->getDimensions() != dimensions
+			|| typeid(*previous.volume) != typeid(*volume) || previous.layout.begin != layout.begin
+			|| previous.layout.end != layout.end || previous.layout.origin != layout.origin)
+		{
+			return reusable;
+		}
+
+		const size_t sliceBytes = volume->getNumBytes() / std::max<size_t>(dimensions.z, 1);
+		const char* voxels = static_cast<const char*>(volume->getData());
+		const char* previousVoxels = static_cast<const char*>(previous.volume->getData());
+		std::vector<bool> changed(dimensions.z);
+		for (size_t z = 0; z < dimensions.z; ++z)
+			changed[z] = std::memcmp(voxels + z * sliceBytes, previousVoxels + z * sliceBytes, sliceBytes) != 0;
+
+		for (size_t z = layout.begin.z; z < layout.end.z; ++z) {
+			const size_t first = z > halo ? z - halo : 0;
+			const size_t last = std::min(z + halo, dimensions.z - 1);
+			reusable[z] = std::find(changed.begin() + first, changed.begin() + last + 1, true) == changed.begin() + last + 1;
+		}
+		return reusable;
+	}
+
+}
+
+// One extraction with the parameters that were set when it was started. The worker threads
+// only touch the members of the job, so the properties and _data can change while it runs.
+// A job extracts the same features from every timeframe of the input
+struct TNMVolumeInformation::ExtractionJob {
+    std::vector<const VolumeHandleBase*> volumeHandles; // The observed handles, one per timeframe
+    std::vector<const Volume*> volumes; // The volumes the features are extracted from
+    std::vector<const Feature*> features; // The selected features
+    NeighborhoodMethod method;
+    size_t radius;
+    size_t nThreads;
+    bool useCache; // Whether the results are loaded from and stored in the cache
+    bool outOfCore; // Whether the results are written to files in the cache directory
+    size_t memoryBudget; // The memory budget in bytes of an out-of-core extraction
+    Data::ValueEncoding encoding; // How the values are stored in 'data'
+    FeatureCache cache; // A copy of the processor's cache with the same settings
+    std::vector<FeatureCacheKey> keys; // The keys of the results; the content hashes are computed by the workers
+    std::string parameters; // The feature signature without the level, see hasSameFeatures
+    int level; // The level of the resolution pyramid, the volume is downsampled by 2^level
+    tgt::svec3 roiBegin; // The first voxel of the region of interest in the original volume
+    tgt::svec3 roiEnd; // One past the last voxel of the region of interest
+    bool useThreshold; // Whether voxels below 'threshold' are skipped
+    float threshold; // The smallest intensity of the voxels that are extracted
+    size_t histogramBins; // The number of bins of the histograms, or 0 if none are computed
+    int gradientBits; // The bits per component of the gradient volumes, or 0 if none are requested
+    bool computeGradients; // Whether the gradient volumes are computed; false if they are still valid
+
+    std::vector<Data*> data; // The results, one per timeframe, which are owned by the job until they are published
+    std::vector<FeatureHistograms*> histograms; // The histograms of each result
+    std::vector<VolumeHandle*> gradients; // The gradient volume of each timeframe, if they are computed
+    ExtractionProgress progress;
+    std::atomic<size_t> nRows; // The number of rows of voxels along x that are extracted; set by the worker
+    std::vector<float> encodingErrors; // The largest encoding error of each feature in all timeframes
+    std::mutex mutex; // Serializes the accesses of the workers to 'cache' and 'encodingErrors'
+    std::atomic<bool> finished; // Set by the worker when it is done, even if it was cancelled
+    bool published; // Whether 'data' was moved to the processor
+    std::thread thread; // The worker; not started if the processor runs the job itself
+
+    ExtractionJob()
+        : gradientBits(0)
+        , computeGradients(false)
+        , nRows(0)
+        , finished(false)
+        , published(false)
+    {}
+
+    ~ExtractionJob() {
+        for (size_t i = 0; i < data.size(); ++i)
+            delete data[i];
+        for (size_t i = 0; i < histograms.size(); ++i)
+            delete histograms[i];
+        for (size_t i = 0; i < gradients.size(); ++i)
+            delete gradients[i];
+    }
+
+    // Whether 'other' computes the same features of the same volumes, possibly at another level
+    bool hasSameFeatures(const ExtractionJob& other) const {
+        return volumeHandles == other.volumeHandles && volumes == other.volumes
+            && parameters == other.parameters && outOfCore == other.outOfCore
+            && histogramBins == other.histogramBins;
+    }
+
+    // Whether 'other', the newly requested job, computes the same result, in which case this
+    // job is kept. The gradient volumes do not depend on the features, so they only matter if
+    // 'other' requests them; then this job must have computed them with the same precision
+    bool hasSameResult(const ExtractionJob& other) const {
+        return hasSameFeatures(other) && level == other.level
+            && (other.gradientBits == 0 || other.gradientBits == gradientBits);
+    }
+
+    // The layout of the items of a volume with 'dimensions', without the row offsets. 'cropEnd'
+    // receives the end of the part of the downsampled volume the items depend on, which begins
+    // at the origin of the layout
+    ItemLayout itemLayout(const tgt::svec3& dimensions, tgt::svec3& cropEnd) const;
+
+    // Loads the result of the timeframe 'frame' from the cache or extracts it with 'nThreads'
+    // threads. The items of the slices that did not change since 'previous', the timeframe
+    // before it, are copied instead of being extracted again. Afterwards, 'previous' describes
+    // this timeframe
+    void extractTimeframe(size_t frame, size_t nThreads, PreviousTimeframe& previous);
+
+    // Computes the gradient volume of the original volume of the timeframe 'frame' with
+    // 'nThreads' threads
+    void computeGradientVolume(size_t frame, size_t nThreads);
+
+    // Extracts the contiguous range of timeframes with the index 'chain' in order, so that
+    // each timeframe can reuse the one before it
+    struct TimeframeChain {
+        ExtractionJob* job;
+        size_t nChains;
+        size_t nThreads; // The number of threads for each timeframe
+
+        void operator()(size_t chain) const {
+            const size_t nFrames = job->volumes.size();
+            PreviousTimeframe previous;
+            for (size_t frame = chain * nFrames / nChains; frame < (chain + 1) * nFrames / nChains; ++frame) {
+                job->extractTimeframe(frame, nThreads, previous);
+                if (job->computeGradients)
+                    job->computeGradientVolume(frame, nThreads);
+            }
+        }
+    };
+
+    // Loads the results from the cache or extracts them; runs on the worker thread
+    static void run(ExtractionJob* job);
+};
+
+ItemLayout TNMVolumeInformation::ExtractionJob::itemLayout(const tgt::svec3& dimensions, tgt::svec3& cropEnd) const {
+	// Only the region of interest and the voxels its features depend on are processed, so the
+	// cost scales with the size of the region. The neighborhoods and stencils reach at most
+	// max(radius, 1) voxels beyond a voxel, so the features of the region are the same as in
+	// the whole volume. The region is expanded to whole blocks of the selected level
+    const size_t halo = std::max<size_t>(radius, 1);
+    ItemLayout layout;
+    layout.useThreshold = useThreshold;
+    layout.threshold = threshold;
+    layout.level = level;
+    layout.originalDimensions = dimensions;
+    for (size_t i = 0; i < 3; ++i) {
+        const size_t levelSize = downsampledSize(dimensions[i], level);
+        const size_t begin = std::min(roiBegin[i] >> level, levelSize);
+        const size_t end = std::max(std::min(downsampledSize(roiEnd[i], level), levelSize), begin);
+        layout.origin[i] = begin - std::min(begin, halo);
+        cropEnd[i] = std::min(end + halo, levelSize);
+        layout.begin[i] = begin - layout.origin[i];
+        layout.end[i] = end - layout.origin[i];
+    }
+    return layout;
+}
+
+void TNMVolumeInformation::ExtractionJob::extractTimeframe(size_t frame, size_t nThreads,
+                                                           PreviousTimeframe& previous)
+{
+    if (progress.cancelled)
+        return;
+    const Volume* originalVolume = volumes[frame];
+    FeatureCacheKey& key = keys[frame];
+    Data& result = *data[frame];
+    const tgt::svec3 originalDimensions = originalVolume->getDimensions();
+    tgt::svec3 cropEnd;
+    ItemLayout layout = itemLayout(originalDimensions, cropEnd);
+    const size_t nBoxRows = layout.end.y - layout.begin.y;
+
+	// Hashing reads the whole volume, so it is done here instead of on the calling thread, and
+	// only if the result is looked up in or added to the cache
+    if (useCache)
+        key.contentHash = hashBytes(originalVolume->getData(), originalVolume->getNumBytes());
+
+    std::vector<std::string> featureNames;
+    for (size_t i = 0; i < features.size(); ++i)
+        featureNames.push_back(features[i]->getName());
+
+	// The histograms are accumulated by every thread on its own and merged at the end. Their
+	// ranges are those of the whole volume, so that they are the same whether the items are
+	// extracted, copied, or loaded. If a copy for every thread does not fit into the budget,
+	// fewer threads accumulate the histograms after the items are extracted
+    std::vector<FeatureHistograms> threadHistograms;
+    if (histogramBins > 0) {
+        std::vector<float> minimums;
+        std::vector<float> maximums;
+        if (featureRanges(originalVolume, features, minimums, maximums)) {
+            const uint64_t histogramSize = FeatureHistograms::memoryUsage(features.size(), histogramBins);
+            const size_t nHistograms = static_cast<size_t>(std::max<uint64_t>(1,
+                std::min<uint64_t>(nThreads, HISTOGRAM_MEMORY_BUDGET / std::max<uint64_t>(histogramSize, 1))));
+            threadHistograms.resize(nHistograms);
+            for (size_t i = 0; i < nHistograms; ++i)
+                threadHistograms[i].reset(featureNames, minimums, maximums, histogramBins);
+        }
+        else
+            LWARNING("A selected feature has no bounded range, so no histograms are computed");
+    }
+
+	// Features that were computed for the same volume in an earlier session are read back from
+	// the cache instead of being recomputed. Out of core, the cache file is mapped instead
+    if (useCache) {
+        PROFILING_BLOCK("cacheload");
+        std::unique_lock<std::mutex> lock(mutex);
+        if (cache.load(key, result, outOfCore)) {
+            lock.unlock();
+            LINFO("Loaded features from " << cache.getDirectory());
+            if (!threadHistograms.empty()) {
+                accumulateHistograms(result, 0, result.size(), threadHistograms.size(), threadHistograms);
+                reduceHistograms(threadHistograms, threadHistograms.size(), *histograms[frame]);
+            }
+            result.computeStatistics(0, nThreads);
+            progress.rowsDone += nBoxRows * (layout.end.z - layout.begin.z);
+	// The voxels of a loaded timeframe are not prepared, so the next one is extracted entirely
+            previous = PreviousTimeframe();
+            return;
+        }
+    }
+
+    result.setFeatureNames(featureNames);
+
+	// Coarser levels are extracted from a downsampled copy of the volume
+    std::unique_ptr<Volume> cropped;
+    std::unique_ptr<Volume> downsampled;
+    const Volume* volume = originalVolume;
+    bool isCropped = false;
+    for (size_t i = 0; i < 3; ++i)
+        isCropped |= layout.origin[i] > 0 || cropEnd[i] < downsampledSize(originalDimensions[i], level);
+    if (isCropped) {
+        PROFILING_BLOCK("crop");
+        tgt::svec3 originalBegin;
+        tgt::svec3 originalEnd;
+        for (size_t i = 0; i < 3; ++i) {
+            originalBegin[i] = layout.origin[i] << level;
+            originalEnd[i] = std::min(cropEnd[i] << level, originalDimensions[i]);
+        }
+        cropped.reset(crop(volume, originalBegin, originalEnd));
+        volume = cropped.get();
+    }
+    if (level > 0) {
+        PROFILING_BLOCK("downsample");
+        downsampled.reset(downsample(volume, level));
+        cropped.reset();
+        volume = downsampled.get();
+    }
+    countItems(volume, nThreads, layout);
+    const size_t nItems = layout.rowOffsets.back();
+
+    std::vector<float> offsets;
+    std::vector<float> scales;
+    Data::ValueEncoding frameEncoding = encoding;
+    if (frameEncoding == Data::ValueEncodingQuantized16 && !quantization(volume, features, offsets, scales)) {
+        LWARNING("A selected feature has no bounded range for the quantization, using half precision instead");
+        frameEncoding = Data::ValueEncodingFloat16;
+    }
+    result.setValueEncoding(frameEncoding, offsets, scales);
+	// Dense items need no index column, which saves 4 bytes per item
+    if (layout.isDense())
+        result.setImplicitVoxelIndices(layout.voxelIndex(layout.begin.x, layout.begin.y, layout.begin.z));
+
+	// Out of core, the entries are written directly into a file that is mapped into memory. It
+	// becomes the cache entry if the cache is used, otherwise it is a temporary file that is
+	// deleted together with the last Data referring to it
+    bool isMapped = false;
+    if (outOfCore) {
+        std::lock_guard<std::mutex> lock(mutex);
+        isMapped = useCache ? cache.create(key, nItems, result) : cache.createTemporary(nItems, result);
+        if (!isMapped)
+            LWARNING("Could not create the output file in " << cache.getDirectory() << ", extracting in memory");
+    }
+	// Create as many data entries as there are voxels in the region
+    if (!isMapped)
+        result.resize(nItems);
+
+	// Consecutive timeframes often differ only in parts of the volume. The items of a slice only
+	// depend on the slices within the halo around it, so if none of them changed, the items are
+	// copied from the previous timeframe
+    const std::vector<bool> reusable = reusableSlices(volume, layout, std::max<size_t>(radius, 1), previous);
+    const size_t memoryBudget = isMapped ? this->memoryBudget : 0;
+    std::vector<float> frameErrors(features.size(), 0.f);
+    for (size_t slice = layout.begin.z; slice < layout.end.z && !progress.cancelled;) {
+        size_t runEnd = slice + 1;
+        while (runEnd < layout.end.z && reusable[runEnd] == reusable[slice])
+            ++runEnd;
+        if (reusable[slice]) {
+            const size_t first = layout.firstItem(slice);
+            const size_t n = layout.firstItem(runEnd) - first;
+            result.copyItems(first, *previous.data, previous.layout.firstItem(slice), n);
+            if (!threadHistograms.empty())
+                accumulateHistograms(result, first, n, threadHistograms.size(), threadHistograms);
+            result.releaseItems(first, n);
+            progress.rowsDone += nBoxRows * (runEnd - slice);
+        }
+        else {
+	// The extraction adds the items to the histograms only if every worker thread has its own
+            const bool isAccumulated = threadHistograms.size() == nThreads;
+            extractFeatures(volume, features, layout, slice, runEnd, method, radius, nThreads,
+                memoryBudget, result, progress, frameErrors, isAccumulated ? &threadHistograms : 0);
+            if (!threadHistograms.empty() && !isAccumulated && !progress.cancelled) {
+                const size_t first = layout.firstItem(slice);
+                accumulateHistograms(result, first, layout.firstItem(runEnd) - first, threadHistograms.size(), threadHistograms);
+            }
+        }
+        slice = runEnd;
+    }
+
+    if (!threadHistograms.empty() && !progress.cancelled) {
+        PROFILING_BLOCK("histograms");
+        reduceHistograms(threadHistograms, threadHistograms.size(), *histograms[frame]);
+    }
+	// The statistics are computed while the columns are still on the worker thread, so that
+	// the renderers can normalize the values without scanning them
+    if (!progress.cancelled) {
+        PROFILING_BLOCK("statistics");
+        result.computeStatistics(0, nThreads);
+    }
+
+	// An incomplete result is never stored; the file of an out-of-core extraction is unmapped
+	// before it is deleted
+    std::lock_guard<std::mutex> lock(mutex);
+    if (frameEncoding != Data::ValueEncodingFloat32) {
+        encodingErrors.resize(features.size(), 0.f);
+        for (size_t i = 0; i < features.size(); ++i)
+            encodingErrors[i] = std::max(encodingErrors[i], frameErrors[i]);
+    }
+    if (progress.cancelled) {
+        result.clear();
+        if (isMapped && useCache)
+            cache.discard(key);
+        return;
+    }
+    else if (isMapped) {
+        if (useCache && !cache.commit(key))
+            LWARNING("Could not add the features to the cache in " << cache.getDirectory());
+    }
+    else if (useCache) {
+        PROFILING_BLOCK("cachestore");
+        if (!cache.store(key, result))
+            LWARNING("Could not store the features in " << cache.getDirectory());
+    }
+
+    previous.volume = volume;
+    previous.ownedVolume.reset(downsampled ? downsampled.release() : cropped.release());
+    previous.layout = layout;
+    previous.data = &result;
+}
+
+void TNMVolumeInformation::ExtractionJob::computeGradientVolume(size_t frame, size_t nThreads) {
+    if (progress.cancelled)
+        return;
+	// The raycaster samples the gradients of the whole volume at its full resolution, so they
+	// do not depend on the region of interest, the threshold, or the level
+    PROFILING_BLOCK("gradients");
+    Volume* volume = gradientVolume(volumes[frame], gradientBits, nThreads, progress);
+    if (volume)
+        gradients[frame] = new VolumeHandle(volume);
+}
+
+void TNMVolumeInformation::ExtractionJob::run(ExtractionJob* job) {
+	// The progress counts the rows of the boxes of all timeframes
+    size_t nRows = 0;
+    for (size_t i = 0; i < job->volumes.size(); ++i) {
+        tgt::svec3 cropEnd;
+        const ItemLayout layout = job->itemLayout(job->volumes[i]->getDimensions(), cropEnd);
+        nRows += (layout.end.y - layout.begin.y) * (layout.end.z - layout.begin.z);
+    }
+    job->nRows = nRows;
+
+	// The timeframes are split into contiguous chains, one per thread, which are extracted in
+	// parallel. A single timeframe gets all threads instead
+    TimeframeChain chain;
+    chain.job = job;
+    chain.nChains = std::max<size_t>(std::min(job->volumes.size(), job->nThreads), 1);
+    chain.nThreads = std::max<size_t>(job->nThreads / chain.nChains, 1);
+    parallelFor(chain.nChains, chain.nChains, chain);
+
+	// The precision lost by a 16 bit encoding is reported, so it can be judged per feature
+    if (!job->progress.cancelled) {
+        for (size_t i = 0; i < job->encodingErrors.size(); ++i)
+            LINFO("Maximum encoding error of " << job->features[i]->getName() << ": " << job->encodingErrors[i]);
+    }
+    job->finished = true;
 }
 
 TNMVolumeInformation::TNMVolumeInformation()
     : Processor()
     , _inport(Port::INPORT, "in.volume")
+    , _timeSeriesInport(Port::INPORT, "in.timeseries")
     , _outport(Port::OUTPORT, "out.data")
-    , _data(0)
+    , _histogramOutport(Port::OUTPORT, "out.histograms")
+    , _gradientOutport(Port::OUTPORT, "out.gradients")
+    , _neighborhoodMethod("neighborhoodMethod", "Neighborhood Method")
+    , _neighborhoodRadius("neighborhoodRadius", "Neighborhood Radius", 1, 1, MAX_NEIGHBORHOOD_RADIUS)
+    , _numThreads("numThreads", "Number of Threads", hardwareThreadCount(), 1, 64)
+    , _useCache("useCache", "Use Feature Cache", true)
+    , _cacheDirectory("cacheDirectory", "Cache Directory", "Select Cache Directory",
+        FeatureCache::defaultDirectory(), "", FileDialogProperty::DIRECTORY)
+    , _cacheSizeLimit("cacheSizeLimit", "Cache Size Limit (MB)", 4096, 16, 1 << 20)
+    , _clearCache("clearCache", "Clear Cache")
+    , _outOfCore("outOfCore", "Out-of-Core Extraction", false)
+    , _memoryBudget("memoryBudget", "Memory Budget (MB)", 1024, 64, 1 << 20)
+    , _valueEncoding("valueEncoding", "Value Storage")
+    , _resolutionLevel("resolutionLevel", "Resolution Level", 0, 0, MAX_RESOLUTION_LEVEL)
+    , _refineProgressively("refineProgressively", "Refine Progressively", false)
+    , _roiFirst("roiFirst", "ROI First Voxel", tgt::ivec3(0), tgt::ivec3(0), tgt::ivec3(MAX_VOXEL_COORDINATE))
+    , _roiLast("roiLast", "ROI Last Voxel", tgt::ivec3(MAX_VOXEL_COORDINATE), tgt::ivec3(0),
+        tgt::ivec3(MAX_VOXEL_COORDINATE))
+    , _useIntensityThreshold("useIntensityThreshold", "Use Intensity Threshold", false)
+    , _intensityThreshold("intensityThreshold", "Intensity Threshold", 0.f,
+        -std::numeric_limits<float>::max(), std::numeric_limits<float>::max())
+    , _timeframe("timeframe", "Timeframe", 0, 0, 0)
+    , _histogramBins("histogramBins", "Histogram Bins", 64, 2, 1024)
+    , _gradientPrecision("gradientPrecision", "Gradient Precision")
+    , _progress("progress", "Progress", 0.f, 0.f, 1.f)
+    , _timer(0)
+    , _gradientBits(0)
 {
     addPort(_inport);
+    addPort(_timeSeriesInport);
     addPort(_outport);
+    addPort(_histogramOutport);
+    addPort(_gradientOutport);
+
+    _neighborhoodMethod.addOption("summedvolumetable", "Summed Volume Table", NeighborhoodMethodSummedVolumeTable);
+    _neighborhoodMethod.addOption("slidingwindow", "Sliding Window", NeighborhoodMethodSlidingWindow);
+    _neighborhoodMethod.addOption("bruteforce", "Brute Force", NeighborhoodMethodBruteForce);
+    addProperty(_neighborhoodMethod);
+    addProperty(_neighborhoodRadius);
+
+	// A single thread runs the extraction serially on the calling thread
+    addProperty(_numThreads);
+
+	// One checkbox per registered feature; the identifier keeps the selection stable in saved
+	// workspaces, even if features are added to the registry later on
+    const std::vector<const Feature*>& features = FeatureRegistry::getInstance().getFeatures();
+    for (size_t i = 0; i < features.size(); ++i) {
+        BoolProperty* property = new BoolProperty("feature." + features[i]->getIdentifier(),
+            features[i]->getName(), features[i]->isDefault());
+        _featureProperties.push_back(property);
+        addProperty(property);
+    }
+
+    addProperty(_useCache);
+    addProperty(_cacheDirectory);
+    addProperty(_cacheSizeLimit);
+    _clearCache.onChange(CallMemberAction<TNMVolumeInformation>(this, &TNMVolumeInformation::clearCache));
+    addProperty(_clearCache);
+
+	// The output of an out-of-core extraction is written into the feature cache directory and
+	// stays there as a cache entry, as the file is the storage of the Data
+    addProperty(_outOfCore);
+    addProperty(_memoryBudget);
+
+	// The 16 bit encodings halve the memory of the extracted data for all following processors
+    _valueEncoding.addOption("float32", "32 Bit Float", Data::ValueEncodingFloat32);
+    _valueEncoding.addOption("float16", "16 Bit Float", Data::ValueEncodingFloat16);
+    _valueEncoding.addOption("quantized16", "16 Bit Quantized", Data::ValueEncodingQuantized16);
+    addProperty(_valueEncoding);
+
+	// Level n extracts the features of the volume downsampled by 2^n along each axis, i.e. of
+	// 1/8^n of the voxels, which gives a fast overview of large volumes. Refining progressively
+	// publishes the coarsest level first and then each finer level down to the selected one
+    addProperty(_resolutionLevel);
+    addProperty(_refineProgressively);
+
+	// Only the voxels in the box between the first and the last voxel, both inclusive and
+	// clamped to the volume, whose intensity is at least the threshold become items
+    addProperty(_roiFirst);
+    addProperty(_roiLast);
+    addProperty(_useIntensityThreshold);
+    addProperty(_intensityThreshold);
+
+	// The features of all timeframes of a time series are kept, so the timeframe on the outport
+	// can be changed without extracting them again
+    addProperty(_timeframe);
+
+	// The histograms of the features are only accumulated while their outport is connected
+    addProperty(_histogramBins);
+
+	// The gradient volume is computed once per volume while its outport is connected, so that a
+	// connected TNMRaycaster reads the shading normals instead of computing them for every sample
+    _gradientPrecision.addOption("8bit", "8 Bit", 8);
+    _gradientPrecision.addOption("16bit", "16 Bit", 16);
+    addProperty(_gradientPrecision);
+
+	// The progress is only displayed; it is set while an extraction is running
+    _progress.setWidgetsEnabled(false);
+    addProperty(_progress);
 }
 
 TNMVolumeInformation::~TNMVolumeInformation() {
-    delete _data;
+    cancelJob();
+    clearData();
+    clearGradients();
+    for (size_t i = 0; i < _featureProperties.size(); ++i)
+        delete _featureProperties[i];
+	// The columns of the deleted results are not recycled by this processor anymore
+    BufferPool::instance().trim();
 }
 
-void TNMVolumeInformation::process() {
-    const VolumeHandleBase* volumeHandle = _inport.getData();
-    const Volume* baseVolume = volumeHandle->getRepresentation<Volume>();
-    const VolumeUInt16* volume = dynamic_cast<const VolumeUInt16*>(baseVolume);
-    if (volume == 0)
-        return;
-	// If we get this far, there actually is a volume to work with
+void TNMVolumeInformation::initialize() throw (tgt::Exception) {
+    Processor::initialize();
+	// Without a timer, e.g. in applications without an event loop, process() runs the
+	// extraction itself and returns once it is complete
+    _timer = VoreenApplication::app()->createTimer(&_eventHandler);
+    _eventHandler.addListenerToBack(this);
+}
 
-	// If this is the first call, we will create the Data object
-	if (_data == 0)
-        _data = new Data;
-
-	// Retrieve the size of the three dimensions of the volume
-    const tgt::svec3 dimensions = volume->getDimensions();
-	// Create as many data entries as there are voxels in the volume
-    _data->resize(dimensions.x * dimensions.y * dimensions.z);
-
-	// iX is the index running over the 'x' dimension
-	// iY is the index running over the 'y' dimension
-	// iZ is the index running over the 'z' dimension
-    for (size_t iX = 0; iX < dimensions.x; ++iX) {
-        for (size_t iY = 0; iY < dimensions.y; ++iY) {
-            for (size_t iZ = 0; iZ < dimensions.z; ++iZ) {
-                // i is a unique identifier for the voxel calculated by the following
-                // (probably one of the most important) formulas:
-                // iZ*dimensions.x*dimensions.y + iY*dimensions.x + iX;
-                const size_t i = VolumeUInt16::calcPos(volume->getDimensions(), tgt::svec3(iX, iY, iZ));
-
-                // Setting the unique identifier as the voxelIndex
-                _data->at(i).voxelIndex = i;
-                // use iX, iY, iZ, i, and the VolumeUInt16::voxel method to derive the measures here
-
-                //
-                // Intensity
-                //
-                //float intensity = -1.f;
-
-                // Retrieve the intensity using the 'VolumeUInt16's voxel method
-                float intensity = volume->voxel(i);
-
-                _data->at(i).dataValues[0] = intensity;
-
-                //
-                // Average
-                //
-                float average = 0;
-                int count =0;
-
-                for(int x=int(iX-1); x<= int(iX+1); x++)
-                {
-                    if(x<0) {
-                        x++;
-                    }
-                    if (x > int(dimensions.x)-1) {
-                        break;
-                    }
-                    for(int y=int(iY-1); y <= int(iY+1); y++)
-                    {
-                        if(y<0) {
-                            y++;
-                        }
-                        if (y > int(dimensions.y)-1) {
-                            break;
-                        }
-                            for(int z=int(iZ-1); z<=int(iZ+1); z++)
-                            {
-                                if (z > int(dimensions.z)-1) {
-                                    break;
-                                }
-                                if(z<0) {
-                                    z++;
-                                }
-                                average += volume->voxel(x,y,z);
-                                count++;
-                            }
-                    }
-                }
-                //average = average - (2 * intensity);
-                average = average/count;
-
-                //float average = -1.f;
-                // Compute the average; the voxel method accepts both a single parameter
-                // as well as three parameters
-
-                _data->at(i).dataValues[1] = average;
-
-                //
-                // Standard deviation
-                //
-                //float stdDeviation = -1.f;
-                float stdDeviation =0;
-                int dcount = -1;
-
-                for(int x=int(iX-1); x<=int(iX+1); x++)
-                {
-                    if(x<0)
-                    {
-                        x++;
-                    }
-                    if (x>int(dimensions.x)-1)
-                    {
-                        break;
-                    }
-                    for(int y=int(iY-1); y<=int(iY+1); y++)
-                    {
-                        if(y<0)
-                        {
-                            y++;
-                        }
-                        if (y>int(dimensions.y)-1)
-                        {
-                            break;
-                        }
-                        for(int z=int(iZ-1); z<=int(iZ+1); z++)
-                        {
-                            if (z>int(dimensions.z)-1)
-                            {
-                                break;
-                            }
-                            if(z<0)
-                            {
-                                z++;
-                            }
-                            stdDeviation += pow(volume->voxel(x,y,z) - average,2);
-                            dcount++;
-                        }
-                    }
-                }
+void TNMVolumeInformation::deinitialize() throw (tgt::Exception) {
+    cancelJob();
+    delete _timer;
+    _timer = 0;
+	// The buffers that finished jobs returned to the pool are freed with the network
+    BufferPool::instance().trim();
+    Processor::deinitialize();
+}
 
+bool TNMVolumeInformation::isReady() const {
+    // either a single volume or a time series has to be connected
+    if (!_inport.isReady() && !_timeSeriesInport.isReady())
+        return false;
 
-                stdDeviation = sqrt(stdDeviation/dcount);
+    if (!_outport.isReady())
+        return false;
 
-                //stdDeviation = -1.f;
-                // Compute the standard deviation
+    return true;
+}
 
+void TNMVolumeInformation::process() {
+	// The timeframes of a time series replace the single volume
+    std::vector<const VolumeHandleBase*> volumeHandles;
+    const VolumeCollection* timeSeries = _timeSeriesInport.getData();
+    if (_timeSeriesInport.isReady() && timeSeries && !timeSeries->empty()) {
+        for (size_t i = 0; i < timeSeries->size(); ++i)
+            volumeHandles.push_back(timeSeries->at(i));
+    }
+    else if (_inport.getData())
+        volumeHandles.push_back(_inport.getData());
+    if (volumeHandles.empty())
+        return;
 
-                _data->at(i).dataValues[2] = stdDeviation;
+    std::unique_ptr<ExtractionJob> job(new ExtractionJob);
+    for (size_t i = 0; i < volumeHandles.size(); ++i) {
+        const Volume* volume = volumeHandles[i]->getRepresentation<Volume>();
+        if (volume == 0)
+            return;
+        if (voxelTypeName(volume) == 0) {
+            LWARNING("Unsupported voxel type; only uint8, uint16, int16, and float volumes are supported");
+            return;
+        }
+        job->volumeHandles.push_back(volumeHandles[i]);
+        job->volumes.push_back(volume);
+    }
+	// If we get this far, there actually is a volume to work with
+    _timeframe.setMaxValue(static_cast<int>(volumeHandles.size()) - 1);
 
-                //
-                // Gradient magnitude
-                //
-                float gradientMagnitude = -1.f;
-                // Compute the gradient direction using either forward, central, or backward
-                // calculation and then take the magnitude (=length) of the vector.
-                // Hint:  tgt::vec3 is a class that can calculate the length for you
+    job->features = selectedFeatures();
+    job->method = static_cast<NeighborhoodMethod>(_neighborhoodMethod.getValue());
+    job->radius = static_cast<size_t>(_neighborhoodRadius.get());
+    job->nThreads = static_cast<size_t>(_numThreads.get());
+    job->useCache = _useCache.get();
+    job->outOfCore = _outOfCore.get();
+    job->memoryBudget = size_t(_memoryBudget.get()) << 20;
+    job->encoding = static_cast<Data::ValueEncoding>(_valueEncoding.getValue());
+    _cache.setDirectory(_cacheDirectory.get());
+    _cache.setSizeLimit(uint64_t(_cacheSizeLimit.get()) << 20);
+    job->cache = _cache;
+    for (size_t i = 0; i < job->volumes.size(); ++i)
+        job->keys.push_back(cacheKey(job->volumeHandles[i], job->volumes[i], job->features));
+    job->parameters = job->keys[0].featureSignature;
+    job->level = _resolutionLevel.get();
+    regionOfInterest(job->volumes[0]->getDimensions(), job->roiBegin, job->roiEnd);
+    job->useThreshold = _useIntensityThreshold.get();
+    job->threshold = _intensityThreshold.get();
+    job->histogramBins = _histogramOutport.isConnected() ? static_cast<size_t>(_histogramBins.get()) : 0;
+    job->gradientBits = _gradientOutport.isConnected() ? _gradientPrecision.getValue() : 0;
 
-/*
-                if (iX )
-                float gx = voxel((iX+1,iY,iZ) - voxel(iX-1,iY,iZ))/2;
-                float gy = voxel((iX,iY+1,iZ) - voxel(iX,iY-1,iZ))/2;
-                float gz = voxel((iX,iY,iZ+1) - voxel(iX,iY,iZ-1))/2;
-              */
+	// The processor is also invalidated by properties that do not change the result, and by the
+	// timer once the running extraction is finished, which is when its result is published
+    const bool isSameVolume = _job && !_inport.hasChanged() && !_timeSeriesInport.hasChanged();
+    if (isSameVolume && _job->hasSameResult(*job)) {
+        if (_job->finished && !_job->published)
+            publishJob();
+        else
+            publishTimeframe();
+        return;
+    }
 
-                float gx1;
-                float gx2;
-                float gy1;
-                float gy2;
-                float gz1;
-                float gz2;
+	// While refining progressively, each finished level is published and followed by the next
+	// finer one, until the selected level is reached
+    if (isSameVolume && _refineProgressively.get() && _job->hasSameFeatures(*job) && _job->level > job->level) {
+        if (!_job->finished)
+            return;
+        if (!_job->published)
+            publishJob();
+        job->level = _job->level - 1;
+        startJob(job.release());
+        return;
+    }
 
+	// The result of the previous volume or parameters is withdrawn, so that no stale data is
+	// shown while the new extraction runs. Another level of the same features stays visible
+	// until it is replaced
+    const bool keepOutport = isSameVolume && _job->hasSameFeatures(*job);
+    if (!keepOutport) {
+        _outport.setData(0, false);
+        _histogramOutport.setData(0, false);
+        clearData();
+    }
 
-                if(iX==int(dimensions.x-1))
-                {
-                     gx1=0;
+	// The gradient volumes only depend on the volumes, so they are kept for all other changes
+    if (!isSameVolume || _gradientSources != job->volumes) {
+        _gradientOutport.setData(0, false);
+        clearGradients();
+    }
 
-                }
-                else
-                {
-                    gx1 =volume->voxel(iX+1,iY,iZ);
-                }
+	// Refining only makes sense if the levels can be shown while the next one is extracted, and
+	// is not needed if just the level changed
+    if (_refineProgressively.get() && _timer && !keepOutport)
+        job->level = MAX_RESOLUTION_LEVEL;
+    startJob(job.release());
+}
 
-                if(iX==0)
-                {
-                     gx2=0;
+void TNMVolumeInformation::startJob(ExtractionJob* job) {
+    cancelJob();
+    _job.reset(job);
+    _progress.set(0.f);
 
-                }
-                else
-                {
-                    gx2 =volume->voxel(iX-1,iY,iZ);
-                }
-                //y
+	// Every level is a separate cache entry
+    if (job->level > 0) {
+        std::ostringstream signature;
+        signature << job->parameters << ";level=" << job->level;
+        for (size_t i = 0; i < job->keys.size(); ++i)
+            job->keys[i].featureSignature = signature.str();
+    }
+    for (size_t i = 0; i < job->volumes.size(); ++i) {
+        job->data.push_back(new Data);
+        job->histograms.push_back(new FeatureHistograms);
+    }
+	// The gradient volumes are computed by the first job that requests them, and not again for
+	// every level or feature selection
+    job->computeGradients = job->gradientBits > 0
+        && (_gradientSources != job->volumes || _gradientBits != job->gradientBits);
+    if (job->computeGradients)
+        job->gradients.assign(job->volumes.size(), 0);
 
-                if(iY==int(dimensions.y-1))
-                {
-                     gy1=0;
+	// The volumes must not be deleted while the worker reads them, see volumeHandleDelete
+    for (size_t i = 0; i < job->volumeHandles.size(); ++i)
+        job->volumeHandles[i]->addObserver(this);
+    if (_timer) {
+        job->thread = std::thread(&ExtractionJob::run, job);
+        _timer->start(PROGRESS_INTERVAL);
+    }
+    else {
+        ExtractionJob::run(job);
+        publishJob();
+    }
+}
 
-                }
-                else
-                {
-                    gy1 =volume->voxel(iX,iY+1,iZ);
-                }
+void TNMVolumeInformation::volumeHandleDelete(const VolumeHandleBase* source) {
+    if (_job && std::find(_job->volumeHandles.begin(), _job->volumeHandles.end(), source) != _job->volumeHandles.end())
+        cancelJob();
+}
 
-                if(iY==0)
-                {
-                     gy2=0;
+void TNMVolumeInformation::volumeChange(const VolumeHandleBase* source) {
+    if (_job && std::find(_job->volumeHandles.begin(), _job->volumeHandles.end(), source) != _job->volumeHandles.end())
+        cancelJob();
+}
 
-                }
-                else
-                {
-                    gy2 =volume->voxel(iX,iY-1,iZ);
-                }
-                //z
-                if(iZ==int(dimensions.z-1))
-                {
-                     gz1=0;
+void TNMVolumeInformation::timerEvent(tgt::TimeEvent*) {
+    if (!_job || _job->published) {
+        _timer->stop();
+        return;
+    }
+    const size_t nRows = _job->nRows;
+    _progress.set(nRows == 0 ? 0.f : float(_job->progress.rowsDone) / float(nRows));
+    if (_job->finished) {
+        _timer->stop();
+        invalidate();
+    }
+}
 
-                }
-                else
-                {
-                    gz1 =volume->voxel(iX,iY,iZ+1);
-                }
+void TNMVolumeInformation::cancelJob() {
+    if (!_job)
+        return;
+    _job->progress.cancelled = true;
+    if (_job->thread.joinable())
+        _job->thread.join();
+    for (size_t i = 0; i < _job->volumeHandles.size(); ++i)
+        _job->volumeHandles[i]->removeObserver(this);
+	// The finished job is kept until now only to recognize unchanged parameters
+    _job.reset();
+    if (_timer)
+        _timer->stop();
+}
 
-                if(iZ==0)
-                {
-                     gz2=0;
+void TNMVolumeInformation::publishJob() {
+    if (_job->thread.joinable())
+        _job->thread.join();
+	// The outport has to refer to the new data before the old data is deleted
+    std::vector<Data*> oldData;
+    std::vector<FeatureHistograms*> oldHistograms;
+    oldData.swap(_data);
+    oldHistograms.swap(_histograms);
+    _data.swap(_job->data);
+    _histograms.swap(_job->histograms);
+    std::vector<VolumeHandle*> oldGradients;
+    if (_job->computeGradients) {
+        oldGradients.swap(_gradients);
+        _gradients.swap(_job->gradients);
+        _gradientSources = _job->volumes;
+        _gradientBits = _job->gradientBits;
+    }
+    _job->published = true;
+    publishTimeframe();
+    for (size_t i = 0; i < oldData.size(); ++i)
+        delete oldData[i];
+    for (size_t i = 0; i < oldHistograms.size(); ++i)
+        delete oldHistograms[i];
+    for (size_t i = 0; i < oldGradients.size(); ++i)
+        delete oldGradients[i];
+    _progress.set(1.f);
 
-                }
-                else
-                {
-                    gz2 =volume->voxel(iX,iY,iZ-1);
-                }
+	// The columns of the deleted data are kept in the pool for the next extraction
+    const BufferPool::Counters counters = BufferPool::instance().getCounters();
+    if (counters.requests > 0) {
+        LINFO("Buffer pool: " << (100 * counters.hits / counters.requests) << "% of "
+            << counters.requests << " buffers reused, " << (counters.bytesRecycled >> 20) << " MB recycled, "
+            << (counters.bytesAllocated >> 20) << " MB allocated, " << (counters.bytesRetained >> 20) << " MB retained");
+    }
+}
 
+void TNMVolumeInformation::publishTimeframe() {
+    if (_data.empty())
+        return;
+    const size_t timeframe = std::min(static_cast<size_t>(std::max(_timeframe.get(), 0)), _data.size() - 1);
+    if (_outport.getData() != _data[timeframe])
+        _outport.setData(_data[timeframe], false);
+	// Histograms that were not computed are not provided
+    const FeatureHistograms* histograms = _histograms[timeframe]->getNumBins() > 0 ? _histograms[timeframe] : 0;
+    if (_histogramOutport.getData() != histograms)
+        _histogramOutport.setData(histograms, false);
+    const VolumeHandleBase* gradients = timeframe < _gradients.size() ? _gradients[timeframe] : 0;
+    if (_gradientOutport.getData() != gradients)
+        _gradientOutport.setData(gradients, false);
+}
 
-                float gx = (gx1 - gx2)/2;
-                float gy = (gy1 - gy2)/2;
-                float gz = (gz1 - gz2)/2;
+void TNMVolumeInformation::clearData() {
+    for (size_t i = 0; i < _data.size(); ++i)
+        delete _data[i];
+    _data.clear();
+    for (size_t i = 0; i < _histograms.size(); ++i)
+        delete _histograms[i];
+    _histograms.clear();
+}
 
+void TNMVolumeInformation::clearGradients() {
+    for (size_t i = 0; i < _gradients.size(); ++i)
+        delete _gradients[i];
+    _gradients.clear();
+    _gradientSources.clear();
+    _gradientBits = 0;
+}
 
-                gradientMagnitude= sqrt(pow(gx,2) + pow(gy,2) + pow(gz,2) );
+std::vector<const Feature*> TNMVolumeInformation::selectedFeatures() const {
+    const std::vector<const Feature*>& features = FeatureRegistry::getInstance().getFeatures();
+    std::vector<const Feature*> selected;
+    for (size_t i = 0; i < _featureProperties.size(); ++i) {
+        if (_featureProperties[i]->get())
+            selected.push_back(features[i]);
+    }
+    return selected;
+}
 
-                _data->at(i).dataValues[3] = gradientMagnitude;
+FeatureCacheKey TNMVolumeInformation::cacheKey(const VolumeHandleBase* volumeHandle,
+                                               const Volume* volume,
+                                               const std::vector<const Feature*>& features) const
+{
+    FeatureCacheKey key;
+    const VolumeOrigin& origin = volumeHandle->getOrigin();
+    key.url = origin.getURL();
+    key.dimensions = volume->getDimensions();
+    key.timeframe = std::atoi(origin.getSearchParameter("timeframe").c_str());
+	// The content hash catches volumes that were modified on disk or in the network. It is
+	// computed by the extraction job, as it reads the whole volume
+    key.contentHash = 0;
 
-            }
-        }
+	// Everything that influences the computed values has to be part of the signature
+    std::ostringstream signature;
+    signature << "version=" << FEATURE_DEFINITION_VERSION
+              << ";type=" << voxelTypeName(volume)
+              << ";features=";
+    for (size_t i = 0; i < features.size(); ++i)
+        signature << (i > 0 ? "," : "") << features[i]->getIdentifier() << ":" << features[i]->getVersion();
+    signature
+              << ";neighborhood=" << _neighborhoodMethod.get()
+              << ";radius=" << _neighborhoodRadius.get()
+              << ";encoding=" << _valueEncoding.get();
+	// Restrictions are only added if they exclude voxels, so that extractions of the whole
+	// volume share their entries regardless of the values of the unused properties
+    tgt::svec3 roiBegin;
+    tgt::svec3 roiEnd;
+    regionOfInterest(key.dimensions, roiBegin, roiEnd);
+    if (roiBegin != tgt::svec3(0) || roiEnd != key.dimensions) {
+        signature << ";roi=" << roiBegin.x << "," << roiBegin.y << "," << roiBegin.z
+                  << "-" << roiEnd.x << "," << roiEnd.y << "," << roiEnd.z;
     }
+    if (_useIntensityThreshold.get())
+        signature << ";threshold=" << std::setprecision(9) << _intensityThreshold.get();
+    key.featureSignature = signature.str();
+    return key;
+}
 
-	// sort the data by the voxel index for faster processing later
-	std::sort(_data->begin(), _data->end(), sortByIndex);
+void TNMVolumeInformation::regionOfInterest(const tgt::svec3& dimensions, tgt::svec3& begin,
+                                            tgt::svec3& end) const
+{
+    const tgt::ivec3 first = _roiFirst.get();
+    const tgt::ivec3 last = _roiLast.get();
+    for (size_t i = 0; i < 3; ++i) {
+        begin[i] = std::min(static_cast<size_t>(std::max(first[i], 0)), dimensions[i]);
+        end[i] = std::max(std::min(static_cast<size_t>(std::max(last[i], 0)) + 1, dimensions[i]), begin[i]);
+    }
+}
 
-	// And provide access to the data using the outport
-    _outport.setData(_data, false);
+void TNMVolumeInformation::clearCache() {
+    _cache.setDirectory(_cacheDirectory.get());
+    _cache.clear();
+    LINFO("Cleared the feature cache in " << _cache.getDirectory());
 }
 
 } // namespace
@@ -0,0 +1,31 @@
+#ifndef TNM_TEST_TGT_VECTOR_H
+#define TNM_TEST_TGT_VECTOR_H
+
+#include <cstddef>
+
+// The part of tgt::Vector3 that the feature kernels use, so that the kernels can be tested
+// without a Voreen build
+namespace tgt {
+
+template <typename T>
+struct Vector3 {
+    T x;
+    T y;
+    T z;
+
+    Vector3() : x(0), y(0), z(0) {}
+    explicit Vector3(T v) : x(v), y(v), z(v) {}
+    Vector3(T x, T y, T z) : x(x), y(y), z(z) {}
+
+    T& operator[](size_t i) { return (&x)[i]; }
+    const T& operator[](size_t i) const { return (&x)[i]; }
+
+    bool operator==(const Vector3& other) const { return x == other.x && y == other.y && z == other.z; }
+    bool operator!=(const Vector3& other) const { return !(*this == other); }
+};
+
+typedef Vector3<size_t> svec3;
+
+} // namespace tgt
+
+#endif // TNM_TEST_TGT_VECTOR_H
@@ -0,0 +1,48 @@
+#ifndef TNM_TEST_VOLUMEATOMIC_H
+#define TNM_TEST_VOLUMEATOMIC_H
+
+#include "tgt/vector.h"
+
+#include <vector>
+#include <stdint.h>
+
+// The part of voreen::VolumeAtomic that the feature kernels use: a dense volume of voxels of
+// type T, stored with x fastest, then y, then z
+namespace voreen {
+
+template <typename T>
+class VolumeAtomic {
+public:
+    explicit VolumeAtomic(const tgt::svec3& dimensions)
+        : _dimensions(dimensions)
+        , _voxels(dimensions.x * dimensions.y * dimensions.z)
+    {}
+
+    const tgt::svec3& getDimensions() const { return _dimensions; }
+
+    T* voxel() { return _voxels.empty() ? 0 : &_voxels[0]; }
+    const T* voxel() const { return _voxels.empty() ? 0 : &_voxels[0]; }
+
+    T& voxel(size_t i) { return _voxels[i]; }
+    const T& voxel(size_t i) const { return _voxels[i]; }
+
+    T& voxel(size_t x, size_t y, size_t z) { return _voxels[calcPos(_dimensions, tgt::svec3(x, y, z))]; }
+    const T& voxel(size_t x, size_t y, size_t z) const { return _voxels[calcPos(_dimensions, tgt::svec3(x, y, z))]; }
+
+    static size_t calcPos(const tgt::svec3& dimensions, const tgt::svec3& position) {
+        return (position.z * dimensions.y + position.y) * dimensions.x + position.x;
+    }
+
+private:
+    tgt::svec3 _dimensions;
+    std::vector<T> _voxels;
+};
+
+typedef VolumeAtomic<uint8_t> VolumeUInt8;
+typedef VolumeAtomic<uint16_t> VolumeUInt16;
+typedef VolumeAtomic<int16_t> VolumeInt16;
+typedef VolumeAtomic<float> VolumeFloat;
+
+} // namespace voreen
+
+#endif // TNM_TEST_VOLUMEATOMIC_H
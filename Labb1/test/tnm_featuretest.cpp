@@ -0,0 +1,133 @@
+// Checks the feature extraction of TNMVolumeInformation for every supported voxel type. Each
+// volume is extracted with all registered features and every neighborhood method the way
+// extractFeatures does it, including the bricks with their own tables, and the results are
+// compared against NeighborhoodMethodBruteForce, which visits every voxel of each neighborhood.
+// The average and standard deviation of the summed volume table are also checked separately
+// for all radii.
+// The kernels only depend on VolumeAtomic and tgt::Vector3, which are replaced by the minimal
+// versions in test/include, so the test runs without a Voreen build; see the Makefile
+#include "tnm_testextraction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace voreen;
+
+namespace {
+	// The dimensions of the test volumes. None of them is a multiple of the vector width of the
+	// row kernels, and all are larger than the box of the largest radius, so every volume has
+	// interior rows as well as clipped boundaries
+	const tgt::svec3 DIMENSIONS(37, 29, 23);
+
+	// A value differs from the reference if the difference exceeds this fraction of the
+	// reference, or of 1 for values below 1
+	const float TOLERANCE = 1e-4f;
+
+	// Counts the values that differ from the reference and reports the first ones
+	size_t compare(const std::string& test, const std::vector<const Feature*>& features,
+		const std::vector<float>& values, const std::vector<float>& reference)
+	{
+		size_t nMismatches = 0;
+		for (size_t i = 0; i < values.size(); ++i) {
+			const float expected = reference[i];
+			if (std::fabs(values[i] - expected) <= TOLERANCE * std::max(std::fabs(expected), 1.f))
+				continue;
+			if (nMismatches < 5) {
+				const size_t nVoxels = values.size() / features.size();
+				std::printf("%s: %s of voxel %lu is %.9g instead of %.9g\n", test.c_str(),
+					features[i / nVoxels]->getName().c_str(), (unsigned long)(i % nVoxels), values[i], expected);
+			}
+			++nMismatches;
+		}
+		return nMismatches;
+	}
+
+	// Extracts all registered features from 'volume' with each neighborhood method and radii 1
+	// and 3, once for the whole volume and once in bricks of four slices, and compares them with
+	// the brute-force reference
+	template <typename T>
+	size_t testVoxelType(const std::string& typeName, const VolumeAtomic<T>& volume) {
+		const std::vector<const Feature*>& features = FeatureRegistry::getInstance().getFeatures();
+		const NeighborhoodMethod methods[] = { NeighborhoodMethodSummedVolumeTable, NeighborhoodMethodSlidingWindow };
+		const size_t radii[] = { 1, 3 };
+		const size_t brickSlices[] = { DIMENSIONS.z, 4 };
+
+		size_t nFailures = 0;
+		std::vector<float> reference;
+		std::vector<float> values;
+		for (size_t r = 0; r < 2; ++r) {
+			computeFeatures(&volume, features, NeighborhoodMethodBruteForce, radii[r], DIMENSIONS.z, reference);
+			for (size_t m = 0; m < 2; ++m) {
+				for (size_t b = 0; b < 2; ++b) {
+					char test[128];
+					std::sprintf(test, "%s, %s, radius %lu, bricks of %lu slices", typeName.c_str(),
+						methodName(methods[m]), (unsigned long)radii[r], (unsigned long)brickSlices[b]);
+					computeFeatures(&volume, features, methods[m], radii[r], brickSlices[b], values);
+					if (compare(test, features, values, reference) > 0)
+						++nFailures;
+				}
+			}
+		}
+		std::printf("%s: %s\n", typeName.c_str(), nFailures == 0 ? "passed" : "FAILED");
+		return nFailures;
+	}
+
+	// Compares the average and standard deviation of the summed volume table with the
+	// brute-force reference for every radius the processor offers, once for the whole volume and
+	// once in bricks of three slices, which are thinner than the halo of the larger radii.
+	// Floating point volumes have no summed volume table and are computed with the sliding window
+	// instead, like in extractFeatures
+	template <typename T>
+	size_t testSummedVolumeTable(const std::string& typeName, const VolumeAtomic<T>& volume) {
+		const FeatureRegistry& registry = FeatureRegistry::getInstance();
+		std::vector<const Feature*> features;
+		features.push_back(registry.getFeature("average"));
+		features.push_back(registry.getFeature("stddeviation"));
+		const size_t brickSlices[] = { DIMENSIONS.z, 3 };
+
+		size_t nFailures = 0;
+		std::vector<float> reference;
+		std::vector<float> values;
+		for (size_t radius = 1; radius <= 5; ++radius) {
+			computeFeatures(&volume, features, NeighborhoodMethodBruteForce, radius, DIMENSIONS.z, reference);
+			for (size_t b = 0; b < 2; ++b) {
+				char test[128];
+				std::sprintf(test, "%s, summed volume table, radius %lu, bricks of %lu slices", typeName.c_str(),
+					(unsigned long)radius, (unsigned long)brickSlices[b]);
+				computeFeatures(&volume, features, NeighborhoodMethodSummedVolumeTable, radius, brickSlices[b], values);
+				if (compare(test, features, values, reference) > 0)
+					++nFailures;
+			}
+		}
+		std::printf("%s, summed volume table: %s\n", typeName.c_str(), nFailures == 0 ? "passed" : "FAILED");
+		return nFailures;
+	}
+}
+
+int main() {
+	std::printf("Row kernels: %s\n", rowKernels().name);
+
+	VolumeUInt8 volumeUInt8(DIMENSIONS);
+	fillTestVolume(volumeUInt8, 0.0, 255.0, 1);
+	VolumeUInt16 volumeUInt16(DIMENSIONS);
+	fillTestVolume(volumeUInt16, 0.0, 65535.0, 2);
+	VolumeInt16 volumeInt16(DIMENSIONS);
+	fillTestVolume(volumeInt16, -32768.0, 32767.0, 3);
+	VolumeFloat volumeFloat(DIMENSIONS);
+	fillTestVolume(volumeFloat, -1000.0, 1000.0, 4);
+
+	size_t nFailures = 0;
+	nFailures += testVoxelType("uint8", volumeUInt8);
+	nFailures += testVoxelType("uint16", volumeUInt16);
+	nFailures += testVoxelType("int16", volumeInt16);
+	nFailures += testVoxelType("float", volumeFloat);
+
+	nFailures += testSummedVolumeTable("uint8", volumeUInt8);
+	nFailures += testSummedVolumeTable("uint16", volumeUInt16);
+	nFailures += testSummedVolumeTable("int16", volumeInt16);
+	nFailures += testSummedVolumeTable("float", volumeFloat);
+	return nFailures == 0 ? 0 : 1;
+}
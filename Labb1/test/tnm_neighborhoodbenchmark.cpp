@@ -0,0 +1,135 @@
+// Compares the bytes and the time per voxel of the methods for the neighborhood average and
+// standard deviation on a synthetic 16 bit volume, on a single thread:
+//  - the two passes of the original extraction, which read the box once for the average and
+//    once more for the squared deviations,
+//  - the brute-force method, which reads the box once with Welford's update,
+//  - the sliding window and the summed volume table, whose cost does not depend on the radius.
+// The bytes are the loads and stores of voxels and table entries that each method issues per
+// voxel, including building its tables. They are counted from the algorithms, not measured, and
+// most of them are served by the caches; they show how the traffic grows with the radius.
+//
+//   tnm_neighborhoodbenchmark [size]    the edge length of the volume, 128 by default
+#include "tnm_testextraction.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace voreen;
+
+namespace {
+	// The radii that are compared; the brute-force methods get expensive quickly beyond them
+	const size_t RADII[] = { 1, 2, 3 };
+
+	// The original computation: the average of the clipped box, then the squared deviations from
+	// it in a second pass over the same box
+	void twoPassNeighborhood(const void* volume, size_t iX, size_t iY, size_t iZ, size_t radius,
+		float& average, float& stdDeviation)
+	{
+		const VolumeUInt16* typedVolume = static_cast<const VolumeUInt16*>(volume);
+		const tgt::svec3& dimensions = typedVolume->getDimensions();
+		const uint16_t* voxels = typedVolume->voxel();
+		const size_t xBegin = iX > radius ? iX - radius : 0;
+		const size_t xEnd = std::min(iX + radius + 1, dimensions.x);
+		const size_t yBegin = iY > radius ? iY - radius : 0;
+		const size_t yEnd = std::min(iY + radius + 1, dimensions.y);
+		const size_t zBegin = iZ > radius ? iZ - radius : 0;
+		const size_t zEnd = std::min(iZ + radius + 1, dimensions.z);
+
+		double sum = 0.0;
+		size_t count = 0;
+		for (size_t z = zBegin; z < zEnd; ++z) {
+			for (size_t y = yBegin; y < yEnd; ++y) {
+				const uint16_t* row = voxels + (z * dimensions.y + y) * dimensions.x;
+				for (size_t x = xBegin; x < xEnd; ++x)
+					sum += row[x];
+				count += xEnd - xBegin;
+			}
+		}
+		const double mean = sum / double(count);
+
+		double squaredDeviations = 0.0;
+		for (size_t z = zBegin; z < zEnd; ++z) {
+			for (size_t y = yBegin; y < yEnd; ++y) {
+				const uint16_t* row = voxels + (z * dimensions.y + y) * dimensions.x;
+				for (size_t x = xBegin; x < xEnd; ++x)
+					squaredDeviations += std::pow(row[x] - mean, 2);
+			}
+		}
+		average = static_cast<float>(mean);
+		stdDeviation = (count > 1) ? static_cast<float>(std::sqrt(squaredDeviations / double(count - 1))) : 0.f;
+	}
+
+	// The sum of the lengths of the windows of 'radius' around every position of a line of
+	// 'size' voxels, clipped against the line
+	double windowLengths(size_t size, size_t radius) {
+		double sum = 0.0;
+		for (size_t i = 0; i < size; ++i)
+			sum += double(std::min(i + radius + 1, size) - (i > radius ? i - radius : 0));
+		return sum;
+	}
+
+	// The bytes of voxels the brute-force methods read per voxel in 'nPasses' passes over the box
+	double bruteForceBytes(const tgt::svec3& dimensions, size_t radius, size_t nPasses) {
+		const double nVoxels = double(dimensions.x) * dimensions.y * dimensions.z;
+		return nPasses * sizeof(uint16_t) * windowLengths(dimensions.x, radius) *
+			windowLengths(dimensions.y, radius) * windowLengths(dimensions.z, radius) / nVoxels;
+	}
+
+	// The sliding window reads each voxel twice, for the mean and for the initial tables, and
+	// stores two doubles. Each of the three passes over each of the two tables loads the current,
+	// the entering, and the leaving element and stores the current and the saved element. A
+	// query loads two doubles
+	double slidingWindowBytes() {
+		return 2 * sizeof(uint16_t) + 2 * sizeof(double) + 2 * 3 * 5 * sizeof(double) + 2 * sizeof(double);
+	}
+
+	// The summed volume table reads each voxel once and clears two entries. Each entry of the two
+	// tables loads three previous entries and is stored. A query loads the eight corners of the
+	// box from both tables
+	double summedVolumeTableBytes() {
+		return sizeof(uint16_t) + 2 * sizeof(uint64_t) + 2 * 4 * sizeof(uint64_t) + 2 * 8 * sizeof(uint64_t);
+	}
+
+	void report(const char* name, size_t radius, double tableBytes, double bytes, double time, size_t nVoxels) {
+		std::printf("  %-22s %6lu %10.1f %12.1f %10.2f\n", name, (unsigned long)radius, tableBytes, bytes,
+			time * 1e9 / double(nVoxels));
+	}
+}
+
+int main(int argc, char** argv) {
+	const size_t size = (argc > 1) ? size_t(std::atoi(argv[1])) : 128;
+	const tgt::svec3 dimensions(size, size, size);
+	const size_t nVoxels = size * size * size;
+	VolumeUInt16 volume(dimensions);
+	fillTestVolume(volume, 0.0, 4095.0, 1);
+
+	const FeatureRegistry& registry = FeatureRegistry::getInstance();
+	std::vector<const Feature*> features;
+	features.push_back(registry.getFeature("average"));
+	features.push_back(registry.getFeature("stddeviation"));
+
+	std::printf("Row kernels: %s, %lu^3 voxels\n", rowKernels().name, (unsigned long)size);
+	std::printf("  %-22s %6s %10s %12s %10s\n", "method", "radius", "table B/vx", "accessed B/vx", "ns/voxel");
+	// The two passes replace the reference of the brute-force method
+	const NeighborhoodMethod methods[] = { NeighborhoodMethodBruteForce, NeighborhoodMethodBruteForce,
+		NeighborhoodMethodSlidingWindow, NeighborhoodMethodSummedVolumeTable };
+	const char* names[] = { "two passes", "brute force (Welford)", "sliding window", "summed volume table" };
+	std::vector<float> values;
+	for (size_t r = 0; r < sizeof(RADII) / sizeof(RADII[0]); ++r) {
+		const size_t radius = RADII[r];
+		const double bytes[] = { bruteForceBytes(dimensions, radius, 2), bruteForceBytes(dimensions, radius, 1),
+			slidingWindowBytes(), summedVolumeTableBytes() };
+		const double tableBytes[] = { 0.0, 0.0, double(SlidingWindowStatistics::memoryUsage(dimensions, size)) / nVoxels,
+			double(SummedVolumeTable::memoryUsage(dimensions, size)) / nVoxels };
+		for (size_t m = 0; m < 4; ++m) {
+			const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			computeFeatures(&volume, features, methods[m], radius, size, values, m == 0 ? &twoPassNeighborhood : 0);
+			const double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			report(names[m], radius, tableBytes[m], bytes[m], time, nVoxels);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,134 @@
+#ifndef TNM_TEST_EXTRACTION_H
+#define TNM_TEST_EXTRACTION_H
+
+#include "modules/tnm093/include/tnm_features.h"
+#include "modules/tnm093/include/tnm_slidingwindow.h"
+#include "modules/tnm093/include/tnm_summedvolumetable.h"
+
+#include <algorithm>
+#include <vector>
+
+// The feature extraction of TNMVolumeInformation without the processor, shared by the tests and
+// the benchmarks. The volume is swept the way extractFeatures and extractSlab do it, on a
+// single thread: in bricks of slices with their own tables, and within a brick in tiles of rows
+// that are swept through all of its slices
+namespace voreen {
+
+// The methods of TNMVolumeInformation::NeighborhoodMethod
+enum NeighborhoodMethod {
+    NeighborhoodMethodSummedVolumeTable,
+    NeighborhoodMethodSlidingWindow,
+    NeighborhoodMethodBruteForce
+};
+
+// The number of rows along y that are swept through the slices of a brick together, see
+// TILE_ROWS in tnm_volumeinformation.cpp
+const size_t TEST_TILE_ROWS = 16;
+
+inline const char* methodName(NeighborhoodMethod method) {
+    switch (method) {
+        case NeighborhoodMethodSummedVolumeTable:
+            return "summed volume table";
+        case NeighborhoodMethodSlidingWindow:
+            return "sliding window";
+        default:
+            return "brute force";
+    }
+}
+
+// A simple linear congruential generator, so that the volumes are the same on every platform
+class TestRandom {
+public:
+    explicit TestRandom(uint32_t seed) : _state(seed) {}
+
+    // Returns a uniformly distributed value in [0, 1)
+    double next() {
+        _state = _state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return double(_state >> 11) / double(1ULL << 53);
+    }
+
+private:
+    uint64_t _state;
+};
+
+// Fills a volume with random voxels in [minimum, maximum]. Every fourth slice is a smooth
+// ramp instead, so that the neighborhoods also have small deviations relative to their average
+template <typename T>
+void fillTestVolume(VolumeAtomic<T>& volume, double minimum, double maximum, uint32_t seed) {
+    TestRandom random(seed);
+    const tgt::svec3& dimensions = volume.getDimensions();
+    T* voxels = volume.voxel();
+    for (size_t z = 0; z < dimensions.z; ++z) {
+        for (size_t y = 0; y < dimensions.y; ++y) {
+            for (size_t x = 0; x < dimensions.x; ++x) {
+                const double t = (z % 4 == 3) ? double(x + y) / double(dimensions.x + dimensions.y) : random.next();
+                const double value = std::min(minimum + t * (maximum - minimum + 1.0), maximum);
+                voxels[VolumeAtomic<T>::calcPos(dimensions, tgt::svec3(x, y, z))] = static_cast<T>(value);
+            }
+        }
+    }
+}
+
+// The summed volume table needs exact integer sums, so extractFeatures uses the sliding window
+// for floating point volumes instead
+template <typename T>
+bool buildTestSummedVolumeTable(const VolumeAtomic<T>* volume, size_t firstSlice, size_t endSlice,
+    SummedVolumeTable& summedVolumeTable)
+{
+    summedVolumeTable.build(volume, firstSlice, endSlice);
+    return true;
+}
+
+inline bool buildTestSummedVolumeTable(const VolumeFloat*, size_t, size_t, SummedVolumeTable&) {
+    return false;
+}
+
+// Computes 'features' for every voxel of 'volume' into 'values', which holds one column of
+// values per feature, like Data. The volume is processed in bricks of 'brickSlices' slices, each
+// with its own tables that include the 'radius' slices on both sides. If 'bruteForceNeighborhood'
+// is not 0, it replaces the reference of the brute-force method
+template <typename T>
+void computeFeatures(const VolumeAtomic<T>* volume, const std::vector<const Feature*>& features,
+    NeighborhoodMethod method, size_t radius, size_t brickSlices, std::vector<float>& values,
+    void (*bruteForceNeighborhood)(const void*, size_t, size_t, size_t, size_t, float&, float&) = 0)
+{
+    const tgt::svec3& dimensions = volume->getDimensions();
+    const size_t nVoxels = dimensions.x * dimensions.y * dimensions.z;
+    values.assign(nVoxels * features.size(), 0.f);
+
+    FeatureSource source = createFeatureSource(volume, radius);
+    if (bruteForceNeighborhood)
+        source.bruteForceNeighborhood = bruteForceNeighborhood;
+    FeatureRow row(source);
+    SummedVolumeTable summedVolumeTable;
+    SlidingWindowStatistics slidingWindow;
+    for (size_t brickBegin = 0; brickBegin < dimensions.z; brickBegin += brickSlices) {
+        const size_t brickEnd = std::min(brickBegin + brickSlices, dimensions.z);
+        const size_t tableBegin = brickBegin > radius ? brickBegin - radius : 0;
+        const size_t tableEnd = std::min(brickEnd + radius, dimensions.z);
+        if (method == NeighborhoodMethodSummedVolumeTable &&
+            buildTestSummedVolumeTable(volume, tableBegin, tableEnd, summedVolumeTable))
+        {
+            source.summedVolumeTable = &summedVolumeTable;
+        }
+        else if (method != NeighborhoodMethodBruteForce) {
+            slidingWindow.build(volume, radius, tableBegin, tableEnd);
+            source.slidingWindow = &slidingWindow;
+        }
+
+        for (size_t yTile = 0; yTile < dimensions.y; yTile += TEST_TILE_ROWS) {
+            const size_t yTileEnd = std::min(yTile + TEST_TILE_ROWS, dimensions.y);
+            for (size_t z = brickBegin; z < brickEnd; ++z) {
+                for (size_t y = yTile; y < yTileEnd; ++y) {
+                    row.setRow(y, z);
+                    for (size_t f = 0; f < features.size(); ++f)
+                        features[f]->computeRow(row, &values[f * nVoxels + row.getFirstVoxelIndex()], 1);
+                }
+            }
+        }
+    }
+}
+
+} // namespace voreen
+
+#endif // TNM_TEST_EXTRACTION_H
@@ -0,0 +1,140 @@
+// Compares the extraction loop of the original TNMVolumeInformation with the current one on
+// synthetic 16 bit volumes, on a single thread. The original loop runs over x outermost and z
+// innermost, so consecutive voxels are dimensions.x * dimensions.y voxels apart, and writes the
+// items in the same scattered order. The current loop visits the voxels in memory order, in
+// tiles of rows, and writes each feature into its own column; it is measured with the
+// brute-force neighborhood, which isolates the traversal order, and with the summed volume table.
+//
+//   tnm_traversalbenchmark [size...]    the edge lengths of the volumes, 256 and 512 by default
+#include "tnm_testextraction.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace voreen;
+
+namespace {
+	// The number of bytes the tables of the summed volume table may occupy, see
+	// TABLE_MEMORY_BUDGET in tnm_volumeinformation.cpp
+	const size_t TABLE_MEMORY_BUDGET = size_t(512) << 20;
+
+	// The item of the original Data, which stored the measures of each voxel together
+	struct VoxelDataItem {
+		unsigned int voxelIndex;
+		float dataValues[4];
+	};
+
+	// The extraction of the original TNMVolumeInformation::process: the intensity, the average and
+	// standard deviation of the 3x3x3 box, which is read twice, and the central difference gradient
+	// magnitude, with every voxel read through VolumeAtomic::voxel(x, y, z)
+	void originalExtraction(const VolumeUInt16& volume, std::vector<VoxelDataItem>& data) {
+		const tgt::svec3 dimensions = volume.getDimensions();
+		data.resize(dimensions.x * dimensions.y * dimensions.z);
+		for (size_t iX = 0; iX < dimensions.x; ++iX) {
+			for (size_t iY = 0; iY < dimensions.y; ++iY) {
+				for (size_t iZ = 0; iZ < dimensions.z; ++iZ) {
+					const size_t i = VolumeUInt16::calcPos(dimensions, tgt::svec3(iX, iY, iZ));
+					data[i].voxelIndex = static_cast<unsigned int>(i);
+					data[i].dataValues[0] = volume.voxel(i);
+
+					const size_t xBegin = iX > 0 ? iX - 1 : 0;
+					const size_t xEnd = std::min(iX + 2, dimensions.x);
+					const size_t yBegin = iY > 0 ? iY - 1 : 0;
+					const size_t yEnd = std::min(iY + 2, dimensions.y);
+					const size_t zBegin = iZ > 0 ? iZ - 1 : 0;
+					const size_t zEnd = std::min(iZ + 2, dimensions.z);
+
+					float average = 0.f;
+					int count = 0;
+					for (size_t x = xBegin; x < xEnd; ++x) {
+						for (size_t y = yBegin; y < yEnd; ++y) {
+							for (size_t z = zBegin; z < zEnd; ++z) {
+								average += volume.voxel(x, y, z);
+								++count;
+							}
+						}
+					}
+					average /= count;
+					data[i].dataValues[1] = average;
+
+					float stdDeviation = 0.f;
+					for (size_t x = xBegin; x < xEnd; ++x) {
+						for (size_t y = yBegin; y < yEnd; ++y) {
+							for (size_t z = zBegin; z < zEnd; ++z)
+								stdDeviation += std::pow(volume.voxel(x, y, z) - average, 2);
+						}
+					}
+					data[i].dataValues[2] = std::sqrt(stdDeviation / (count - 1));
+
+					const float gx1 = (iX + 1 < dimensions.x) ? volume.voxel(iX + 1, iY, iZ) : 0.f;
+					const float gx2 = (iX > 0) ? volume.voxel(iX - 1, iY, iZ) : 0.f;
+					const float gy1 = (iY + 1 < dimensions.y) ? volume.voxel(iX, iY + 1, iZ) : 0.f;
+					const float gy2 = (iY > 0) ? volume.voxel(iX, iY - 1, iZ) : 0.f;
+					const float gz1 = (iZ + 1 < dimensions.z) ? volume.voxel(iX, iY, iZ + 1) : 0.f;
+					const float gz2 = (iZ > 0) ? volume.voxel(iX, iY, iZ - 1) : 0.f;
+					const float gx = (gx1 - gx2) / 2;
+					const float gy = (gy1 - gy2) / 2;
+					const float gz = (gz1 - gz2) / 2;
+					data[i].dataValues[3] = std::sqrt(std::pow(gx, 2) + std::pow(gy, 2) + std::pow(gz, 2));
+				}
+			}
+		}
+	}
+
+	double seconds(std::chrono::steady_clock::time_point begin) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	}
+
+	void report(const char* name, size_t nVoxels, double time) {
+		std::printf("  %-36s %8.2f s %8.2f ns/voxel\n", name, time, time * 1e9 / double(nVoxels));
+	}
+
+	void benchmark(size_t size) {
+		const tgt::svec3 dimensions(size, size, size);
+		const size_t nVoxels = size * size * size;
+		VolumeUInt16 volume(dimensions);
+		fillTestVolume(volume, 0.0, 4095.0, 1);
+		std::printf("%lu^3 voxels\n", (unsigned long)size);
+
+		{
+			std::vector<VoxelDataItem> data;
+			const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			originalExtraction(volume, data);
+			report("original, x outermost", nVoxels, seconds(begin));
+		}
+
+	// The four measures of the original extraction
+		std::vector<const Feature*> features;
+		const std::vector<const Feature*>& registered = FeatureRegistry::getInstance().getFeatures();
+		for (size_t i = 0; i < registered.size(); ++i) {
+			if (registered[i]->isDefault())
+				features.push_back(registered[i]);
+		}
+
+		const size_t bytesPerTableSlice = SummedVolumeTable::memoryUsage(dimensions, 1);
+		const size_t brickSlices = std::max<size_t>(std::min(
+			(TABLE_MEMORY_BUDGET - 2 * bytesPerTableSlice) / bytesPerTableSlice, size), 1);
+		const NeighborhoodMethod methods[] = { NeighborhoodMethodBruteForce, NeighborhoodMethodSummedVolumeTable };
+		const char* names[] = { "memory order, brute force", "memory order, summed volume table" };
+		for (size_t m = 0; m < 2; ++m) {
+			std::vector<float> values;
+			const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			computeFeatures(&volume, features, methods[m], 1, brickSlices, values);
+			report(names[m], nVoxels, seconds(begin));
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	std::printf("Row kernels: %s\n", rowKernels().name);
+	if (argc < 2) {
+		benchmark(256);
+		benchmark(512);
+	}
+	for (int i = 1; i < argc; ++i)
+		benchmark(size_t(std::atoi(argv[i])));
+	return 0;
+}
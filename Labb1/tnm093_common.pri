@@ -4,3 +4,9 @@ DEFINES += VRN_MODULE_TNM093
 VRN_MODULE_CLASSES += TNM093Module
 VRN_MODULE_CLASS_HEADERS += tnm093/tnm093module.h
 VRN_MODULE_CLASS_SOURCES += tnm093/tnm093module.cpp
+
+# the feature extraction uses std::thread for its worker pool
+unix {
+    QMAKE_CXXFLAGS += -std=c++0x -pthread
+    LIBS += -lpthread
+}
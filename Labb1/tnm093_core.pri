@@ -1,16 +1,36 @@
 SOURCES += \
     $${VRN_MODULE_DIR}/tnm093/src/indexproperty.cpp \
+    $${VRN_MODULE_DIR}/tnm093/src/tnm_bufferpool.cpp \
+    $${VRN_MODULE_DIR}/tnm093/src/tnm_common.cpp \
     $${VRN_MODULE_DIR}/tnm093/src/tnm_datareduction.cpp \
+    $${VRN_MODULE_DIR}/tnm093/src/tnm_featurecache.cpp \
+    $${VRN_MODULE_DIR}/tnm093/src/tnm_features.cpp \
+    $${VRN_MODULE_DIR}/tnm093/src/tnm_histograms.cpp \
+    $${VRN_MODULE_DIR}/tnm093/src/tnm_indexset.cpp \
+    $${VRN_MODULE_DIR}/tnm093/src/tnm_mappedfile.cpp \
     $${VRN_MODULE_DIR}/tnm093/src/tnm_parallelcoordinates.cpp \
     $${VRN_MODULE_DIR}/tnm093/src/tnm_raycaster.cpp \
+    $${VRN_MODULE_DIR}/tnm093/src/tnm_rowkernels.cpp \
     $${VRN_MODULE_DIR}/tnm093/src/tnm_scatterplot.cpp \
+    $${VRN_MODULE_DIR}/tnm093/src/tnm_slidingwindow.cpp \
+    $${VRN_MODULE_DIR}/tnm093/src/tnm_summedvolumetable.cpp \
     $${VRN_MODULE_DIR}/tnm093/src/tnm_volumeinformation.cpp
 
 HEADERS += \
     $${VRN_MODULE_DIR}/tnm093/include/indexproperty.h \
+    $${VRN_MODULE_DIR}/tnm093/include/tnm_bufferpool.h \
     $${VRN_MODULE_DIR}/tnm093/include/tnm_datareduction.h \
     $${VRN_MODULE_DIR}/tnm093/include/tnm_common.h \
+    $${VRN_MODULE_DIR}/tnm093/include/tnm_featurecache.h \
+    $${VRN_MODULE_DIR}/tnm093/include/tnm_features.h \
+    $${VRN_MODULE_DIR}/tnm093/include/tnm_histograms.h \
+    $${VRN_MODULE_DIR}/tnm093/include/tnm_indexset.h \
+    $${VRN_MODULE_DIR}/tnm093/include/tnm_mappedfile.h \
+    $${VRN_MODULE_DIR}/tnm093/include/tnm_parallel.h \
     $${VRN_MODULE_DIR}/tnm093/include/tnm_parallelcoordinates.h \
     $${VRN_MODULE_DIR}/tnm093/include/tnm_raycaster.h \
+    $${VRN_MODULE_DIR}/tnm093/include/tnm_rowkernels.h \
     $${VRN_MODULE_DIR}/tnm093/include/tnm_scatter.h \
+    $${VRN_MODULE_DIR}/tnm093/include/tnm_slidingwindow.h \
+    $${VRN_MODULE_DIR}/tnm093/include/tnm_summedvolumetable.h \
     $${VRN_MODULE_DIR}/tnm093/include/tnm_volumeinformation.h